@@ -12,6 +12,8 @@ protected:
 	virtual void Copy(GameObject *original) override;
 	virtual void SaveYAML(void *yaml) override;
 	virtual void LoadYAML(void *yaml) override;
+	virtual void SaveBinary(SceneFileObject& obj, SceneWriter& writer) override;
+	virtual void LoadBinary(const SceneFileObject& obj) override;
 
 public:
 	Camera();
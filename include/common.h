@@ -61,13 +61,19 @@ class Console;
 class MainWindow;
 class Camera;
 class Input;
+class ThreadPool;
+class FramePipeline;
 class Render;
 class RenderPathBase;
 class RenderPathRealtime;
 class RenderPathPathTracing;
+class RenderTargetPool;
 class IProfilerCallback;
 class File;
 struct FileMapping;
+struct SceneFileObject;
+class SceneWriter;
+class SceneReader;
 class Camera;
 class Mesh;
 class Model;
@@ -90,9 +96,11 @@ typedef unsigned int uint;
 typedef unsigned char uint8;
 typedef void (*ConsoleCallback)(const char *, LOG_TYPE);
 typedef void (*ObjectCallback)(GameObject*);
+typedef void (*ObjectsCallback)(GameObject *const *objects, size_t num);
 typedef void (*WindowCallback)(WINDOW_MESSAGE, uint32, uint32, void*);
 typedef void (*ProgressCallback)(int);
 typedef void (*MaterialCallback)(Material*);
+typedef void (*ShaderCallback)(uint shaderId);
 
 extern Core *_core;
 
@@ -147,11 +155,51 @@ inline ENUM_NAME operator&(ENUM_NAME a, ENUM_NAME b) \
 	return static_cast<ENUM_NAME>(static_cast<int>(a) & static_cast<int>(b)); \
 }
 
+// Text storage reused between frames.
+// Lines are null terminated and written with printf format, memory grows only when text becomes longer
+class TextArena
+{
+	std::vector<char> chars;
+	std::vector<uint> lines; // offsets in chars
+	size_t size{0};
+
+public:
+	TextArena(size_t capacity = 4096) : chars(capacity) {}
+
+	void Reset()
+	{
+		size = 0;
+		lines.clear();
+	}
+
+	template<typename... Arguments>
+	void AddLine(const char *format, Arguments ...args)
+	{
+		for (;;)
+		{
+			int len = snprintf(chars.data() + size, chars.size() - size, format, args...);
+			if (len < 0)
+				return;
+
+			if (size + len < chars.size())
+			{
+				lines.push_back((uint)size);
+				size += len + 1;
+				return;
+			}
+
+			chars.resize(max(chars.size() * 2, size + len + 1));
+		}
+	}
+
+	auto GetNumLines() const -> uint { return (uint)lines.size(); }
+	auto GetLine(uint i) const -> const char* { return chars.data() + lines[i]; }
+};
+
 class IProfilerCallback
 {
 public:
-	virtual uint getNumLines() = 0;
-	virtual std::string getString(uint i) = 0;
+	virtual void writeLines(TextArena& out) = 0; // empty line is a spacer
 };
 
 std::string fileExtension(const std::string& path);
@@ -177,6 +225,8 @@ enum class INIT_FLAGS
 	GRAPHIC_LIBRARY_FLAG	= 0x000000F0,
 	OPENGL45				= 0x00000010,
 	DIRECTX11				= 0x00000020,
+	NULL_RENDER				= 0x00000030, // no GPU and no window, commands are only counted and recorded (headless benchmarks)
+	SOFTWARE_RENDER			= 0x00000040, // no GPU and no window, meshes are rasterized on CPU (previews, picking on render nodes)
 	
 	CREATE_CONSOLE_FLAG		= 0x00000F00,
 	CREATE_CONSOLE			= 0x00000200, // engine should create console window
@@ -645,6 +695,16 @@ public:
 	size_t size() { return triangles.size(); }
 };
 
+// Weak reference to GameObject that can be checked for validity
+struct ObjectHandle
+{
+	uint32_t index{UINT32_MAX};
+	uint32_t generation{0};
+
+	bool operator==(const ObjectHandle& r) const { return index == r.index && generation == r.generation; }
+	bool operator!=(const ObjectHandle& r) const { return !(*this == r); }
+};
+
 enum class SHADER_TYPE
 {
 	SHADER_VERTEX,
@@ -694,8 +754,6 @@ public:
 // Random
 
 int currentTime();
-bool isIsFree(int id);
-void addId(int id);
 
 template<class T>
 class RandomInstance
@@ -724,9 +782,7 @@ public:
 			newid |= random8() << 8;
 			newid |= random8() << 16;
 			newid |= (random8() & 0x7f) << 24;
-		} while (!isIsFree(newid) && newid == 0);
-
-		addId(newid);
+		} while (newid == 0);
 
 		return newid;
 	}
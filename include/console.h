@@ -1,14 +1,61 @@
 #pragma once
 #include "common.h"
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 class ConsoleWindow;
 
+#define LOG_MESSAGE_SIZE 2048 // longer messages are formatted and queued on heap
+#define LOG_QUEUE_SIZE 1024 // power of two
+
+//
+// Messages are pushed to a lock-free bounded MPSC ring buffer.
+// Background writer thread keeps log file open and writes messages in batches,
+// file is flushed when queue is drained or after CRITICAL/FATAL message.
+// Callbacks and console window get messages on main thread in Update().
+// Free() waits for pushes in progress and stops writer after it drained the queue,
+// later messages are written directly.
+//
 class Console final
 {
+	struct Message
+	{
+		std::atomic<size_t> sequence;
+		LOG_TYPE type;
+		bool fileOnly;
+		char text[LOG_MESSAGE_SIZE];
+		std::unique_ptr<char[]> longText; // instead of text if message doesn't fit
+	};
+
 	Signal<const char*, LOG_TYPE> onLog;
-	std::unique_ptr<char[]> tmpbuf;
 	ConsoleWindow *window{nullptr};
 
+	std::unique_ptr<Message[]> queue;
+	alignas(64) std::atomic<size_t> enqueuePos{0};
+	alignas(64) size_t dequeuePos{0};
+	alignas(64) std::atomic<size_t> written{0}; // messages written to file
+
+	std::thread writer;
+	std::atomic<bool> running{false}; // messages go to queue
+	std::atomic<int> pushing{0}; // Log() calls that can still push
+	bool stopWriter{false}; // guarded by writerMtx
+	bool writerExited{false};
+	std::mutex writerMtx;
+	std::condition_variable writerCV;
+	std::condition_variable writtenCV;
+
+	std::mutex dispatchMtx;
+	std::vector<std::pair<LOG_TYPE, std::string>> dispatch; // written messages for callbacks
+	std::vector<std::pair<LOG_TYPE, std::string>> dispatchTmp;
+
+	std::mutex directMtx;
+
+	bool push(const char *msg, LOG_TYPE type, bool fileOnly); // false if queue is full and writer can't be waited
+	void writeDirect(const char *msg, LOG_TYPE type);
+	void writerLoop();
+	void waitWritten(size_t pos);
+
 public:
 	// Internal API
 	Console();
@@ -16,14 +63,26 @@ public:
 
 	void Init(bool createWindow);
 	void Free();
+	void Update(); // invokes callbacks on main thread
 	void Show();
 	void Hide();
+	void Flush(); // blocks until all pushed messages are written to file
+	void BenchmarkLogging(uint threads = 4, uint messagesPerThread = 100000); // log calls per second, messages go to file only
 
 	template <typename... Arguments>
 	void Log(const char *pStr, LOG_TYPE type, Arguments ...args)
 	{
-		sprintf(tmpbuf.get(), pStr, args...);
-		Log(tmpbuf.get(), type);
+		char buf[LOG_MESSAGE_SIZE];
+		int len = snprintf(buf, LOG_MESSAGE_SIZE, pStr, args...);
+		if (len < LOG_MESSAGE_SIZE)
+		{
+			Log(buf, type);
+			return;
+		}
+
+		std::unique_ptr<char[]> longBuf(new char[len + 1]);
+		snprintf(longBuf.get(), len + 1, pStr, args...);
+		Log(longBuf.get(), type);
 	}
 
 public:
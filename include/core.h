@@ -21,6 +21,8 @@ class Core final : IProfilerCallback
 	Console *console{nullptr};
 	Input *input{nullptr};
 	MaterialManager *matManager{nullptr};
+	ThreadPool *threadPool{nullptr};
+	FramePipeline *framePipeline{nullptr};
 
 	Signal<float> onUpdate;
 	Signal<> onInit;
@@ -30,6 +32,10 @@ class Core final : IProfilerCallback
 	int _fps{0};
 	int _fpsLazy{0};
 	bool _profiler{false};
+	bool _framePipelining{false};
+	bool _pipelineStarted{false}; // frame is extracted and waits for render
+	float _updateMs{0.0f}; // update of serial frame or main thread part of pipelined frame
+	float _renderMs{0.0f};
 
 	Camera *camera{nullptr};
 
@@ -38,13 +44,20 @@ class Core final : IProfilerCallback
 
 	std::vector<IProfilerCallback*> profilerCallbacks;
 
-	std::mutex logMtx;
-	char logBuffer__[5000];
-
 	void freeCoreRender();
-	bool initCoreRender(WindowHandle *handle);
+	bool initCoreRender(WindowHandle *handle, INIT_FLAGS flags);
 	void engineUpdate();
+	void beginUpdate(); // main thread part of update: time, subsystems
+	void endUpdate(); // callbacks, next frame
 	void mainLoop();
+	void pipelinedLoop();
+	auto canPipelineFrames() -> bool;
+	void renderSerialFrame();
+	void kickFrameStage();
+	void stopFramePipeline();
+	void prepareStart(Camera *cam);
+	auto getCameraData() -> Engine::CameraData;
+	auto getCameraData(float aspect) -> Engine::CameraData;
 	void setWindowCaption(int is_paused, int fps);
 	void messageCallback(WINDOW_MESSAGE type, uint32 param1, uint32 param2, void *pData);
 
@@ -53,8 +66,7 @@ class Core final : IProfilerCallback
 
 public:
 	// IProfilerCallback
-	uint getNumLines() override;
-	std::string getString(uint i) override;
+	void writeLines(TextArena& out) override;
 
 public:
 	// Internal API
@@ -64,16 +76,27 @@ public:
 	IProfilerCallback *getCallback(int i) const { return profilerCallbacks[i]; }
 	float deltaTime() { return _dt; }
 	int64_t frame() { return _frame; }
+	ThreadPool *GetThreadPool() const { return threadPool; }
+	void BenchmarkFramePipeline(uint frames = 100); // frame time of serial and pipelined main loop, needs Start()
 
 	template<class T, typename... Arguments>
 	void _Log(LOG_TYPE type, T a, Arguments ...args)
 	{
-		std::lock_guard<std::mutex> guard(logMtx);
-
-		if (strlen(a) > 4999) abort();
-		sprintf(logBuffer__, a, args...);
-		if (_core->GetConsole())
-			_core->GetConsole()->Log(logBuffer__, type);
+		if (!_core->GetConsole())
+			return;
+
+		char buf[LOG_MESSAGE_SIZE];
+		int len = snprintf(buf, LOG_MESSAGE_SIZE, a, args...);
+		if (len < LOG_MESSAGE_SIZE)
+		{
+			_core->GetConsole()->Log(buf, type);
+			return;
+		}
+
+		// shader compilation errors, dumps
+		std::unique_ptr<char[]> longBuf(new char[len + 1]);
+		snprintf(longBuf.get(), len + 1, a, args...);
+		_core->GetConsole()->Log(longBuf.get(), type);
 	}
 
 public:
@@ -81,6 +104,7 @@ public:
 	auto DLLEXPORT Init(const char* rootPath, const WindowHandle* externHandle, INIT_FLAGS flags = INIT_FLAGS::NONE) -> bool;
 	auto DLLEXPORT Free() -> void;
 	auto DLLEXPORT Start(Camera *cam) -> void;
+	auto DLLEXPORT RunBenchmark(const char *name, Camera *cam) -> bool; // instead of Start(), results go to log. false if benchmark is unknown, can't run or found wrong results
 	auto DLLEXPORT ManualUpdate() -> void;
 	auto DLLEXPORT ManualRenderFrame(const WindowHandle* externHandle, const Engine::CameraData& camera, Model** wireframeModels, int modelsNum) -> void;
 
@@ -101,6 +125,15 @@ public:
 	auto DLLEXPORT RemoveProfilerCallback(IProfilerCallback *c) -> void;
 	auto DLLEXPORT SetProfiler(bool value) -> void {_profiler = value; }
 	auto DLLEXPORT IsProfiler() -> bool { return _profiler; }
+	auto DLLEXPORT SetCpuProfiler(bool value) -> void; // records CPU zones of last frames
+	auto DLLEXPORT IsCpuProfiler() -> bool;
+	auto DLLEXPORT SaveCpuProfile(const char *path) -> bool; // Chrome trace JSON for chrome://tracing or Perfetto
+
+	// Main loop updates objects and extracts render scene of frame N + 1 on frame pipeline thread
+	// while frame N is rendered. onUpdate callbacks stay on main thread, before objects update.
+	// Only realtime render path is pipelined, editor (ManualUpdate()) is always serial
+	auto DLLEXPORT SetFramePipelining(bool value) -> void { _framePipelining = value; }
+	auto DLLEXPORT IsFramePipelining() -> bool { return _framePipelining; }
 };
 
 DLLEXPORT Core* GetCore();
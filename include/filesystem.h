@@ -32,8 +32,8 @@ struct FileMapping
 {
 	HANDLE hFile;
 	HANDLE hMapping;
-	size_t fsize;
-	unsigned char* ptr;
+	size_t fsize{0};
+	unsigned char* ptr{nullptr};
 
 public:
 	FileMapping() = default;
@@ -57,6 +57,11 @@ public:
 	File& operator=(const File&&);
 	File(const File&&);
 
+	// Internal API
+	auto Stream() -> std::fstream& { return file_; }
+	auto IsOpen() -> bool { return file_.is_open(); }
+	auto Flush() -> bool { file_.flush(); return file_.good(); } // false if file wasn't opened or some write failed
+
 	auto DLLEXPORT Read(uint8 *pMem, size_t bytes) -> void;
 	auto DLLEXPORT Write(const uint8 *pMem, size_t bytes) -> void;
 	auto DLLEXPORT WriteStr(const char *str) -> void;
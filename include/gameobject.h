@@ -15,46 +15,43 @@ OBJECT_TYPE getTypeByName(const std::string& name);
 
 class GameObject
 {
+	friend class TransformSystem;
+	friend class ObjectRegistry;
+
 protected:
 	int id_;
 	std::string name_{"GameObject"};
 	bool enabled_{true};
 	OBJECT_TYPE type_{OBJECT_TYPE::GAMEOBJECT};
 
-	// Local (relative parent)
-	vec3 pos_;
-	quat rot_;
-	vec3 scale_{1.0f, 1.0f, 1.0f};
-	mat4 localTransform_; // transforms Local -> Parent coordinates
-
-	// World (relative world)
-	vec3 worldPos_;
-	quat worldRot_;
-	vec3 worldScale_{1.0f, 1.0f, 1.0f};
-	mat4 worldTransform_; // transforms Local -> World coordinates
-
-	mat4 worldTransformPrev_;
+	int transform_; // slot in TransformSystem
+	ObjectHandle handle_; // slot in ObjectRegistry
 
 	GameObject *parent_{nullptr};
 	std::vector<GameObject*> childs_;
 
 	virtual void Copy(GameObject *original);
+	virtual void onTransformChanged() {} // called after world transform is updated
+	virtual void onEnabledChanged() {}
 
 public:
 	GameObject();
 	virtual ~GameObject();
 
 	// Interanl API
-	virtual void Update(float dt);
+	virtual void Update(float dt); // runs in a thread pool job per root subtree: must not create, destroy or reparent objects
 	virtual void SaveYAML(void *yaml);
 	virtual void LoadYAML(void *yaml);
+	virtual void SaveBinary(SceneFileObject& obj, SceneWriter& writer); // transform is written by caller
+	virtual void LoadBinary(const SceneFileObject& obj); // mesh and material are resolved by caller
 
 public:
 	auto DLLEXPORT GetName() -> const char* { return name_.c_str(); }
 	auto DLLEXPORT SetName(const char *name) -> void { name_ = name; }
 	auto DLLEXPORT GetId() -> int { return id_; }
-	auto DLLEXPORT SetId(int id) -> void { id_ = id; }
-	auto DLLEXPORT SetEnabled(bool v) -> void { enabled_ = v; }
+	auto DLLEXPORT SetId(int id) -> void;
+	auto DLLEXPORT GetHandle() -> ObjectHandle { return handle_; }
+	auto DLLEXPORT SetEnabled(bool v) -> void { enabled_ = v; onEnabledChanged(); }
 	auto DLLEXPORT IsEnabled() -> bool { return enabled_; }
 	auto DLLEXPORT GetType() -> OBJECT_TYPE { return type_; }
 
@@ -76,6 +73,7 @@ public:
 	auto DLLEXPORT SetWorldTransform(const mat4& m) -> void;
 	auto DLLEXPORT GetWorldTransform() -> mat4;
 	auto DLLEXPORT GetInvWorldTransform() -> mat4;
+	auto DLLEXPORT GetNormalMatrix() -> mat4; // transposed inverse of world transform
 	auto DLLEXPORT GetWorldTransformPrev()->mat4;
 
 	// Hierarchy
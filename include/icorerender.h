@@ -6,6 +6,7 @@ class ICoreMesh;
 class ICoreShader;
 class ICoreTexture;
 class ICoreStructuredBuffer;
+class ICoreConstantBuffer;
 class Shader;
 class Mesh;
 class Texture;
@@ -38,6 +39,7 @@ public:
 	auto virtual CreateShader(const char *vertText, const char *fragText, const char *geomText, ERROR_COMPILE_SHADER &err) -> ICoreShader* = 0;
 	auto virtual CreateComputeShader(const char *compText, ERROR_COMPILE_SHADER &err) -> ICoreShader* = 0;
 	auto virtual CreateStructuredBuffer(uint size, uint elementSize, BUFFER_USAGE usage) -> ICoreStructuredBuffer* = 0;
+	auto virtual CreateConstantBuffer(uint size) -> ICoreConstantBuffer* = 0;
 
 	auto virtual PushStates() -> void = 0;
 	auto virtual PopStates() -> void = 0;
@@ -89,6 +91,15 @@ public:
 	auto virtual SetVec4Parameter(const char* name, const vec4 *value) -> void = 0;
 	auto virtual SetMat4Parameter(const char* name, const mat4 *value) -> void = 0;
 	auto virtual SetUintParameter(const char* name, uint value) -> void = 0;
+	auto virtual GetParameterHandle(const char* name) -> int = 0; // -1 if not found
+	auto virtual SetFloatParameter(int handle, float value) -> void = 0;
+	auto virtual SetVec4Parameter(int handle, const vec4 *value) -> void = 0;
+	auto virtual SetMat4Parameter(int handle, const mat4 *value) -> void = 0;
+	auto virtual SetUintParameter(int handle, uint value) -> void = 0;
+	auto virtual GetConstantBufferHandle(const char* name) -> int = 0; // -1 if not found
+	auto virtual GetConstantBufferSize(int bufferHandle) -> uint = 0;
+	auto virtual GetParameterOffset(int bufferHandle, const char* name, uint *bytes) -> int = 0; // -1 if not found
+	auto virtual SetConstantBuffer(int bufferHandle, ICoreConstantBuffer *buffer) -> void = 0; // binds instead of pooled buffer until next SetShader()
 	auto virtual FlushParameters() -> void = 0;
 };
 
@@ -114,3 +125,12 @@ public:
 	auto virtual GetElementSize() -> uint = 0;
 	auto virtual GetVideoMemoryUsage() -> size_t = 0;
 };
+
+class NOVTABLE ICoreConstantBuffer
+{
+public:
+	virtual ~ICoreConstantBuffer() = default;
+	auto virtual SetData(const uint8 *data, size_t size) -> void = 0;
+	auto virtual GetSize() -> uint = 0;
+	auto virtual GetVideoMemoryUsage() -> size_t = 0;
+};
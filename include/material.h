@@ -1,5 +1,6 @@
 #pragma once
 #include "common.h"
+#include "icorerender.h"
 #include <map>
 
 //
@@ -26,6 +27,7 @@ struct GenericMaterial
 		PASS pass;
 		PARAM_TYPE type;
 		vec4 defaultValue;
+		std::unordered_map<uint, int> handles; // shader id -> parameter handle
 	};
 	std::map<std::string, size_t> nameToIndexMap_;
 	std::vector<Param> params_;
@@ -53,6 +55,7 @@ struct GenericMaterial
 		std::string path;
 		int hasCondition{0};
 		std::string condition;
+		std::unordered_map<uint, int> uvHandles; // shader id -> "uv_transform_<id>" handle
 	};
 	std::vector<MaterialTexture> textures_;
 
@@ -70,6 +73,7 @@ public:
 
 	void LoadXML();
 	void Clear();
+	void OnShaderDestroyed(uint shaderId); // drops cached handles
 	bool HasDef(const std::string& id) { return defs_.find(id) != defs_.end(); }
 	bool HasParam(const std::string& id) { return nameToIndexMap_.find(id) != nameToIndexMap_.end(); }
 };
@@ -105,12 +109,31 @@ class Material
 	};
 	std::map<std::string, RuntimeTexture> runtimeTextures_; // name -> texure
 
+	// Packed "material_parameters" constant buffer of one shader.
+	// Rebuilt only after params changed
+	struct ParamBlock
+	{
+		uint shaderId;
+		PASS pass; // block has only params of this pass
+		int bufferHandle{-1}; // -1 if shader has no such buffer
+		std::vector<int> offsets; // param -> offset in data, -1 if param not in buffer
+		std::vector<uint> sizes; // param -> bytes to copy
+		std::unique_ptr<uint8[]> data;
+		uint bytes{};
+		std::unique_ptr<ICoreConstantBuffer> buffer;
+		bool dirty{true};
+	};
+	std::vector<ParamBlock> paramBlocks_; // one per shader and pass
+
+	ParamBlock& getParamBlock(Shader* shader, PASS pass);
+	void paramChanged(size_t param);
 	void initializeFromParent();
 	void generateDefines();
 
 public:
 	void UploadShaderParameters(Shader* shader, PASS pass);
 	void BindShaderTextures(Shader* shader, PASS pass);
+	void OnShaderDestroyed(uint shaderId); // drops param blocks of shader
 
 public:
 	Material(const std::string& id, GenericMaterial *mat); // runtime
@@ -134,10 +157,10 @@ public:
 	auto DLLEXPORT GetUV(const char *name) -> vec4;
 
 	// TODO: make one function GetShader(PASS)
-	auto DLLEXPORT GetShader(Mesh *mesh = nullptr) -> Shader*;
-	auto DLLEXPORT GetDeferredShader(Mesh *mesh = nullptr) -> Shader*;
-	auto DLLEXPORT GetIdShader(Mesh *mesh = nullptr) -> Shader*;
-	auto DLLEXPORT GetWireframeShader(Mesh *mesh = nullptr) -> Shader*;
-	auto DLLEXPORT GetForwardShader(Mesh *mesh = nullptr) -> Shader*;
+	auto DLLEXPORT GetShader(Mesh *mesh = nullptr, bool instanced = false) -> Shader*;
+	auto DLLEXPORT GetDeferredShader(Mesh *mesh = nullptr, bool instanced = false) -> Shader*;
+	auto DLLEXPORT GetIdShader(Mesh *mesh = nullptr, bool instanced = false) -> Shader*;
+	auto DLLEXPORT GetWireframeShader(Mesh *mesh = nullptr, bool instanced = false) -> Shader*;
+	auto DLLEXPORT GetForwardShader(Mesh *mesh = nullptr, bool instanced = false) -> Shader*;
 
 };
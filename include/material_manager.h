@@ -9,6 +9,7 @@ class MaterialManager
 
 public:
 	void Init();
+	void Update(); // deletes destroyed materials, main thread only
 	void Free();
 	void MaterialChanged(Material* mat)
 	{
@@ -18,6 +19,10 @@ public:
 	{
 		onMaterialChanged.Add(callback);
 	}
+	void RemoveCallbackMaterialChanged(MaterialCallback callback)
+	{
+		onMaterialChanged.Erase(callback);
+	}
 
 public:
 	auto DLLEXPORT CreateMaterial(const char *genericmat) -> Material*;
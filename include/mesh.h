@@ -8,6 +8,7 @@ class Mesh
 	std::unique_ptr<ICoreMesh> coreMeshPtr;
 	std::string path_;
 	vec3 center_;
+	AABB bounds_;
 	uint32_t triangles;
 	std::shared_ptr<RaytracingData> trianglesDataObjectSpace;
 
@@ -26,4 +27,5 @@ public:
 	auto DLLEXPORT GetVideoMemoryUsage() -> size_t;
 	auto DLLEXPORT GetPath() -> const char* const { return path_.c_str(); }
 	auto DLLEXPORT GetCenter() -> vec3;
+	auto DLLEXPORT GetBounds() -> AABB { return bounds_; }
 };
@@ -6,6 +6,8 @@
 
 class Model final : public GameObject
 {
+	friend class RenderProxies;
+
 	StreamPtr<Mesh> meshPtr;
 	vec3 meshCeneter;
 	Material *mat_{nullptr};
@@ -13,20 +15,43 @@ class Model final : public GameObject
 	uint raytracingMaterial = 0;
 	mat4 trianglesDataTransform;
 
+	// Culling
+	AABB meshBounds_;
+	AABB worldBounds_;
+	bool hasBounds_{false}; // mesh bounds are known after the mesh is loaded
+	int treeProxy_{-1};
+	uint visibleStamp_{};
+	int renderProxy_{-1};
+
+	void updateWorldBounds();
+	void resetBounds();
+
 protected:
 	virtual void Copy(GameObject *original) override;
 	virtual void SaveYAML(void *yaml) override;
 	virtual void LoadYAML(void *yaml) override;
+	virtual void SaveBinary(SceneFileObject& obj, SceneWriter& writer) override;
+	virtual void onTransformChanged() override;
+	virtual void onEnabledChanged() override;
 
 public:
 	Model();
 	Model(StreamPtr<Mesh> mesh);
+	virtual ~Model();
+
+	// Interanl API
+	static void CullModels(const mat4& VP); // marks models intersecting the frustum as visible
+	bool IsVisible();
+	auto GetWorldBounds() -> AABB { return worldBounds_; }
+	bool IsMeshLoaded() { return meshPtr.isLoaded(); }
+	void SetMesh(StreamPtr<Mesh>& mesh);
 
 	std::shared_ptr<RaytracingData> GetRaytracingData(uint mat);
+	static void TransformRaytracingTriangles(ThreadPool *pool, const mat4& M, const mat4& NM, const GPURaytracingTriangle *in, GPURaytracingTriangle *out, size_t num, uint mat);
 
 	auto DLLEXPORT GetMesh() -> Mesh*;
 	auto DLLEXPORT GetMeshPath() -> const char*;
-	auto DLLEXPORT SetMaterial(Material *mat) -> void { mat_ = mat; }
+	auto DLLEXPORT SetMaterial(Material *mat) -> void;
 	auto DLLEXPORT GetMaterial() -> Material* { return mat_; }
 	auto DLLEXPORT GetWorldCenter() -> vec3;
 	auto DLLEXPORT GetTrinaglesWorldSpace(std::unique_ptr<vec3[]>& out, uint* trinaglesNum) -> void;
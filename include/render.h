@@ -52,7 +52,7 @@ class Render : public IProfilerCallback
 	Texture *environment;
 	std::string envirenmentHDRIPath;
 	StreamPtr<Texture> environmentHDRI;
-	Texture *environmentAtmosphere;
+	Texture *environmentAtmosphere; // acquired from the pool for the renderer's lifetime: cubemap is reused across frames until atmosphereHash changes
 	float diffuseEnvironemnt{ 1.0f };
 	float specularEnvironemnt{ 1.0f };
 	const uint32_t maxFrames = 4;
@@ -78,7 +78,8 @@ public:
 	enum LOAD_SHADER_FLAGS
 	{
 		LS_NONE = 0,
-		LS_GEOMETRY,
+		LS_GEOMETRY = 1 << 0,
+		LS_INSTANCED = 1 << 1, // defines ENG_INSTANCED
 	};
 
 	struct RenderMesh
@@ -89,6 +90,7 @@ public:
 		Model* model{};
 		mat4 worldTransformMat;
 		mat4 worldTransformMatPrev;
+		mat4 normalMat;
 	};
 
 	struct RenderLight
@@ -104,42 +106,60 @@ public:
 	struct RenderScene
 	{
 		std::vector<RenderMesh> meshes;
+		std::vector<RenderMesh> visibleMeshes; // culled by extraction of pipelined frame
 		std::vector<RenderLight> lights;
 		std::vector<RenderLight> areaLights;
 		bool hasWorldLight;
 		vec4 sun_direction;
+		bool culled{false};
+		Engine::CameraData camera{}; // of pipelined frame
 
 		uint32_t getHash();
 		size_t areaLightCount() { return areaLights.size(); }
 	};
 
-	RenderScene getRenderScene();
-	std::vector<RenderMesh> getRenderMeshes();
+	RenderScene renderScene; // refilled every frame, keeps capacity
+
+	// Pipelined frames: scene is extracted on frame pipeline thread while previous one is rendered.
+	// Snapshot doesn't point to scene objects (only to meshes and materials, freeing of them is deferred)
+	RenderScene pipelinedScenes[2];
+	int extractedScene{0};
+	RenderScene *frameSnapshot{nullptr}; // scene of pipelined frame being rendered
+	std::vector<Model*> pendingMeshes; // models with meshes to load on main thread
+
+	void extractRenderScene(RenderScene& scene, std::vector<Model*> *notLoaded);
+	RenderScene& getRenderScene();
+	void getRenderMeshes(std::vector<RenderMesh>& out, std::vector<Model*> *notLoaded = nullptr); // models with not loaded mesh are skipped and returned if notLoaded is set
+	const std::vector<RenderMesh>& getVisibleMeshes(const RenderScene& scene, const mat4& VP);
 
 	void addLight(Light* l, std::vector<RenderLight>& tergetVec);
-	std::vector<RenderLight> getRenderAreaLights(std::vector<Light*> lights);
-	std::vector<RenderLight> getRenderLights(std::vector<Light*> lights);
+	void getRenderAreaLights(std::vector<RenderLight>& out);
+	void getRenderLights(std::vector<RenderLight>& out);
 	Mesh* fullScreen() { return planeMesh.get(); }
 	void updateEnvirenment(RenderScene& scene);
 	uint32 frameID();
 	uint32 readbackFrameID();
 
 	// IProfilerCallback
-	uint getNumLines() override;
-	std::string getString(uint i) override;
-	void drawMeshes(PASS pass, std::vector<Render::RenderMesh>& meshes, mat4 VP, mat4 VP_Prev);
+	void writeLines(TextArena& out) override;
+	void drawMeshes(PASS pass, const std::vector<Render::RenderMesh>& meshes, mat4 VP, mat4 VP_Prev);
 
 public:
 	void Init();
 	void Update();
 	void Free();
 	void RenderFrame(size_t viewID, const Engine::CameraData& camera, Model** wireframeModels, int modelsNum);
+	void ExtractFrame(const Engine::CameraData& camera); // frame pipeline thread
+	auto PublishFrame() -> const Engine::CameraData&; // main thread, extracted scene is used by next RenderFrame()
+	void StopPipelining(); // RenderFrame() extracts scene itself
+	auto GetRenderTargetPool() -> RenderTargetPool*;
 	auto GetPrevRenderTexture(PREV_TEXTURES id, uint width, uint height, TEXTURE_FORMAT format) -> Texture*;
 	void ExchangePrevRenderTexture(Texture *prev, Texture *some);
 	void GetEnvironmentResolution(vec4& out);
 	void GetEnvironmentIntensity(vec4& out);
 	Texture* GetEnvironmentTexture() { return environment; }
 	void draw_AreaLightEmblems(const std::vector<Render::RenderLight>& lights, const mat4& VP, PASS pas);
+	void BenchmarkDrawPreparation(const Engine::CameraData& camera, uint objects = 50000, uint frames = 20); // drawMeshes() CPU time by number of command lists, scene meshes are repeated
 
 public:
 	auto DLLEXPORT GetShader(const char* path, Mesh* meshattrib = nullptr, const std::vector<std::string>* defines = nullptr, LOAD_SHADER_FLAGS flags = LS_NONE) -> Shader*;
@@ -19,13 +19,32 @@ class ResourceManager
 
 	Signal<GameObject*> onObjectAdded;
 	Signal<GameObject*> onObjectDestroy;
+	Signal<GameObject* const*, size_t> onObjectsAdded;
+	Signal<uint> onShaderDestroyed;
+
+public:
+	struct UpdateTimings
+	{
+		float transforms; // ms
+		float objects;
+		float residency; // streaming unload scan
+	};
+
+private:
+	UpdateTimings updateTimings{};
 
 public:
 	// Internal API
 	void Reload();
 	void Init();
 	void Free();
-	void Update(float dt);
+	void Update(float dt); // UpdateObjects() and FreeUnusedResources()
+	void UpdateObjects(float dt); // transforms and objects, can run on frame pipeline thread
+	void FreeUnusedResources(); // residency scan, touches GPU resources and StreamPtr counters so it's for main thread only
+	auto GetUpdateTimings() -> const UpdateTimings&;
+	void AddCallbackShaderDestroyed(ShaderCallback c) { onShaderDestroyed.Add(c); } // for caches keyed by shader id
+	void RemoveCallbackShaderDestroyed(ShaderCallback c) { onShaderDestroyed.Erase(c); }
+	void BenchmarkSceneLoading(uint objects = 100000); // compares DOM and two-phase parallel YAML loaders, world must be closed
 	auto GetNumObjects() -> size_t;
 	auto GetObject_(size_t i) -> GameObject*;
 	auto GetImportMeshDir() -> std::string;
@@ -59,12 +78,16 @@ public:
 	auto DLLEXPORT InsertObject(int row, GameObject *obj) -> void;
 	auto DLLEXPORT AddCallbackOnObjAdded(ObjectCallback c) -> void;
 	auto DLLEXPORT FindObjectById(int id) -> GameObject*;
+	auto DLLEXPORT FindObjectByHandle(ObjectHandle h) -> GameObject*; // nullptr if object was destroyed
 	auto DLLEXPORT RemoveCallbackOnObjAdded(ObjectCallback c) -> void;
 	auto DLLEXPORT AddCallbackOnDestroy(ObjectCallback c) -> void;
 	auto DLLEXPORT RemoveCallbackOnObjDestroyed(ObjectCallback c) -> void;
+	auto DLLEXPORT AddCallbackOnObjectsAdded(ObjectsCallback c) -> void; // LoadWorld() reports all loaded objects once
+	auto DLLEXPORT RemoveCallbackOnObjectsAdded(ObjectsCallback c) -> void;
 
 	auto DLLEXPORT SaveWorld() -> void;
 	auto DLLEXPORT LoadWorld() -> void;
 	auto DLLEXPORT CloseWorld() -> void;
+	auto DLLEXPORT ConvertWorld(const char *src, const char *dst) -> bool; // .yaml <-> .bin by extension
 };
 
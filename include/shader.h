@@ -9,12 +9,14 @@ class Shader final
 	std::unique_ptr<const char[]> geomFullText_;
 	std::unique_ptr<const char[]> fragFullText_;
 	std::unique_ptr<const char[]> compFullText_;
+	uint id_;
 
 public:
 	Shader(std::unique_ptr<ICoreShader> s, std::unique_ptr<const char[]> vertIn, std::unique_ptr<const char[]> geomIn, std::unique_ptr<const char[]> fragIn);
 	Shader(std::unique_ptr<ICoreShader> s, std::unique_ptr<const char[]> compIn);
 
 	auto DLLEXPORT GetCoreShader() -> ICoreShader*;
+	auto DLLEXPORT GetId() -> uint { return id_; } // unique for each created shader, never reused
 	auto DLLEXPORT GetVert() -> const char*;
 	auto DLLEXPORT GetGeom() -> const char*;
 	auto DLLEXPORT GetFrag() -> const char*;
@@ -23,5 +25,14 @@ public:
 	auto DLLEXPORT SetVec4Parameter(const char* name, const vec4 *value) -> void;
 	auto DLLEXPORT SetMat4Parameter(const char* name, const mat4 *value) -> void;
 	auto DLLEXPORT SetUintParameter(const char* name, uint value) -> void;
+	auto DLLEXPORT GetParameterHandle(const char* name) -> int;
+	auto DLLEXPORT SetFloatParameter(int handle, float value) -> void;
+	auto DLLEXPORT SetVec4Parameter(int handle, const vec4 *value) -> void;
+	auto DLLEXPORT SetMat4Parameter(int handle, const mat4 *value) -> void;
+	auto DLLEXPORT SetUintParameter(int handle, uint value) -> void;
+	auto DLLEXPORT GetConstantBufferHandle(const char* name) -> int;
+	auto DLLEXPORT GetConstantBufferSize(int bufferHandle) -> uint;
+	auto DLLEXPORT GetParameterOffset(int bufferHandle, const char* name, uint *bytes) -> int;
+	auto DLLEXPORT SetConstantBuffer(int bufferHandle, ICoreConstantBuffer *buffer) -> void;
 	auto DLLEXPORT FlushParameters() -> void;
 };
@@ -1,5 +1,23 @@
 #pragma once
 #include <cmath> // sqrt
+#include <stddef.h>
+
+//
+// SIMD backend for mat4, selected at compile time.
+// Scalar versions (*Scalar methods) are kept as reference, vector_math.cpp checks SIMD results against them.
+// mat4 * mat4, mat4 * vec4 and Transpose() are bit-exact with scalar versions: products are summed in the same order.
+//
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define VECTOR_MATH_SSE
+	#include <emmintrin.h>
+	#ifdef __AVX__
+		#define VECTOR_MATH_AVX
+		#include <immintrin.h>
+	#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	#define VECTOR_MATH_NEON
+	#include <arm_neon.h>
+#endif
 
 #pragma warning(disable : 4201) // ignore non standard unnamed struct in union
 
@@ -421,6 +439,39 @@ struct mat4
 	}
 
 	vec4 operator*(const vec4& v) const
+	{
+	#if defined(VECTOR_MATH_SSE)
+		__m128 c0 = _mm_loadu_ps(el_2D[0]);
+		__m128 c1 = _mm_loadu_ps(el_2D[1]);
+		__m128 c2 = _mm_loadu_ps(el_2D[2]);
+		__m128 c3 = _mm_loadu_ps(el_2D[3]);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+		__m128 r = _mm_mul_ps(_mm_set1_ps(v.x), c0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.y), c1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.z), c2));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.w), c3));
+
+		vec4 ret;
+		_mm_storeu_ps(ret.xyzw, r);
+		return ret;
+	#elif defined(VECTOR_MATH_NEON)
+		float32x4x4_t c = vld4q_f32(el_1D); // deinterleaved load, val[i] is column i
+
+		float32x4_t r = vmulq_n_f32(c.val[0], v.x);
+		r = vaddq_f32(r, vmulq_n_f32(c.val[1], v.y));
+		r = vaddq_f32(r, vmulq_n_f32(c.val[2], v.z));
+		r = vaddq_f32(r, vmulq_n_f32(c.val[3], v.w));
+
+		vec4 ret;
+		vst1q_f32(ret.xyzw, r);
+		return ret;
+	#else
+		return MultiplyScalar(v);
+	#endif
+	}
+
+	vec4 MultiplyScalar(const vec4& v) const
 	{
 		vec4 ret(0.0f, 0.0f, 0.0f, 0.0f);
 
@@ -433,6 +484,47 @@ struct mat4
 	}
 
 	mat4 operator*(const mat4& m) const
+	{
+	#if defined(VECTOR_MATH_SSE)
+		__m128 b0 = _mm_loadu_ps(m.el_2D[0]);
+		__m128 b1 = _mm_loadu_ps(m.el_2D[1]);
+		__m128 b2 = _mm_loadu_ps(m.el_2D[2]);
+		__m128 b3 = _mm_loadu_ps(m.el_2D[3]);
+
+		mat4 res;
+		for (int i = 0; i < 4; i++)
+		{
+			__m128 a = _mm_loadu_ps(el_2D[i]);
+			__m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+			_mm_storeu_ps(res.el_2D[i], r);
+		}
+		return res;
+	#elif defined(VECTOR_MATH_NEON)
+		float32x4_t b0 = vld1q_f32(m.el_2D[0]);
+		float32x4_t b1 = vld1q_f32(m.el_2D[1]);
+		float32x4_t b2 = vld1q_f32(m.el_2D[2]);
+		float32x4_t b3 = vld1q_f32(m.el_2D[3]);
+
+		mat4 res;
+		for (int i = 0; i < 4; i++)
+		{
+			float32x4_t a = vld1q_f32(el_2D[i]);
+			float32x4_t r = vmulq_laneq_f32(b0, a, 0);
+			r = vaddq_f32(r, vmulq_laneq_f32(b1, a, 1));
+			r = vaddq_f32(r, vmulq_laneq_f32(b2, a, 2));
+			r = vaddq_f32(r, vmulq_laneq_f32(b3, a, 3));
+			vst1q_f32(res.el_2D[i], r);
+		}
+		return res;
+	#else
+		return MultiplyScalar(m);
+	#endif
+	}
+
+	mat4 MultiplyScalar(const mat4& m) const
 	{
 		mat4 res;
 		for (int i = 0; i < 4; i++)
@@ -449,7 +541,105 @@ struct mat4
 		return res;
 	}
 
+	//
+	// SSE version uses 2x2 block matrices (adjugates of sub-matrices), result differs from scalar version by rounding only
+	//
 	mat4 Inverse() const
+	{
+	#if defined(VECTOR_MATH_SSE)
+		#define VM_SWIZZLE(v, x, y, z, w) _mm_castsi128_ps(_mm_shuffle_epi32(_mm_castps_si128(v), _MM_SHUFFLE(w, z, y, x)))
+		#define VM_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+		// 2x2 matrices are stored as (m00 m01 m10 m11)
+		auto mul2 = [](__m128 a, __m128 b) { return _mm_add_ps(_mm_mul_ps(a, VM_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(VM_SWIZZLE(a, 1, 0, 3, 2), VM_SWIZZLE(b, 2, 1, 2, 1))); };
+		auto adjMul2 = [](__m128 a, __m128 b) { return _mm_sub_ps(_mm_mul_ps(VM_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(VM_SWIZZLE(a, 1, 1, 2, 2), VM_SWIZZLE(b, 2, 3, 0, 1))); };
+		auto mulAdj2 = [](__m128 a, __m128 b) { return _mm_sub_ps(_mm_mul_ps(a, VM_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(VM_SWIZZLE(a, 1, 0, 3, 2), VM_SWIZZLE(b, 2, 1, 2, 1))); };
+
+		__m128 r0 = _mm_loadu_ps(el_2D[0]);
+		__m128 r1 = _mm_loadu_ps(el_2D[1]);
+		__m128 r2 = _mm_loadu_ps(el_2D[2]);
+		__m128 r3 = _mm_loadu_ps(el_2D[3]);
+
+		__m128 A = _mm_movelh_ps(r0, r1);
+		__m128 B = _mm_movehl_ps(r1, r0);
+		__m128 C = _mm_movelh_ps(r2, r3);
+		__m128 D = _mm_movehl_ps(r3, r2);
+
+		// (|A| |B| |C| |D|)
+		__m128 detSub = _mm_sub_ps(
+			_mm_mul_ps(VM_SHUFFLE(r0, r2, 0, 2, 0, 2), VM_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+			_mm_mul_ps(VM_SHUFFLE(r0, r2, 1, 3, 1, 3), VM_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+		__m128 detA = VM_SWIZZLE(detSub, 0, 0, 0, 0);
+		__m128 detB = VM_SWIZZLE(detSub, 1, 1, 1, 1);
+		__m128 detC = VM_SWIZZLE(detSub, 2, 2, 2, 2);
+		__m128 detD = VM_SWIZZLE(detSub, 3, 3, 3, 3);
+
+		__m128 D_C = adjMul2(D, C);
+		__m128 A_B = adjMul2(A, B);
+		__m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), mul2(B, D_C));
+		__m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), mul2(C, A_B));
+		__m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), mulAdj2(D, A_B));
+		__m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), mulAdj2(A, D_C));
+
+		// |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+		__m128 tr = _mm_mul_ps(A_B, VM_SWIZZLE(D_C, 0, 2, 1, 3));
+		tr = _mm_add_ps(tr, VM_SWIZZLE(tr, 2, 3, 0, 1));
+		tr = _mm_add_ps(tr, VM_SWIZZLE(tr, 1, 0, 3, 2));
+		__m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+		__m128 rDetM = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+		X_ = _mm_mul_ps(X_, rDetM);
+		Y_ = _mm_mul_ps(Y_, rDetM);
+		Z_ = _mm_mul_ps(Z_, rDetM);
+		W_ = _mm_mul_ps(W_, rDetM);
+
+		mat4 res;
+		_mm_storeu_ps(res.el_2D[0], VM_SHUFFLE(X_, Y_, 3, 1, 3, 1));
+		_mm_storeu_ps(res.el_2D[1], VM_SHUFFLE(X_, Y_, 2, 0, 2, 0));
+		_mm_storeu_ps(res.el_2D[2], VM_SHUFFLE(Z_, W_, 3, 1, 3, 1));
+		_mm_storeu_ps(res.el_2D[3], VM_SHUFFLE(Z_, W_, 2, 0, 2, 0));
+
+		#undef VM_SWIZZLE
+		#undef VM_SHUFFLE
+		return res;
+	#else
+		return InverseScalar();
+	#endif
+	}
+
+	//
+	// Inverse of affine matrix (last row is 0 0 0 1), e.g. any product of TRS matrices.
+	// Upper 3x3 is inverted by its adjugate, translation is -inv(A) * t.
+	//
+	mat4 InverseAffine() const
+	{
+		const float (&m)[4][4] = el_2D;
+		mat4 res;
+
+		res.el_2D[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+		res.el_2D[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+		res.el_2D[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+		res.el_2D[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+		res.el_2D[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+		res.el_2D[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+		res.el_2D[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+		res.el_2D[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+		res.el_2D[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+		float invDet = 1.0f / (m[0][0] * res.el_2D[0][0] + m[0][1] * res.el_2D[1][0] + m[0][2] * res.el_2D[2][0]);
+
+		for (int i = 0; i < 3; i++)
+		{
+			res.el_2D[i][0] *= invDet;
+			res.el_2D[i][1] *= invDet;
+			res.el_2D[i][2] *= invDet;
+			res.el_2D[i][3] = -(res.el_2D[i][0] * m[0][3] + res.el_2D[i][1] * m[1][3] + res.el_2D[i][2] * m[2][3]);
+		}
+
+		return res;
+	}
+
+	mat4 InverseScalar() const
 	{
 		// TODO: rewrite
 
@@ -578,6 +768,31 @@ struct mat4
 	}
 
 	mat4 Transpose()
+	{
+	#if defined(VECTOR_MATH_SSE)
+		__m128 r0 = _mm_loadu_ps(el_2D[0]);
+		__m128 r1 = _mm_loadu_ps(el_2D[1]);
+		__m128 r2 = _mm_loadu_ps(el_2D[2]);
+		__m128 r3 = _mm_loadu_ps(el_2D[3]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(el_2D[0], r0);
+		_mm_storeu_ps(el_2D[1], r1);
+		_mm_storeu_ps(el_2D[2], r2);
+		_mm_storeu_ps(el_2D[3], r3);
+		return *this;
+	#elif defined(VECTOR_MATH_NEON)
+		float32x4x4_t c = vld4q_f32(el_1D);
+		vst1q_f32(el_2D[0], c.val[0]);
+		vst1q_f32(el_2D[1], c.val[1]);
+		vst1q_f32(el_2D[2], c.val[2]);
+		vst1q_f32(el_2D[3], c.val[3]);
+		return *this;
+	#else
+		return TransposeScalar();
+	#endif
+	}
+
+	mat4 TransposeScalar()
 	{
 		mat4 ret(*this);
 
@@ -982,4 +1197,132 @@ inline vec3 triangle_normal(vec4 p0, vec4 p1, vec4 p2)
 	vec3 b = normalize(vec3(p2 - p0));
 	return /*wtf*/ normalize(cross(a, b));
 }
+
+//
+// Batch transform: out[i] = m * in[i]. Strides are in bytes, so vec4 members of structures can be transformed in place.
+// Columns of matrix are loaded once for whole batch. Results are equal to mat4 * vec4.
+//
+inline void transformPoints(const mat4& m, const void *in, size_t inStride, void *out, size_t outStride, size_t n)
+{
+	const char *src = static_cast<const char*>(in);
+	char *dst = static_cast<char*>(out);
+
+#if defined(VECTOR_MATH_SSE)
+	__m128 c0 = _mm_loadu_ps(m.el_2D[0]);
+	__m128 c1 = _mm_loadu_ps(m.el_2D[1]);
+	__m128 c2 = _mm_loadu_ps(m.el_2D[2]);
+	__m128 c3 = _mm_loadu_ps(m.el_2D[3]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+	for (size_t i = 0; i < n; i++, src += inStride, dst += outStride)
+	{
+		__m128 v = _mm_loadu_ps(reinterpret_cast<const float*>(src));
+		__m128 r = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), c0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), c1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), c2));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), c3));
+		_mm_storeu_ps(reinterpret_cast<float*>(dst), r);
+	}
+#elif defined(VECTOR_MATH_NEON)
+	float32x4x4_t c = vld4q_f32(m.el_1D);
+
+	for (size_t i = 0; i < n; i++, src += inStride, dst += outStride)
+	{
+		float32x4_t v = vld1q_f32(reinterpret_cast<const float*>(src));
+		float32x4_t r = vmulq_laneq_f32(c.val[0], v, 0);
+		r = vaddq_f32(r, vmulq_laneq_f32(c.val[1], v, 1));
+		r = vaddq_f32(r, vmulq_laneq_f32(c.val[2], v, 2));
+		r = vaddq_f32(r, vmulq_laneq_f32(c.val[3], v, 3));
+		vst1q_f32(reinterpret_cast<float*>(dst), r);
+	}
+#else
+	for (size_t i = 0; i < n; i++, src += inStride, dst += outStride)
+		*reinterpret_cast<vec4*>(dst) = m.MultiplyScalar(*reinterpret_cast<const vec4*>(src));
+#endif
+}
+
+inline void transformPoints(const mat4& m, const vec4 *in, vec4 *out, size_t n)
+{
+#if defined(VECTOR_MATH_AVX)
+	// two points per iteration, columns are duplicated in both 128-bit lanes
+	__m128 c0 = _mm_loadu_ps(m.el_2D[0]);
+	__m128 c1 = _mm_loadu_ps(m.el_2D[1]);
+	__m128 c2 = _mm_loadu_ps(m.el_2D[2]);
+	__m128 c3 = _mm_loadu_ps(m.el_2D[3]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+	__m256 cc0 = _mm256_set_m128(c0, c0);
+	__m256 cc1 = _mm256_set_m128(c1, c1);
+	__m256 cc2 = _mm256_set_m128(c2, c2);
+	__m256 cc3 = _mm256_set_m128(c3, c3);
+
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m256 v = _mm256_loadu_ps(in[i].xyzw);
+		__m256 r = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)), cc0);
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), cc1));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), cc2));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3)), cc3));
+		_mm256_storeu_ps(out[i].xyzw, r);
+	}
+
+	if (i < n)
+		transformPoints(m, in + i, sizeof(vec4), out + i, sizeof(vec4), n - i);
+#else
+	transformPoints(m, in, sizeof(vec4), out, sizeof(vec4), n);
+#endif
+}
+
+bool BenchmarkVectorMath(size_t points = 1 << 20); // false if SIMD results differ from scalar ones
+
+struct AABB
+{
+	vec3 vmin;
+	vec3 vmax;
+
+	vec3 Center() const { return (vmin + vmax) * 0.5f; }
+	vec3 Extent() const { return (vmax - vmin) * 0.5f; }
+
+	float Area() const
+	{
+		vec3 d = vmax - vmin;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	bool Contains(const AABB& b) const
+	{
+		return vmin.x <= b.vmin.x && vmin.y <= b.vmin.y && vmin.z <= b.vmin.z &&
+			b.vmax.x <= vmax.x && b.vmax.y <= vmax.y && b.vmax.z <= vmax.z;
+	}
+
+	AABB Union(const AABB& b) const
+	{
+		return { vec3(min(vmin.x, b.vmin.x), min(vmin.y, b.vmin.y), min(vmin.z, b.vmin.z)),
+				 vec3(max(vmax.x, b.vmax.x), max(vmax.y, b.vmax.y), max(vmax.z, b.vmax.z)) };
+	}
+
+	AABB Expand(float v) const
+	{
+		return { vmin - vec3(v, v, v), vmax + vec3(v, v, v) };
+	}
+
+	//
+	// Bounds of the transformed box (center/extent form, no 8 corners)
+	//
+	AABB Transform(const mat4& m) const
+	{
+		vec3 c = Center();
+		vec3 e = Extent();
+		vec3 wc, we;
+
+		for (int i = 0; i < 3; i++)
+		{
+			wc.xyz[i] = m.el_2D[i][0] * c.x + m.el_2D[i][1] * c.y + m.el_2D[i][2] * c.z + m.el_2D[i][3];
+			we.xyz[i] = std::abs(m.el_2D[i][0]) * e.x + std::abs(m.el_2D[i][1]) * e.y + std::abs(m.el_2D[i][2]) * e.z;
+		}
+
+		return { wc - we, wc + we };
+	}
+};
 #pragma warning(default : 4201)
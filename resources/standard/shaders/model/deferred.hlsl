@@ -4,16 +4,15 @@
 
 #ifdef ENG_SHADER_PIXEL
 
+	// only material params: block is owned and uploaded by material,
+	// uv transforms of textures are in cbuffers of TEXTURE_DECL
 	cbuffer material_parameters
 	{
-		float4 main_color;
-		float4 camera_position;
 		float4 base_color;
 		float roughness;
 		float metalness;
 		float reflectivity;
 		float normal_intensity;
-		float4 albedo_uv;
 	};
 
 	#if defined(ENG_INPUT_TEXCOORD) && defined(albedo_map)
@@ -17,13 +17,24 @@ struct VS_OUT
 
 #ifdef ENG_SHADER_VERTEX
 
-	cbuffer vertex_transformation_parameters
-	{
-		float4x4 MVP;
-		float4x4 MVP_prev;
-		float4x4 M;
-		float4x4 NM;
-	};
+	#ifdef ENG_INSTANCED
+		struct InstanceTransformation
+		{
+			row_major float4x4 MVP;
+			row_major float4x4 MVP_prev;
+			row_major float4x4 M;
+			row_major float4x4 NM;
+		};
+		StructuredBuffer<InstanceTransformation> instance_buffer : register(t15);
+	#else
+		cbuffer vertex_transformation_parameters
+		{
+			float4x4 MVP;
+			float4x4 MVP_prev;
+			float4x4 M;
+			float4x4 NM;
+		};
+	#endif
 
 	struct VS_IN
 	{
@@ -37,10 +48,20 @@ struct VS_OUT
 		#ifdef ENG_INPUT_COLOR
 			float4 ColorIn : TEXCOORD3;
 		#endif
+		#ifdef ENG_INSTANCED
+			uint instance : SV_INSTANCEID;
+		#endif
 	};
 
 	VS_OUT mainVS(VS_IN vs_input)
 	{
+		#ifdef ENG_INSTANCED
+			float4x4 MVP = instance_buffer[vs_input.instance].MVP;
+			float4x4 MVP_prev = instance_buffer[vs_input.instance].MVP_prev;
+			float4x4 M = instance_buffer[vs_input.instance].M;
+			float4x4 NM = instance_buffer[vs_input.instance].NM;
+		#endif
+
 		VS_OUT vs_output;
 		vs_output.position = mul(MVP, vs_input.PositionIn);
 
@@ -46,6 +46,7 @@ EditorCore::EditorCore(QApplication& app) : app_(app)
 void EditorCore::onEngineInited()
 {
 	resMan->AddCallbackOnObjAdded(onEngineObejctAdded);
+	resMan->AddCallbackOnObjectsAdded(onEngineObjectsAdded);
 	resMan->AddCallbackOnDestroy(onEngineObejctDestroyed);
 
 	//dbg
@@ -218,13 +219,13 @@ void EditorCore::DestroyGameObject(GameObject *obj)
 	resMan->DestroyObject(obj);
 }
 
-void EditorCore::onEngineObejctAdded(GameObject *obj)
+auto EditorCore::addTreeNode(GameObject *obj) -> TreeNode*
 {
 	auto it = editor->obj_to_treenode.find(obj);
 	if (it != editor->obj_to_treenode.end())
 	{
 		qDebug() << "it should not be happened";
-		return;
+		return nullptr;
 	}
 
 	// dbg
@@ -239,6 +240,28 @@ void EditorCore::onEngineObejctAdded(GameObject *obj)
 	parentNode->appendChild(node);
 	editor->obj_to_treenode[obj] = node;
 
+	return node;
+}
+
+void EditorCore::onEngineObjectsAdded(GameObject *const *objects, size_t num)
+{
+	// parents go before childs, so parent nodes already exist
+	TreeNode *last = nullptr;
+	for (size_t i = 0; i < num; i++)
+		if (TreeNode *node = addTreeNode(objects[i]))
+			last = node;
+
+	// one layout update for the whole world
+	if (last)
+		emit editor->OnObjectAdded(last);
+}
+
+void EditorCore::onEngineObejctAdded(GameObject *obj)
+{
+	TreeNode *node = addTreeNode(obj);
+	if (!node)
+		return;
+
 	emit editor->OnObjectAdded(node);
 
 	if (!editor->preventFocusOnWorldLoad)
@@ -54,6 +54,8 @@ class EditorCore : public QObject
 	void onEngineInited();
 	void onEngineFree();
 	static void onEngineObejctAdded(GameObject *obj);
+	static void onEngineObjectsAdded(GameObject *const *objects, size_t num);
+	static auto addTreeNode(GameObject *obj) -> TreeNode*;
 	static void onEngineObejctDestroyed(GameObject *obj);
 
 public:
@@ -0,0 +1,431 @@
+#include "pch.h"
+#include "aabb_tree.h"
+#include "core.h"
+#include <emmintrin.h>
+#include <chrono>
+#include <random>
+
+#define AABB_TREE_MARGIN 0.1f // relative to box size
+
+
+Frustum::Frustum(const mat4& VP)
+{
+	auto row = [&VP](int i) -> vec4
+	{
+		return vec4(VP.el_2D[i][0], VP.el_2D[i][1], VP.el_2D[i][2], VP.el_2D[i][3]);
+	};
+
+	vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+	// clip space: -w <= x <= w, -w <= y <= w, 0 <= z <= w
+	vec4 planes[6] = { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r2, r3 - r2 };
+
+	for (int i = 0; i < 8; i++)
+	{
+		vec4 p = i < 6 ? planes[i] : vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		nx[i] = p.x;
+		ny[i] = p.y;
+		nz[i] = p.z;
+		d[i] = p.w;
+	}
+}
+
+CULL_RESULT CullAABB(const Frustum& f, const AABB& box)
+{
+	vec3 c = box.Center();
+	vec3 e = box.Extent();
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+	const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+
+	__m128 outside = zero;
+	__m128 intersect = zero;
+
+	for (int i = 0; i < 8; i += 4)
+	{
+		__m128 nx = _mm_load_ps(f.nx + i);
+		__m128 ny = _mm_load_ps(f.ny + i);
+		__m128 nz = _mm_load_ps(f.nz + i);
+
+		// signed distance of the center and projected radius of the box
+		__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(f.d + i)));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(nx, absMask), ex), _mm_mul_ps(_mm_and_ps(ny, absMask), ey)), _mm_mul_ps(_mm_and_ps(nz, absMask), ez));
+
+		outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+		intersect = _mm_or_ps(intersect, _mm_cmplt_ps(_mm_sub_ps(dist, radius), zero));
+	}
+
+	if (_mm_movemask_ps(outside))
+		return CULL_RESULT::OUTSIDE;
+
+	return _mm_movemask_ps(intersect) ? CULL_RESULT::INTERSECT : CULL_RESULT::INSIDE;
+}
+
+int AABBTree::allocate()
+{
+	if (freeList == -1)
+	{
+		nodes.emplace_back();
+		return (int)nodes.size() - 1;
+	}
+
+	int node = freeList;
+	freeList = nodes[node].parent;
+	nodes[node] = Node();
+	return node;
+}
+
+void AABBTree::release(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+void AABBTree::refit(int node)
+{
+	while (node != -1)
+	{
+		node = balance(node);
+
+		Node& n = nodes[node];
+		n.height = 1 + max(nodes[n.left].height, nodes[n.right].height);
+		n.box = nodes[n.left].box.Union(nodes[n.right].box);
+
+		node = n.parent;
+	}
+}
+
+void AABBTree::insertLeaf(int leaf)
+{
+	if (root == -1)
+	{
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	// find the best sibling by surface area
+	AABB leafBox = nodes[leaf].box;
+	int index = root;
+
+	while (!nodes[index].IsLeaf())
+	{
+		const Node& n = nodes[index];
+
+		float area = n.box.Area();
+		float combinedArea = n.box.Union(leafBox).Area();
+		float cost = 2.0f * combinedArea; // new parent for this node and the leaf
+		float inheritance = 2.0f * (combinedArea - area); // minimum cost of pushing the leaf further down
+
+		auto descendCost = [&](int child) -> float
+		{
+			const Node& c = nodes[child];
+			float childArea = c.box.Union(leafBox).Area();
+			return c.IsLeaf() ? childArea + inheritance : childArea - c.box.Area() + inheritance;
+		};
+
+		float costLeft = descendCost(n.left);
+		float costRight = descendCost(n.right);
+
+		if (cost < costLeft && cost < costRight)
+			break;
+
+		index = costLeft < costRight ? n.left : n.right;
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocate();
+
+	Node& p = nodes[newParent];
+	p.parent = oldParent;
+	p.box = nodes[sibling].box.Union(leafBox);
+	p.height = nodes[sibling].height + 1;
+	p.left = sibling;
+	p.right = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == -1)
+		root = newParent;
+	else if (nodes[oldParent].left == sibling)
+		nodes[oldParent].left = newParent;
+	else
+		nodes[oldParent].right = newParent;
+
+	refit(nodes[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+	nodes[sibling].parent = grandParent;
+	release(parent);
+
+	if (grandParent == -1)
+	{
+		root = sibling;
+		return;
+	}
+
+	if (nodes[grandParent].left == parent)
+		nodes[grandParent].left = sibling;
+	else
+		nodes[grandParent].right = sibling;
+
+	refit(grandParent);
+}
+
+//
+// Rotates the higher child up if subtrees differ in height by more than one.
+// Returns the index of the node that replaced 'iA'.
+//
+int AABBTree::balance(int iA)
+{
+	Node& A = nodes[iA];
+
+	if (A.IsLeaf() || A.height < 2)
+		return iA;
+
+	int iB = A.left;
+	int iC = A.right;
+	Node& B = nodes[iB];
+	Node& C = nodes[iC];
+
+	int diff = C.height - B.height;
+
+	auto replaceChild = [this](int parent, int oldChild, int newChild)
+	{
+		if (parent == -1)
+			root = newChild;
+		else if (nodes[parent].left == oldChild)
+			nodes[parent].left = newChild;
+		else
+			nodes[parent].right = newChild;
+	};
+
+	// rotate C up
+	if (diff > 1)
+	{
+		int iF = C.left;
+		int iG = C.right;
+		Node& F = nodes[iF];
+		Node& G = nodes[iG];
+
+		C.left = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+		replaceChild(C.parent, iA, iC);
+
+		if (F.height > G.height)
+		{
+			C.right = iF;
+			A.right = iG;
+			G.parent = iA;
+			A.box = B.box.Union(G.box);
+			C.box = A.box.Union(F.box);
+			A.height = 1 + max(B.height, G.height);
+			C.height = 1 + max(A.height, F.height);
+		}
+		else
+		{
+			C.right = iG;
+			A.right = iF;
+			F.parent = iA;
+			A.box = B.box.Union(F.box);
+			C.box = A.box.Union(G.box);
+			A.height = 1 + max(B.height, F.height);
+			C.height = 1 + max(A.height, G.height);
+		}
+
+		return iC;
+	}
+
+	// rotate B up
+	if (diff < -1)
+	{
+		int iD = B.left;
+		int iE = B.right;
+		Node& D = nodes[iD];
+		Node& E = nodes[iE];
+
+		B.left = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+		replaceChild(B.parent, iA, iB);
+
+		if (D.height > E.height)
+		{
+			B.right = iD;
+			A.left = iE;
+			E.parent = iA;
+			A.box = C.box.Union(E.box);
+			B.box = A.box.Union(D.box);
+			A.height = 1 + max(C.height, E.height);
+			B.height = 1 + max(A.height, D.height);
+		}
+		else
+		{
+			B.right = iE;
+			A.left = iD;
+			D.parent = iA;
+			A.box = C.box.Union(D.box);
+			B.box = A.box.Union(E.box);
+			A.height = 1 + max(C.height, D.height);
+			B.height = 1 + max(A.height, E.height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+auto AABBTree::Insert(const AABB& box, void *data) -> int
+{
+	int leaf = allocate();
+
+	Node& n = nodes[leaf];
+	n.box = box.Expand(AABB_TREE_MARGIN * box.Extent().Lenght());
+	n.data = data;
+
+	insertLeaf(leaf);
+	leaves++;
+
+	return leaf;
+}
+
+auto AABBTree::Remove(int proxy) -> void
+{
+	assert(proxy >= 0 && proxy < (int)nodes.size() && nodes[proxy].IsLeaf());
+
+	removeLeaf(proxy);
+	release(proxy);
+	leaves--;
+}
+
+auto AABBTree::Move(int proxy, const AABB& box) -> bool
+{
+	if (nodes[proxy].box.Contains(box))
+		return false;
+
+	removeLeaf(proxy);
+	nodes[proxy].box = box.Expand(AABB_TREE_MARGIN * box.Extent().Lenght());
+	insertLeaf(proxy);
+
+	return true;
+}
+
+auto AABBTree::Query(const Frustum& f, std::vector<void*>& out) -> void
+{
+	if (root == -1)
+		return;
+
+	// nodes entirely inside the frustum are pushed as ~index and not tested again
+	stack.clear();
+	stack.push_back(root);
+
+	while (!stack.empty())
+	{
+		int entry = stack.back();
+		stack.pop_back();
+
+		bool inside = entry < 0;
+		const Node& n = nodes[inside ? ~entry : entry];
+
+		if (!inside)
+		{
+			CULL_RESULT r = CullAABB(f, n.box);
+			if (r == CULL_RESULT::OUTSIDE)
+				continue;
+			inside = r == CULL_RESULT::INSIDE;
+		}
+
+		if (n.IsLeaf())
+		{
+			out.push_back(n.data);
+			continue;
+		}
+
+		stack.push_back(inside ? ~n.left : n.left);
+		stack.push_back(inside ? ~n.right : n.right);
+	}
+}
+
+auto AABBTree::Clear() -> void
+{
+	nodes.clear();
+	root = -1;
+	freeList = -1;
+	leaves = 0;
+}
+
+void BenchmarkAABBTree(uint instances)
+{
+	using clock = std::chrono::steady_clock;
+	auto ms = [](clock::time_point from) -> float
+	{
+		return std::chrono::duration<float, std::milli>(clock::now() - from).count();
+	};
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<float> pos(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+
+	vector<AABB> boxes(instances);
+	for (AABB& b : boxes)
+	{
+		vec3 c(pos(gen), pos(gen), pos(gen));
+		vec3 e(size(gen), size(gen), size(gen));
+		b = { c - e, c + e };
+	}
+
+	Frustum frustum(perspectiveRH_ZO(60.0f * DEGTORAD, 16.0f / 9.0f, 0.1f, 1000.0f)); // camera in the origin looks along -Z
+
+	AABBTree tree;
+	vector<int> proxies(instances);
+	vector<void*> visible;
+	visible.reserve(instances);
+
+	clock::time_point t = clock::now();
+	for (uint i = 0; i < instances; i++)
+		proxies[i] = tree.Insert(boxes[i], &boxes[i]);
+	float buildMs = ms(t);
+
+	uint reinserted = 0;
+	t = clock::now();
+	for (uint i = 0; i < instances; i++)
+	{
+		vec3 d(step(gen), step(gen), step(gen));
+		boxes[i] = { boxes[i].vmin + d, boxes[i].vmax + d };
+		reinserted += tree.Move(proxies[i], boxes[i]);
+	}
+	float moveMs = ms(t);
+
+	t = clock::now();
+	tree.Query(frustum, visible);
+	float queryMs = ms(t);
+
+	uint bruteVisible = 0;
+	t = clock::now();
+	for (uint i = 0; i < instances; i++)
+		bruteVisible += CullAABB(frustum, boxes[i]) != CULL_RESULT::OUTSIDE;
+	float bruteMs = ms(t);
+
+	Log("AABBTree benchmark: %u instances, height %i", instances, tree.GetHeight());
+	Log("  build %.2f ms, move %.2f ms (%u reinserted)", buildMs, moveMs, reinserted);
+	Log("  tree query %.3f ms (%u visible), brute force %.3f ms (%u visible)", queryMs, (uint)visible.size(), bruteMs, bruteVisible);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "common.h"
+
+//
+// View frustum planes in SoA layout for SSE tests.
+// 6 planes are padded to 8 with planes that always pass.
+//
+struct Frustum
+{
+	alignas(16) float nx[8];
+	alignas(16) float ny[8];
+	alignas(16) float nz[8];
+	alignas(16) float d[8];
+
+	Frustum(const mat4& VP);
+};
+
+enum class CULL_RESULT
+{
+	OUTSIDE,
+	INTERSECT,
+	INSIDE
+};
+
+CULL_RESULT CullAABB(const Frustum& f, const AABB& box);
+
+//
+// Dynamic bounding volume hierarchy.
+// Leaves keep fat boxes so small moves don't touch the tree.
+//
+class AABBTree
+{
+	struct Node
+	{
+		AABB box;
+		void *data{};
+		int parent{-1}; // next free node for released nodes
+		int left{-1};
+		int right{-1};
+		int height{}; // leaf = 0
+		bool IsLeaf() const { return left == -1; }
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int> stack;
+	int root{-1};
+	int freeList{-1};
+	int leaves{};
+
+	int allocate();
+	void release(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	void refit(int node);
+	int balance(int node);
+
+public:
+	auto Insert(const AABB& box, void *data) -> int; // returns proxy
+	auto Remove(int proxy) -> void;
+	auto Move(int proxy, const AABB& box) -> bool; // true if the leaf was reinserted
+	auto Query(const Frustum& f, std::vector<void*>& out) -> void;
+	auto GetData(int proxy) const -> void* { return nodes[proxy].data; }
+	auto GetLeaves() const -> int { return leaves; }
+	auto GetHeight() const -> int { return root == -1 ? 0 : nodes[root].height; }
+	auto Clear() -> void;
+};
+
+void BenchmarkAABBTree(uint instances = 100000);
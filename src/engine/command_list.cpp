@@ -0,0 +1,192 @@
+#include "pch.h"
+#include "command_list.h"
+#include "core.h"
+#include "shader.h"
+#include "material.h"
+#include "structured_buffer.h"
+
+// Payloads of commands. Data is copied with memcpy: buffer has no alignment
+struct ShaderCommand
+{
+	Shader *shader;
+};
+
+struct MaterialCommand
+{
+	Material *mat;
+	Shader *shader;
+	PASS pass;
+};
+
+struct Mat4Command
+{
+	Shader *shader;
+	int handle;
+	mat4 value;
+};
+
+struct UintCommand
+{
+	Shader *shader;
+	int handle;
+	uint value;
+};
+
+struct BufferDataCommand
+{
+	StructuredBuffer *buffer; // data follows
+};
+
+struct BindBufferCommand
+{
+	int unit;
+	StructuredBuffer *buffer;
+};
+
+struct DrawCommand
+{
+	Mesh *mesh;
+	uint instances;
+};
+
+template<typename T>
+static T readCommand(const uint8 *p)
+{
+	T cmd;
+	memcpy(&cmd, p, sizeof(T));
+	return cmd;
+}
+
+void CommandList::Reset()
+{
+	data.clear();
+	commands = 0;
+}
+
+auto CommandList::push(RENDER_COMMAND type, const void *cmd, size_t cmdBytes, size_t extraBytes) -> uint8*
+{
+	const Header h{type, uint32_t(cmdBytes + extraBytes)};
+
+	const size_t pos = data.size();
+	data.resize(pos + sizeof(Header) + h.size);
+
+	uint8 *p = data.data() + pos;
+	memcpy(p, &h, sizeof(Header));
+	memcpy(p + sizeof(Header), cmd, cmdBytes);
+
+	commands++;
+	return p + sizeof(Header) + cmdBytes;
+}
+
+void CommandList::SetShader(Shader *shader)
+{
+	const ShaderCommand cmd{shader};
+	push(RENDER_COMMAND::SET_SHADER, &cmd, sizeof(cmd));
+}
+
+void CommandList::UploadMaterial(Material *mat, Shader *shader, PASS pass)
+{
+	const MaterialCommand cmd{mat, shader, pass};
+	push(RENDER_COMMAND::UPLOAD_MATERIAL, &cmd, sizeof(cmd));
+}
+
+void CommandList::SetMat4Parameter(Shader *shader, int handle, const mat4& value)
+{
+	const Mat4Command cmd{shader, handle, value};
+	push(RENDER_COMMAND::SET_MAT4_PARAMETER, &cmd, sizeof(cmd));
+}
+
+void CommandList::SetUintParameter(Shader *shader, int handle, uint value)
+{
+	const UintCommand cmd{shader, handle, value};
+	push(RENDER_COMMAND::SET_UINT_PARAMETER, &cmd, sizeof(cmd));
+}
+
+void CommandList::FlushParameters(Shader *shader)
+{
+	const ShaderCommand cmd{shader};
+	push(RENDER_COMMAND::FLUSH_PARAMETERS, &cmd, sizeof(cmd));
+}
+
+auto CommandList::SetStructuredBufferData(StructuredBuffer *buffer, size_t size) -> void*
+{
+	const BufferDataCommand cmd{buffer};
+	return push(RENDER_COMMAND::SET_STRUCTURED_BUFFER_DATA, &cmd, sizeof(cmd), size);
+}
+
+void CommandList::BindStructuredBuffer(int unit, StructuredBuffer *buffer)
+{
+	const BindBufferCommand cmd{unit, buffer};
+	push(RENDER_COMMAND::BIND_STRUCTURED_BUFFER, &cmd, sizeof(cmd));
+}
+
+void CommandList::Draw(Mesh *mesh, uint instances)
+{
+	const DrawCommand cmd{mesh, instances};
+	push(RENDER_COMMAND::DRAW, &cmd, sizeof(cmd));
+}
+
+void CommandList::Submit()
+{
+	for (size_t pos = 0; pos < data.size();)
+	{
+		const Header h = readCommand<Header>(data.data() + pos);
+		uint8 *payload = data.data() + pos + sizeof(Header);
+
+		switch (h.type)
+		{
+			case RENDER_COMMAND::SET_SHADER:
+				CORE_RENDER->SetShader(readCommand<ShaderCommand>(payload).shader);
+				break;
+
+			case RENDER_COMMAND::UPLOAD_MATERIAL:
+			{
+				const MaterialCommand cmd = readCommand<MaterialCommand>(payload);
+				cmd.mat->UploadShaderParameters(cmd.shader, cmd.pass);
+				cmd.mat->BindShaderTextures(cmd.shader, cmd.pass);
+				break;
+			}
+
+			case RENDER_COMMAND::SET_MAT4_PARAMETER:
+			{
+				const Mat4Command cmd = readCommand<Mat4Command>(payload);
+				cmd.shader->SetMat4Parameter(cmd.handle, &cmd.value);
+				break;
+			}
+
+			case RENDER_COMMAND::SET_UINT_PARAMETER:
+			{
+				const UintCommand cmd = readCommand<UintCommand>(payload);
+				cmd.shader->SetUintParameter(cmd.handle, cmd.value);
+				break;
+			}
+
+			case RENDER_COMMAND::FLUSH_PARAMETERS:
+				readCommand<ShaderCommand>(payload).shader->FlushParameters();
+				break;
+
+			case RENDER_COMMAND::SET_STRUCTURED_BUFFER_DATA:
+			{
+				const BufferDataCommand cmd = readCommand<BufferDataCommand>(payload);
+				cmd.buffer->SetData(payload + sizeof(cmd), h.size - sizeof(cmd));
+				break;
+			}
+
+			case RENDER_COMMAND::BIND_STRUCTURED_BUFFER:
+			{
+				const BindBufferCommand cmd = readCommand<BindBufferCommand>(payload);
+				CORE_RENDER->BindStructuredBuffer(cmd.unit, cmd.buffer);
+				break;
+			}
+
+			case RENDER_COMMAND::DRAW:
+			{
+				const DrawCommand cmd = readCommand<DrawCommand>(payload);
+				CORE_RENDER->Draw(cmd.mesh, cmd.instances);
+				break;
+			}
+		}
+
+		pos += sizeof(Header) + h.size;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "common.h"
+
+enum class RENDER_COMMAND : uint8
+{
+	SET_SHADER,
+	UPLOAD_MATERIAL,			// parameters and textures of material for pass
+	SET_MAT4_PARAMETER,
+	SET_UINT_PARAMETER,
+	FLUSH_PARAMETERS,
+	SET_STRUCTURED_BUFFER_DATA,
+	BIND_STRUCTURED_BUFFER,
+	DRAW,
+};
+
+//
+// Backend-neutral list of render commands.
+// Recording doesn't touch CORE_RENDER, so lists can be filled on worker threads in parallel,
+// render thread submits them in order by replay.
+// Commands are packed to one byte buffer (header and payload), matrices and buffer data are copied.
+//
+// Objects referenced by commands must live until Submit().
+// Everything that can create resources (shaders, constant buffers of materials) must be resolved
+// before recording or deferred to Submit() as UploadMaterial() does.
+//
+class CommandList
+{
+	struct Header
+	{
+		RENDER_COMMAND type;
+		uint32_t size; // of payload
+	};
+
+	vector<uint8> data;
+	uint commands{0};
+
+	auto push(RENDER_COMMAND type, const void *cmd, size_t cmdBytes, size_t extraBytes = 0) -> uint8*; // returns extra bytes
+
+public:
+	void Reset(); // keeps capacity
+
+	void SetShader(Shader *shader);
+	void UploadMaterial(Material *mat, Shader *shader, PASS pass);
+	void SetMat4Parameter(Shader *shader, int handle, const mat4& value);
+	void SetUintParameter(Shader *shader, int handle, uint value);
+	void FlushParameters(Shader *shader);
+	auto SetStructuredBufferData(StructuredBuffer *buffer, size_t size) -> void*; // returned memory is filled by caller, valid until next command
+	void BindStructuredBuffer(int unit, StructuredBuffer *buffer);
+	void Draw(Mesh *mesh, uint instances);
+
+	void Submit(); // render thread only
+
+	auto GetCommands() const -> uint { return commands; }
+	auto GetBytes() const -> size_t { return data.size(); }
+};
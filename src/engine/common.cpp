@@ -12,8 +12,6 @@
 
 namespace fs = std::filesystem;
 
-static std::set<int> instances_id;
-
 string msaa_to_string(int samples)
 {
 	if (samples <= 1)
@@ -64,16 +62,6 @@ int currentTime()
 	return (int)time(NULL);
 }
 
-bool isIsFree(int id)
-{
-	return instances_id.find(id) != instances_id.end();
-}
-
-void addId(int id)
-{
-	instances_id.insert(id);
-}
-
 size_t blockSize(TEXTURE_FORMAT compressedFormat)
 {
 	assert(compressedFormat == TEXTURE_FORMAT::DXT1 || compressedFormat == TEXTURE_FORMAT::DXT3 || compressedFormat == TEXTURE_FORMAT::DXT5);
@@ -89,9 +77,10 @@ size_t bytesPerPixel(TEXTURE_FORMAT format)
 		case TEXTURE_FORMAT::R8:		return 1;
 		case TEXTURE_FORMAT::RG8:		return 2;
 		case TEXTURE_FORMAT::RGBA8:		return 4;
-		case TEXTURE_FORMAT::R16F:		return 1;
-		case TEXTURE_FORMAT::RG16F:		return 2;
-		case TEXTURE_FORMAT::RGBA16F:	return 4;
+		case TEXTURE_FORMAT::BGRA8:		return 4;
+		case TEXTURE_FORMAT::R16F:		return 2;
+		case TEXTURE_FORMAT::RG16F:		return 4;
+		case TEXTURE_FORMAT::RGBA16F:	return 8;
 		case TEXTURE_FORMAT::R32F:		return 4;
 		case TEXTURE_FORMAT::RG32F:		return 8;
 		case TEXTURE_FORMAT::RGBA32F:	return 16;
@@ -284,10 +273,7 @@ void StreamPtr<T>::release()
 	if (resource_)
 	{
 		resource_->decRef();
-		if (resource_->getRefs() == 0)
-		{
-			resource_->free();
-		}
+		// unreferenced resource is unloaded by ResourceManager: extracted frame may still use it
 		assert(resource_->getRefs()>=0);
 		resource_ = nullptr;
 	}
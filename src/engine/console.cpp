@@ -5,16 +5,20 @@
 #include "console_window.h"
 
 #define LOG_FILE "\\log.txt"
-#define MAX_CHARS 10000
+#define WRITER_WAIT_MS 10
+
+static thread_local bool isWriterThread; // writer can't wait for itself
 
 Console::Console()
 {
-	tmpbuf = std::unique_ptr<char[]>(new char[MAX_CHARS]);
+	queue = std::unique_ptr<Message[]>(new Message[LOG_QUEUE_SIZE]);
+	for (size_t i = 0; i < LOG_QUEUE_SIZE; i++)
+		queue[i].sequence.store(i, std::memory_order_relaxed);
 }
 
 Console::~Console()
 {
-	tmpbuf.reset();
+	queue.reset();
 }
 
 void Console::Init(bool createWindow)
@@ -31,10 +35,32 @@ void Console::Init(bool createWindow)
 		window = new ConsoleWindow;
 		window->Init();
 	}
+
+	stopWriter = false;
+	writerExited = false;
+	running = true;
+	writer = std::thread(&Console::writerLoop, this);
 }
 
 void Console::Free()
 {
+	if (writer.joinable())
+	{
+		// new messages are written directly, pushes in progress are finished
+		running = false;
+		while (pushing.load() > 0)
+			std::this_thread::yield();
+
+		{
+			std::lock_guard<std::mutex> lock(writerMtx);
+			stopWriter = true;
+		}
+		writerCV.notify_one();
+		writer.join();
+	}
+
+	Update();
+
 	if (window)
 	{
 		window->Destroy();
@@ -43,6 +69,24 @@ void Console::Free()
 	}
 }
 
+void Console::Update()
+{
+	{
+		std::lock_guard<std::mutex> lock(dispatchMtx);
+		dispatch.swap(dispatchTmp);
+	}
+
+	for (auto& m : dispatchTmp)
+	{
+		if (window)
+			window->OutputTxt(m.second.c_str());
+
+		onLog.Invoke(m.second.c_str(), m.first);
+	}
+
+	dispatchTmp.clear();
+}
+
 void Console::Show()
 {
 	if (window)
@@ -55,8 +99,75 @@ void Console::Hide()
 		window->Hide();
 }
 
-auto DLLEXPORT Console::Log(const char *msg, LOG_TYPE type) -> void
+void Console::Flush()
+{
+	if (!running || isWriterThread)
+		return;
+
+	waitWritten(enqueuePos.load(std::memory_order_acquire));
+}
+
+bool Console::push(const char *msg, LOG_TYPE type, bool fileOnly)
 {
+	size_t pos = enqueuePos.load(std::memory_order_relaxed);
+	Message *m;
+
+	for (;;)
+	{
+		m = &queue[pos & (LOG_QUEUE_SIZE - 1)];
+		size_t seq = m->sequence.load(std::memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+		if (dif == 0)
+		{
+			if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (dif < 0)
+		{
+			if (isWriterThread)
+				return false;
+
+			// queue is full, wait for writer
+			writerCV.notify_one();
+			std::this_thread::yield();
+			pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+		else
+			pos = enqueuePos.load(std::memory_order_relaxed);
+	}
+
+	const size_t len = strlen(msg);
+	if (len < LOG_MESSAGE_SIZE)
+		memcpy(m->text, msg, len + 1);
+	else
+	{
+		m->longText.reset(new char[len + 1]);
+		memcpy(m->longText.get(), msg, len + 1);
+	}
+	m->type = type;
+	m->fileOnly = fileOnly;
+	m->sequence.store(pos + 1, std::memory_order_release);
+
+	// make sure message is in file before possible crash
+	if ((type == LOG_TYPE::CRITICAL || type == LOG_TYPE::FATAL) && !isWriterThread)
+		waitWritten(pos + 1);
+
+	return true;
+}
+
+void Console::waitWritten(size_t pos)
+{
+	std::unique_lock<std::mutex> lock(writerMtx);
+	writerCV.notify_one();
+	writtenCV.wait(lock, [this, pos]() { return written.load(std::memory_order_acquire) >= pos || writerExited; });
+}
+
+// Used before Init(), after Free() and by writer thread when queue is full
+void Console::writeDirect(const char *msg, LOG_TYPE type)
+{
+	std::lock_guard<std::mutex> lock(directMtx);
+
 	string fullPath = _core->GetWorkingPath() + LOG_FILE;
 
 	FileSystem *fs = _core->GetFilesystem();
@@ -73,6 +184,121 @@ auto DLLEXPORT Console::Log(const char *msg, LOG_TYPE type) -> void
 	onLog.Invoke(msg, type);
 }
 
+void Console::writerLoop()
+{
+	isWriterThread = true;
+
+	string fullPath = _core->GetWorkingPath() + LOG_FILE;
+	File f = FS->OpenFile(fullPath.c_str(), FILE_OPEN_MODE::APPEND);
+
+	string batch;
+	string out;
+	vector<std::pair<LOG_TYPE, std::string>> toDispatch;
+
+	for (;;)
+	{
+		// read before draining: all pushes are finished when stop is requested,
+		// so this drain gets the rest of messages
+		bool stop;
+		{
+			std::lock_guard<std::mutex> lock(writerMtx);
+			stop = stopWriter;
+		}
+
+		bool critical = false;
+		size_t read = 0;
+
+		for (;;)
+		{
+			Message& m = queue[dequeuePos & (LOG_QUEUE_SIZE - 1)];
+			if (m.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+				break;
+
+			const char *text = m.longText ? m.longText.get() : m.text;
+
+			batch += text;
+			batch += '\n';
+
+			if (!m.fileOnly)
+			{
+				out += text;
+				out += '\n';
+				toDispatch.emplace_back(m.type, text);
+			}
+
+			critical |= m.type == LOG_TYPE::CRITICAL || m.type == LOG_TYPE::FATAL;
+
+			m.longText.reset();
+			m.sequence.store(dequeuePos + LOG_QUEUE_SIZE, std::memory_order_release);
+			dequeuePos++;
+
+			if (++read == LOG_QUEUE_SIZE)
+				break;
+		}
+
+		if (read)
+		{
+			f.Write(reinterpret_cast<const uint8*>(batch.data()), batch.size());
+			batch.clear();
+
+			if (!out.empty())
+			{
+				std::cout << out << std::flush;
+				out.clear();
+			}
+
+			if (!toDispatch.empty())
+			{
+				std::lock_guard<std::mutex> lock(dispatchMtx);
+				for (auto& m : toDispatch)
+					dispatch.push_back(std::move(m));
+				toDispatch.clear();
+			}
+		}
+
+		bool drained = queue[dequeuePos & (LOG_QUEUE_SIZE - 1)].sequence.load(std::memory_order_acquire) != dequeuePos + 1;
+
+		if (read && (drained || critical))
+		{
+			f.Stream().flush();
+
+			{
+				std::lock_guard<std::mutex> lock(writerMtx);
+				written.store(dequeuePos, std::memory_order_release);
+			}
+			writtenCV.notify_all();
+		}
+
+		if (!drained)
+			continue;
+
+		if (stop)
+			break;
+
+		std::unique_lock<std::mutex> lock(writerMtx);
+
+		if (!stopWriter)
+			writerCV.wait_for(lock, std::chrono::milliseconds(WRITER_WAIT_MS));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(writerMtx);
+		writerExited = true;
+	}
+	writtenCV.notify_all();
+}
+
+auto DLLEXPORT Console::Log(const char *msg, LOG_TYPE type) -> void
+{
+	// Free() waits for pushing, so message pushed after running check is still written
+	pushing++;
+	bool pushed = running && push(msg, type, false);
+	pushing--;
+
+	if (!pushed)
+		writeDirect(msg, type);
+}
+
 auto DLLEXPORT Console::AddCallback(ConsoleCallback c) -> void
 {
 	onLog.Add(c);
@@ -82,3 +308,69 @@ auto DLLEXPORT Console::RemoveCallback(ConsoleCallback c) -> void
 {
 	onLog.Erase(c);
 }
+
+void Console::BenchmarkLogging(uint threads, uint messagesPerThread)
+{
+	if (!running)
+	{
+		LogWarning("Console::BenchmarkLogging(): console is not inited");
+		return;
+	}
+
+	typedef std::chrono::high_resolution_clock clock;
+	auto ms = [](clock::time_point t) { return std::chrono::duration<float, std::milli>(clock::now() - t).count(); };
+
+	Flush();
+
+	// previous implementation: file is opened and closed for every message
+	uint directMessages = min(messagesPerThread, 2000u);
+	string fullPath = _core->GetWorkingPath() + LOG_FILE;
+
+	clock::time_point t = clock::now();
+	for (uint i = 0; i < directMessages; i++)
+	{
+		char buf[LOG_MESSAGE_SIZE];
+		snprintf(buf, LOG_MESSAGE_SIZE, "benchmark direct message %u", i);
+
+		File f = FS->OpenFile(fullPath.c_str(), FILE_OPEN_MODE::APPEND);
+		f.WriteStr(buf);
+		f.WriteStr("\n");
+	}
+	float directMs = ms(t);
+
+	::Log("Console::BenchmarkLogging():");
+	::Log("  direct, 1 thread: %.0f calls/s", directMessages / (directMs / 1000.0f));
+
+	for (uint n = 1; n <= threads; n++)
+	{
+		vector<std::thread> producers;
+		producers.reserve(n);
+
+		t = clock::now();
+
+		for (uint j = 0; j < n; j++)
+		{
+			producers.emplace_back([this, j, messagesPerThread]()
+			{
+				char buf[LOG_MESSAGE_SIZE];
+				for (uint i = 0; i < messagesPerThread; i++)
+				{
+					snprintf(buf, LOG_MESSAGE_SIZE, "benchmark thread %u message %u", j, i);
+					push(buf, LOG_TYPE::NORMAL, true);
+				}
+			});
+		}
+
+		for (std::thread& p : producers)
+			p.join();
+
+		float pushMs = ms(t);
+
+		Flush();
+
+		float totalMs = ms(t);
+		float calls = (float)n * messagesPerThread;
+
+		::Log("  async, %u threads: %.0f calls/s, %.0f written/s", n, calls / (pushMs / 1000.0f), calls / (totalMs / 1000.0f));
+	}
+}
@@ -5,10 +5,18 @@
 #include "filesystem.h"
 #include "camera.h"
 #include "console.h"
+#include "cpu_profiler.h"
 #include "render.h"
 #include "input.h"
 #include "main_window.h"
+#include "thread_pool.h"
+#include "frame_pipeline.h"
+#include "aabb_tree.h"
+#include "crc.h"
+#include "render_graph.h"
 #include "corerender/dx11/dx11corerender.h"
+#include "corerender/null/nullcorerender.h"
+#include "corerender/software/softwarecorerender.h"
 
 #define RESOURCE_DIR "\\resources"
 #define FPS_UPDATE_INTERVAL 0.3f
@@ -24,19 +32,20 @@ static size_t viewIDCounter{};
 int getMsaaSamples(INIT_FLAGS flags);
 int getVSync(INIT_FLAGS flags);
 
-uint Core::getNumLines()
+void Core::writeLines(TextArena& out)
 {
-	return 3;
-}
-
-std::string Core::getString(uint i)
-{
-	switch (i)
-	{
-		case 0: return "==== Core ====";
-		case 1: return "FPS: " + std::to_string(_fpsLazy);
-	}
-	return "";
+	const ResourceManager::UpdateTimings& t = resMan->GetUpdateTimings();
+
+	out.AddLine("==== Core ====");
+	out.AddLine("FPS: %i", _fpsLazy);
+	out.AddLine("Update transforms (ms): %f", t.transforms);
+	out.AddLine("Update objects (ms): %f", t.objects);
+	out.AddLine("Update residency (ms): %f", t.residency);
+	if (_pipelineStarted)
+		out.AddLine("Pipelined: main update (ms): %f, stage (ms): %f, render (ms): %f", _updateMs, framePipeline->GetStageMs(), _renderMs);
+	else
+		out.AddLine("Update (ms): %f, render (ms): %f", _updateMs, _renderMs);
+	out.AddLine("");
 }
 
 Core::Core()
@@ -47,6 +56,8 @@ Core::Core()
 	input = new Input;
 	render = new Render;
 	matManager = new MaterialManager;
+	threadPool = new ThreadPool;
+	framePipeline = new FramePipeline;
 
 	SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
 }
@@ -55,8 +66,13 @@ bool Core::Init(const char* rootPath, const WindowHandle* externHandle, INIT_FLA
 {
 	Log("--------- Core Initialization ---------");
 
+	CpuProfiler::Init();
+
 	fs->Init();
 
+	threadPool->Init(max(std::thread::hardware_concurrency(), 2u) - 1);
+	framePipeline->Init();
+
 	// root path
 	if (fs->IsRelative(rootPath))
 	{
@@ -78,7 +94,9 @@ bool Core::Init(const char* rootPath, const WindowHandle* externHandle, INIT_FLA
 	// data path
 	dataPath_ = rootPath_ + RESOURCE_DIR;
 
-	const bool createWindow = (flags & INIT_FLAGS::WINDOW_FLAG) != INIT_FLAGS::EXTERN_WINDOW && !externHandle;
+	const INIT_FLAGS library = flags & INIT_FLAGS::GRAPHIC_LIBRARY_FLAG;
+	const bool headless = library == INIT_FLAGS::NULL_RENDER || library == INIT_FLAGS::SOFTWARE_RENDER;
+	const bool createWindow = (flags & INIT_FLAGS::WINDOW_FLAG) != INIT_FLAGS::EXTERN_WINDOW && !externHandle && !headless;
 
 	console->Init(createWindow);
 
@@ -88,20 +106,20 @@ bool Core::Init(const char* rootPath, const WindowHandle* externHandle, INIT_FLA
 
 	AddProfilerCallback(this);
 
-	WindowHandle handle;
+	WindowHandle handle{};
 	if (createWindow)
 	{
 		window = new MainWindow(sMainLoop);
 		window->AddMessageCallback(sMessageCallback);
 		window->Create();
 		handle = *window->handle();
-	} else
+	} else if (externHandle)
 		handle = *externHandle;
 
 	MSAASamples = getMsaaSamples(flags);
 	VSync = getVSync(flags);
 
-	if (!initCoreRender(&handle))
+	if (!initCoreRender(&handle, flags))
 		return false;
 
 	resMan->Init();
@@ -114,9 +132,16 @@ bool Core::Init(const char* rootPath, const WindowHandle* externHandle, INIT_FLA
 	return true;
 }
 
-bool Core::initCoreRender(WindowHandle *handle)
+bool Core::initCoreRender(WindowHandle *handle, INIT_FLAGS flags)
 {	
-	coreRender = new DX11CoreRender;
+	const INIT_FLAGS library = flags & INIT_FLAGS::GRAPHIC_LIBRARY_FLAG;
+
+	if (library == INIT_FLAGS::NULL_RENDER)
+		coreRender = new NullCoreRender;
+	else if (library == INIT_FLAGS::SOFTWARE_RENDER)
+		coreRender = new SoftwareCoreRender;
+	else
+		coreRender = new DX11CoreRender;
 	return coreRender->Init(handle, MSAASamples, VSync);
 }
 
@@ -195,6 +220,16 @@ void Core::sMessageCallback(WINDOW_MESSAGE type, uint32 param1, uint32 param2, v
 
 void Core::engineUpdate()
 {
+	beginUpdate();
+	resMan->Update(_dt);
+	endUpdate();
+}
+
+void Core::beginUpdate()
+{
+	CpuProfiler::BeginFrame();
+	PROFILE_FUNCTION();
+
 	static float accum = 0.0f;
 
 	std::chrono::duration<float> _durationSec = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start);
@@ -213,31 +248,49 @@ void Core::engineUpdate()
 
 	start = std::chrono::steady_clock::now();
 
+	console->Update();
 	coreRender->Update();
 	render->Update();
 	input->Update();
-	resMan->Update(_dt);
-	onUpdate.Invoke(_dt);
+	matManager->Update();
+}
+
+void Core::endUpdate()
+{
+	{
+		PROFILE_SCOPE("onUpdate callbacks");
+		onUpdate.Invoke(_dt);
+	}
 
 	_frame++;
 }
 
-void Core::mainLoop()
+auto Core::getCameraData() -> Engine::CameraData
 {
-	engineUpdate();
+	uint w, h;
+	CORE_RENDER->GetViewport(&w, &h);
+	return getCameraData((float)w / h);
+}
 
-	if (camera)
-	{
-		uint w, h;
-		CORE_RENDER->GetViewport(&w, &h);
-		float aspect = (float)w / h;
+auto Core::getCameraData(float aspect) -> Engine::CameraData
+{
+	Engine::CameraData camData;
+	camData.ProjMat = camera->GetProjectionMatrix(aspect);
+	camData.ViewMat = camera->GetViewMatrix();
+	camData.verFullFovInRadians = camera->GetFovAngle() * DEGTORAD;
+	return camData;
+}
 
-		Engine::CameraData camData;
-		camData.ProjMat = camera->GetProjectionMatrix(aspect);
-		camData.ViewMat = camera->GetViewMatrix();
-		camData.verFullFovInRadians = camera->GetFovAngle() * DEGTORAD;
+auto Core::canPipelineFrames() -> bool
+{
+	return _framePipelining && camera && render->GetRenderPath() == RENDER_PATH::REALTIME;
+}
 
-		render->RenderFrame(0, camData, nullptr, 0);
+void Core::renderSerialFrame()
+{
+	if (camera)
+	{
+		render->RenderFrame(0, getCameraData(), nullptr, 0);
 		CORE_RENDER->SwapBuffers();
 	}else
 	{
@@ -246,8 +299,178 @@ void Core::mainLoop()
 	}
 }
 
+void Core::mainLoop()
+{
+	if (canPipelineFrames())
+	{
+		pipelinedLoop();
+		return;
+	}
+
+	stopFramePipeline();
+
+	auto t = std::chrono::steady_clock::now();
+	engineUpdate();
+	_updateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+
+	t = std::chrono::steady_clock::now();
+	renderSerialFrame();
+	_renderMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// Frame N + 1 is updated and extracted on frame pipeline thread while frame N is rendered here.
+// Stage touches scene objects only, render uses extracted scene and doesn't touch them.
+// Main thread part runs when stage is finished, so callbacks can change anything.
+// Callbacks can also switch render path, disable pipelining or remove camera,
+// so it is checked again before next stage is kicked.
+void Core::pipelinedLoop()
+{
+	if (!_pipelineStarted)
+	{
+		auto t = std::chrono::steady_clock::now();
+		beginUpdate();
+		endUpdate();
+
+		if (!canPipelineFrames())
+		{
+			resMan->Update(_dt);
+			_updateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+
+			t = std::chrono::steady_clock::now();
+			renderSerialFrame();
+			_renderMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+			return;
+		}
+
+		kickFrameStage();
+		_pipelineStarted = true;
+	}
+
+	{
+		PROFILE_SCOPE("Wait frame stage");
+		framePipeline->Wait();
+	}
+
+	const Engine::CameraData camData = render->PublishFrame();
+
+	auto t = std::chrono::steady_clock::now();
+	beginUpdate();
+	resMan->FreeUnusedResources();
+	endUpdate();
+
+	if (!canPipelineFrames())
+	{
+		// published frame is dropped, scene objects are already updated by finished stage
+		stopFramePipeline();
+		_updateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+
+		t = std::chrono::steady_clock::now();
+		renderSerialFrame();
+		_renderMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+		return;
+	}
+
+	kickFrameStage();
+	_updateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+
+	t = std::chrono::steady_clock::now();
+	render->RenderFrame(0, camData, nullptr, 0);
+	CORE_RENDER->SwapBuffers();
+	_renderMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// Camera is read in the stage after its update, so extracted frame doesn't lag behind input.
+// Viewport is read here because main thread changes it while rendering.
+void Core::kickFrameStage()
+{
+	uint w, h;
+	CORE_RENDER->GetViewport(&w, &h);
+	const float aspect = (float)w / h;
+	const float dt = _dt;
+
+	framePipeline->Kick([this, aspect, dt]()
+	{
+		resMan->UpdateObjects(dt);
+		render->ExtractFrame(getCameraData(aspect));
+	});
+}
+
+// Extracted frame is dropped, its objects are already updated
+void Core::stopFramePipeline()
+{
+	if (!_pipelineStarted)
+		return;
+
+	framePipeline->Wait();
+	render->StopPipelining();
+	_pipelineStarted = false;
+}
+
+void Core::BenchmarkFramePipeline(uint frames)
+{
+	if (!camera)
+	{
+		LogWarning("Core::BenchmarkFramePipeline(): no camera, call Start() first");
+		return;
+	}
+
+	if (!frames)
+		return;
+
+	const bool pipelining = _framePipelining;
+
+	typedef std::chrono::high_resolution_clock clock;
+
+	Log("Core::BenchmarkFramePipeline(): %u frames, %u objects, %s", frames, (uint)resMan->GetNumObjects(), coreRender->GetName());
+
+	double serialMs = 0.0;
+
+	for (int pipelined = 0; pipelined < 2; pipelined++)
+	{
+		_framePipelining = pipelined != 0;
+
+		// first frames create render targets and load resources
+		for (int i = 0; i < 3; i++)
+			mainLoop();
+
+		vector<double> ms(frames);
+		double update = 0.0, stage = 0.0, renderTime = 0.0;
+
+		for (uint i = 0; i < frames; i++)
+		{
+			clock::time_point t = clock::now();
+			mainLoop();
+			ms[i] = std::chrono::duration<double, std::milli>(clock::now() - t).count();
+
+			update += _updateMs;
+			stage += framePipeline->GetStageMs();
+			renderTime += _renderMs;
+		}
+
+		double total = 0.0;
+		for (double t : ms)
+			total += t;
+
+		std::sort(ms.begin(), ms.end());
+
+		if (pipelined)
+			Log("  pipelined: mean %.3f ms, median %.3f ms, main update %.3f ms, stage %.3f ms, render %.3f ms, speedup %.2fx",
+				total / frames, ms[frames / 2], update / frames, stage / frames, renderTime / frames, serialMs / (total / frames));
+		else
+		{
+			serialMs = total / frames;
+			Log("  serial: mean %.3f ms, median %.3f ms, update %.3f ms, render %.3f ms", serialMs, ms[frames / 2], update / frames, renderTime / frames);
+		}
+	}
+
+	_framePipelining = pipelining;
+	if (!_framePipelining)
+		stopFramePipeline();
+}
+
 auto DLLEXPORT Core::ManualUpdate() -> void
 {
+	stopFramePipeline();
 	engineUpdate();
 }
 
@@ -289,6 +512,21 @@ auto DLLEXPORT Core::RemoveProfilerCallback(IProfilerCallback * c) -> void
 	profilerCallbacks.erase(std::remove(profilerCallbacks.begin(), profilerCallbacks.end(), c), profilerCallbacks.end());
 }
 
+auto DLLEXPORT Core::SetCpuProfiler(bool value) -> void
+{
+	CpuProfiler::SetEnabled(value);
+}
+
+auto DLLEXPORT Core::IsCpuProfiler() -> bool
+{
+	return CpuProfiler::IsEnabled();
+}
+
+auto DLLEXPORT Core::SaveCpuProfile(const char *path) -> bool
+{
+	return CpuProfiler::ExportChromeTrace(path);
+}
+
 void Core::sMainLoop()
 {
 	_core->mainLoop();
@@ -298,10 +536,14 @@ void Core::Free()
 {
 	RemoveProfilerCallback(this);
 
+	stopFramePipeline();
+	framePipeline->Free();
+
 	render->Free();
 	matManager->Free();
 	input->Free();
 	resMan->Free();
+	threadPool->Free();
 	freeCoreRender();
 
 	if (window)
@@ -312,9 +554,12 @@ void Core::Free()
 	console->Free();
 
 	fs->Free();
+
+	// last: worker, frame pipeline and console writer threads are joined
+	CpuProfiler::Free();
 }
 
-auto DLLEXPORT Core::Start(Camera *cam) -> void
+void Core::prepareStart(Camera *cam)
 {
 	camera = cam;
 	onInit.Invoke();
@@ -328,8 +573,64 @@ auto DLLEXPORT Core::Start(Camera *cam) -> void
 		window->GetClientSize(w, h);
 
 		CORE_RENDER->SetViewport(w, h);
+	}
+}
+
+auto DLLEXPORT Core::Start(Camera *cam) -> void
+{
+	prepareStart(cam);
+
+	if (window)
 		window->StartMainLoop();
+}
+
+auto DLLEXPORT Core::RunBenchmark(const char *name, Camera *cam) -> bool
+{
+	struct Benchmark
+	{
+		const char *name;
+		bool needsCamera;
+		std::function<bool()> run; // false if benchmark found wrong results
+	};
+
+	const Benchmark benchmarks[] =
+	{
+		{"aabb_tree", false, []() { BenchmarkAABBTree(); return true; }},
+		{"draw_preparation", true, [this]() { render->BenchmarkDrawPreparation(getCameraData()); return true; }},
+		{"frame_pipeline", true, [this]() { BenchmarkFramePipeline(); return true; }},
+		{"hashing", false, []() { BenchmarkHashing(); return true; }},
+		{"logging", false, [this]() { console->BenchmarkLogging(); return true; }},
+		{"render_graph", false, []() { return CheckRenderGraph(); }},
+		{"render_submission", true, [this]() { BenchmarkRenderSubmission(getCameraData()); return true; }},
+		{"scene_loading", false, [this]() { resMan->CloseWorld(); resMan->BenchmarkSceneLoading(); return true; }},
+		{"software_raster", true, [this]() { BenchmarkSoftwareRaster(getCameraData()); return true; }},
+		{"thread_pool", false, []() { BenchmarkThreadPool(); return true; }},
+		{"vector_math", false, []() { return BenchmarkVectorMath(); }},
+	};
+
+	for (const Benchmark& b : benchmarks)
+	{
+		if (strcmp(b.name, name))
+			continue;
+
+		if (b.needsCamera && !cam)
+		{
+			LogWarning("Core::RunBenchmark(): '%s' needs camera", name);
+			return false;
+		}
+
+		prepareStart(cam);
+		const bool passed = b.run();
+		console->Flush();
+		return passed;
 	}
+
+	string names;
+	for (const Benchmark& b : benchmarks)
+		names += string(" ") + b.name;
+
+	LogWarning("Core::RunBenchmark(): unknown benchmark '%s', available:%s", name, names.c_str());
+	return false;
 }
 
 //void Core::ReloadCoreRender()
@@ -353,6 +654,12 @@ Core::~Core()
 	delete resMan;
 	resMan = nullptr;
 
+	delete threadPool;
+	threadPool = nullptr;
+
+	delete framePipeline;
+	framePipeline = nullptr;
+
 	delete coreRender;
 	coreRender = nullptr;
 
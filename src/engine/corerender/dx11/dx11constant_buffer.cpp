@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "dx11constant_buffer.h"
+#include "core.h"
+#include "dx11corerender.h"
+
+static ID3D11DeviceContext* getContext()
+{
+	DX11CoreRender *dxRender = static_cast<DX11CoreRender*>(CORE_RENDER);
+	return dxRender->getContext();
+}
+
+DX11ConstantBuffer::DX11ConstantBuffer(ID3D11Buffer *buf_) : buf(buf_)
+{
+	D3D11_BUFFER_DESC desc;
+	buf_->GetDesc(&desc);
+	size = desc.ByteWidth;
+}
+
+DX11ConstantBuffer::~DX11ConstantBuffer()
+{
+	if (buf) { buf->Release(); buf = nullptr; }
+	size = 0u;
+}
+
+auto DX11ConstantBuffer::SetData(const uint8 *data, size_t size_) -> void
+{
+	assert(size_ <= size);
+
+	ID3D11DeviceContext *ctx = getContext();
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource{};
+	ctx->Map(buf, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	memcpy(mappedResource.pData, data, size_);
+	ctx->Unmap(buf, 0);
+}
+
+auto DX11ConstantBuffer::GetSize() -> uint
+{
+	return size;
+}
+
+auto DX11ConstantBuffer::GetVideoMemoryUsage() -> size_t
+{
+	return size;
+}
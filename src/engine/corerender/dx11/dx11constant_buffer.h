@@ -0,0 +1,20 @@
+#pragma once
+#include "common.h"
+#include "icorerender.h"
+
+class DX11ConstantBuffer : public ICoreConstantBuffer
+{
+	ID3D11Buffer *buf = nullptr;
+	uint size = 0;
+
+public:
+	DX11ConstantBuffer(ID3D11Buffer *buf_);
+	virtual ~DX11ConstantBuffer();
+
+	ID3D11Buffer *Buffer() const { return buf; }
+
+	auto SetData(const uint8 *data, size_t size) -> void override;
+	auto GetSize() -> uint override;
+	auto GetVideoMemoryUsage() -> size_t override;
+};
+
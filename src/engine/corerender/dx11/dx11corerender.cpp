@@ -11,6 +11,8 @@
 #include "structured_buffer.h"
 #include "dx11shader.h"
 #include "dx11structured_buffer.h"
+#include "dx11constant_buffer.h"
+#include "shader_reflection.h"
 #include "dx_objects.inl"
 #include <stack>
 
@@ -32,6 +34,7 @@ using WRL::ComPtr;
 #endif
 
 std::vector<ConstantBuffer> ConstantBufferPool;
+std::unordered_multimap<uint32_t, size_t> ConstantBufferPoolIndex; // layout hash -> index in ConstantBufferPool
 
 static std::stack<DX11CoreRender::State> statesStack_;
 static std::unordered_map<WindowHandle, WindowSurface> surfaces_;
@@ -116,22 +119,17 @@ UINT DX11CoreRender::MSAAquality(DXGI_FORMAT format, int MSAASamples)
 	return maxQuality;
 }
 
-uint DX11CoreRender::getNumLines()
+void DX11CoreRender::writeLines(TextArena& out)
 {
-	return 6;
-}
-
-std::string DX11CoreRender::getString(uint i)
-{
-	switch (i)
-	{
-		case 0: return "==== DX11 Core Render ====";
-		case 1: return "Draw Calls: " + std::to_string(oldStat_.drawCalls);
-		case 2: return "Triangles: " + std::to_string(oldStat_.triangles);
-		case 3: return "Instances: " + std::to_string(oldStat_.instances);
-		case 4: return "Clear calls: " + std::to_string(oldStat_.clearCalls);
-	}
-	return "";
+	out.AddLine("==== DX11 Core Render ====");
+	out.AddLine("Draw Calls: %i", oldStat_.drawCalls);
+	out.AddLine("Triangles: %llu", (unsigned long long)oldStat_.triangles);
+	out.AddLine("Instances: %i", oldStat_.instances);
+	out.AddLine("Clear calls: %i", oldStat_.clearCalls);
+	out.AddLine("Shader changes: %i", oldStat_.shaderChanges);
+	out.AddLine("Mesh changes: %i", oldStat_.meshChanges);
+	out.AddLine("Texture changes: %i", oldStat_.textureChanges);
+	out.AddLine("");
 }
 
 void DX11CoreRender::Update()
@@ -240,6 +238,8 @@ void DX11CoreRender::Free()
 	_core->RemoveProfilerCallback(this);
 
 	ConstantBufferPool.clear();
+	ConstantBufferPoolIndex.clear();
+	ClearShaderReflections();
 
 	state_.blendState = nullptr;
 	state_.rasterState = nullptr;
@@ -1017,6 +1017,20 @@ auto DX11CoreRender::CreateStructuredBuffer(uint size, uint elementSize, BUFFER_
 	return new DX11StructuredBuffer(pBuffer, pSRVOut, usage);
 }
 
+auto DX11CoreRender::CreateConstantBuffer(uint size) -> ICoreConstantBuffer*
+{
+	D3D11_BUFFER_DESC desc{};
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.ByteWidth = (size + 15) & ~15; // make byte width multiplied by 16
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	ID3D11Buffer *pBuffer;
+	ThrowIfFailed(_device->CreateBuffer(&desc, nullptr, &pBuffer));
+
+	return new DX11ConstantBuffer(pBuffer);
+}
+
 auto DX11CoreRender::BindTextures(int units, Texture **textures, BIND_TETURE_FLAGS flags) -> void
 {
 	ID3D11ShaderResourceView* srvs[16]{};
@@ -1048,6 +1062,7 @@ auto DX11CoreRender::BindTextures(int units, Texture **textures, BIND_TETURE_FLA
 		if (needUpdate)
 		{
 			memcpy(state_.srvs, srvs, sizeof(state_.srvs));
+			stat_.textureChanges++;
 
 			if (bool(flags & BIND_TETURE_FLAGS::PIXEL))
 			{
@@ -1073,6 +1088,7 @@ auto DX11CoreRender::BindTextures(int units, Texture **textures, BIND_TETURE_FLA
 		if (needUpdate)
 		{
 			memset(state_.srvs, 0, sizeof(state_.srvs));
+			stat_.textureChanges++;
 			if (bool(flags & BIND_TETURE_FLAGS::PIXEL))
 			{
 				_context->PSSetShaderResources(0, units, srvs);
@@ -1285,6 +1301,7 @@ auto DX11CoreRender::SetMesh(Mesh * mesh) -> void
 		return;
 
 	state_.mesh = mesh;
+	stat_.meshChanges++;
 
 	if (mesh)
 	{
@@ -1322,6 +1339,7 @@ auto DX11CoreRender::SetShader(Shader *shader) -> void
 		return;
 
 	state_.shader = shader;
+	stat_.shaderChanges++;
 
 	if (shader)
 	{
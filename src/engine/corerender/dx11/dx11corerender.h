@@ -59,6 +59,9 @@ class DX11CoreRender final : public ICoreRender, IProfilerCallback
 		int instances{0};
 		size_t triangles{0};
 		int clearCalls{0};
+		int shaderChanges{0};
+		int meshChanges{0};
+		int textureChanges{0};
 
 		void clear()
 		{
@@ -66,6 +69,9 @@ class DX11CoreRender final : public ICoreRender, IProfilerCallback
 			instances = 0;
 			triangles = 0;
 			clearCalls = 0;
+			shaderChanges = 0;
+			meshChanges = 0;
+			textureChanges = 0;
 		}
 	};
 
@@ -86,6 +92,7 @@ public:
 	auto CreateShader(const char *vertText, const char *fragText, const char *geomText, ERROR_COMPILE_SHADER &err) -> ICoreShader* override;
 	auto CreateComputeShader(const char *compText, ERROR_COMPILE_SHADER &err) -> ICoreShader* override;
 	auto CreateStructuredBuffer(uint size, uint elementSize, BUFFER_USAGE usage) -> ICoreStructuredBuffer* override;
+	auto CreateConstantBuffer(uint size) -> ICoreConstantBuffer* override;
 
 	auto PushStates() -> void override;
 	auto PopStates() -> void override;
@@ -151,8 +158,7 @@ public:
 
 public:
 	// Internal API
-	uint getNumLines() override;
-	std::string getString(uint i) override;
+	void writeLines(TextArena& out) override;
 	void Update() override;
 
 private:
@@ -3,9 +3,12 @@
 #include "dx11corerender.h"
 #include "core.h"
 #include "console.h"
+#include "dx11constant_buffer.h"
+#include "shader_reflection.h"
 #include "dx_objects.inl"
 
 extern vector<ConstantBuffer> ConstantBufferPool;
+extern std::unordered_multimap<uint32_t, size_t> ConstantBufferPoolIndex;
 
 static ID3D11DeviceContext* getContext()
 {
@@ -18,15 +21,9 @@ static ID3D11Device* getDevice()
 	return dxRender->getDevice();
 }
 
-void DX11Shader::initSubShader(ShaderInitData& data, SHADER_TYPE type)
+static ShaderReflection reflect(const ShaderInitData& data)
 {
-	switch (type)
-	{
-		case SHADER_TYPE::SHADER_VERTEX: v.pointer = (ID3D11VertexShader *)data.pointer; break;
-		case SHADER_TYPE::SHADER_GEOMETRY: g.pointer = (ID3D11GeometryShader *)data.pointer; break;
-		case SHADER_TYPE::SHADER_FRAGMENT:  f.pointer = (ID3D11PixelShader *)data.pointer; break;
-		case SHADER_TYPE::SHADER_COMPUTE:  c.pointer = (ID3D11ComputeShader *)data.pointer; break;
-	}
+	ShaderReflection ret;
 
 	ID3D11ShaderReflection* reflection = nullptr;
 	D3DReflect(data.bytecode, data.size, IID_ID3D11ShaderReflection, (void**)&reflection);
@@ -42,7 +39,9 @@ void DX11Shader::initSubShader(ShaderInitData& data, SHADER_TYPE type)
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		buffer->GetDesc(&bufferDesc);
 
-		vector<ConstantBuffer::Parameter> cbParameters;
+		ConstantBufferLayout layout;
+		layout.name = bufferDesc.Name;
+		layout.bytes = bufferDesc.Size;
 
 		// each parameters
 		for (uint j = 0; j < bufferDesc.Variables; j++)
@@ -51,42 +50,69 @@ void DX11Shader::initSubShader(ShaderInitData& data, SHADER_TYPE type)
 			D3D11_SHADER_VARIABLE_DESC varDesc;
 			var->GetDesc(&varDesc);
 
-			ConstantBuffer::Parameter p;
+			ConstantBufferLayout::Parameter p;
 			p.name = varDesc.Name;
 			p.bytes = varDesc.Size;
 			p.offset = varDesc.StartOffset;
 
-			cbParameters.push_back(p);
+			layout.parameters.push_back(p);
 		}
 
-		// find existing buffer with same memory layout
-		int indexFound = -1;
-		{
-			for (int j = 0; indexFound == -1 && j < ConstantBufferPool.size(); j++)
-			{
-				bool isEqual = true;
+		layout.hash = LayoutHash(layout);
+		ret.buffers.push_back(std::move(layout));
+	}
+
+	reflection->Release();
+
+	return ret;
+}
 
-				//if (ConstantBufferPool[j].name != bufferDesc.Name)
-				//	isEqual = false;
+static bool isSameLayout(const ConstantBuffer& cb, const ConstantBufferLayout& layout)
+{
+	//if (cb.name != layout.name)
+	//	return false;
 
-				if (ConstantBufferPool[j].bytes != bufferDesc.Size)
-					isEqual = false;
+	if (cb.bytes != ((layout.bytes + 15) & ~15) || cb.parameters.size() != layout.parameters.size())
+		return false;
 
-				if (ConstantBufferPool[j].parameters.size() != cbParameters.size())
-					isEqual = false;
+	for (size_t k = 0; k < layout.parameters.size(); k++)
+	{
+		if (cb.parameters[k].name != layout.parameters[k].name ||
+			cb.parameters[k].bytes != layout.parameters[k].bytes ||
+			cb.parameters[k].offset != layout.parameters[k].offset)
+		{
+			return false;
+		}
+	}
 
-				for (int k = 0; isEqual && k < cbParameters.size(); k++)
-				{
-					if (ConstantBufferPool[j].parameters[k].name != cbParameters[k].name ||
-						ConstantBufferPool[j].parameters[k].bytes != cbParameters[k].bytes ||
-						ConstantBufferPool[j].parameters[k].offset != cbParameters[k].offset)
-					{
-						isEqual = 0;
-					}
-				}
+	return true;
+}
 
-				if (isEqual)
-					indexFound = j;
+void DX11Shader::initSubShader(ShaderInitData& data, SHADER_TYPE type)
+{
+	switch (type)
+	{
+		case SHADER_TYPE::SHADER_VERTEX: v.pointer = (ID3D11VertexShader *)data.pointer; break;
+		case SHADER_TYPE::SHADER_GEOMETRY: g.pointer = (ID3D11GeometryShader *)data.pointer; break;
+		case SHADER_TYPE::SHADER_FRAGMENT:  f.pointer = (ID3D11PixelShader *)data.pointer; break;
+		case SHADER_TYPE::SHADER_COMPUTE:  c.pointer = (ID3D11ComputeShader *)data.pointer; break;
+	}
+
+	const ShaderReflection *reflection = FindShaderReflection(data.bytecode, data.size);
+	if (!reflection)
+		reflection = AddShaderReflection(data.bytecode, data.size, reflect(data));
+
+	// each Constant Buffer
+	for (const ConstantBufferLayout& layout : reflection->buffers)
+	{
+		// find existing buffer with same memory layout
+		int indexFound = -1;
+		{
+			auto range = ConstantBufferPoolIndex.equal_range(layout.hash);
+			for (auto it = range.first; indexFound == -1 && it != range.second; ++it)
+			{
+				if (isSameLayout(ConstantBufferPool[it->second], layout))
+					indexFound = (int)it->second;
 			}
 		}
 
@@ -96,7 +122,7 @@ void DX11Shader::initSubShader(ShaderInitData& data, SHADER_TYPE type)
 
 			WRL::ComPtr<ID3D11Buffer> buffer;
 		
-			uint size = (bufferDesc.Size + 15) & ~15; // make byte width multiplied by 16
+			uint size = ((uint)layout.bytes + 15) & ~15; // make byte width multiplied by 16
 		
 			D3D11_BUFFER_DESC desc{};
 			desc.Usage = D3D11_USAGE_DYNAMIC;
@@ -106,19 +132,42 @@ void DX11Shader::initSubShader(ShaderInitData& data, SHADER_TYPE type)
 
 			ThrowIfFailed(getDevice()->CreateBuffer(&desc, nullptr, buffer.GetAddressOf()));
 
-			ConstantBufferPool.emplace_back(buffer, size, bufferDesc.Name, cbParameters);
+			vector<ConstantBuffer::Parameter> cbParameters;
+			for (const ConstantBufferLayout::Parameter& p : layout.parameters)
+				cbParameters.push_back({ p.name, p.offset, p.bytes });
+
+			ConstantBufferPool.emplace_back(buffer, size, layout.name, cbParameters);
+			ConstantBufferPoolIndex.emplace(layout.hash, (size_t)indexFound);
 		}
 
+		uint slot = 0;
 		switch (type)
 		{
-			case SHADER_TYPE::SHADER_VERTEX:	v.buffers.push_back(indexFound); break;
-			case SHADER_TYPE::SHADER_GEOMETRY:	g.buffers.push_back(indexFound); break;
-			case SHADER_TYPE::SHADER_FRAGMENT:	f.buffers.push_back(indexFound); break;
-			case SHADER_TYPE::SHADER_COMPUTE:	c.buffers.push_back(indexFound); break;
+			case SHADER_TYPE::SHADER_VERTEX:	slot = (uint)v.buffers.size(); v.buffers.push_back(indexFound); break;
+			case SHADER_TYPE::SHADER_GEOMETRY:	slot = (uint)g.buffers.size(); g.buffers.push_back(indexFound); break;
+			case SHADER_TYPE::SHADER_FRAGMENT:	slot = (uint)f.buffers.size(); f.buffers.push_back(indexFound); break;
+			case SHADER_TYPE::SHADER_COMPUTE:	slot = (uint)c.buffers.size(); c.buffers.push_back(indexFound); break;
 		};
 
-		for (int i = 0; i < cbParameters.size(); i++)
-			parameters[cbParameters[i].name] = { (int)indexFound, (int)i };
+		auto namedIt = std::find_if(buffers.begin(), buffers.end(), [&layout](const NamedBuffer& b) { return b.name == layout.name; });
+		if (namedIt == buffers.end())
+		{
+			buffers.push_back({ layout.name, (size_t)indexFound, {} });
+			namedIt = buffers.end() - 1;
+		}
+		namedIt->bindings.push_back({ type, slot });
+
+		for (int i = 0; i < layout.parameters.size(); i++)
+		{
+			auto it = parametersMap.find(layout.parameters[i].name);
+			if (it == parametersMap.end())
+			{
+				parametersMap[layout.parameters[i].name] = (int)parameters.size();
+				parameters.push_back({ (int)indexFound, (int)i });
+			}
+			else
+				parameters[it->second] = { (int)indexFound, (int)i };
+		}
 
 	}
 }
@@ -181,14 +230,22 @@ void DX11Shader::bind()
 
 void DX11Shader::setParameter(std::string_view name, const void *data)
 {
-	auto it = parameters.find(name);
-	if (it == parameters.end())
+	auto it = parametersMap.find(name);
+	if (it == parametersMap.end())
 	{
 		LogWarning("DX11Shader::setParameter() unable find parameter \"%s\"", name.data());
 		return;
 	}
 
-	Parameter &p = it->second;
+	setParameter(it->second, data);
+}
+
+void DX11Shader::setParameter(int handle, const void *data)
+{
+	if (handle < 0 || handle >= (int)parameters.size())
+		return;
+
+	Parameter &p = parameters[handle];
 
 	if (p.bufferIndex < 0 || p.parameterIndex < 0)
 		return;
@@ -223,6 +280,89 @@ auto DX11Shader::SetUintParameter(const char *name, uint value) -> void
 	setParameter(name, &value);
 }
 
+auto DX11Shader::GetParameterHandle(const char *name) -> int
+{
+	auto it = parametersMap.find(name);
+	if (it == parametersMap.end())
+		return -1;
+	return it->second;
+}
+
+auto DX11Shader::SetFloatParameter(int handle, float value) -> void
+{
+	setParameter(handle, &value);
+}
+
+auto DX11Shader::SetVec4Parameter(int handle, const vec4 *value) -> void
+{
+	setParameter(handle, value);
+}
+
+auto DX11Shader::SetMat4Parameter(int handle, const mat4 *value) -> void
+{
+	setParameter(handle, value);
+}
+
+auto DX11Shader::SetUintParameter(int handle, uint value) -> void
+{
+	setParameter(handle, &value);
+}
+
+auto DX11Shader::GetConstantBufferHandle(const char *name) -> int
+{
+	for (size_t i = 0; i < buffers.size(); i++)
+		if (buffers[i].name == name)
+			return (int)i;
+	return -1;
+}
+
+auto DX11Shader::GetConstantBufferSize(int bufferHandle) -> uint
+{
+	if (bufferHandle < 0 || bufferHandle >= (int)buffers.size())
+		return 0;
+	return (uint)ConstantBufferPool[buffers[bufferHandle].poolIndex].bytes;
+}
+
+auto DX11Shader::GetParameterOffset(int bufferHandle, const char *name, uint *bytes) -> int
+{
+	if (bufferHandle < 0 || bufferHandle >= (int)buffers.size())
+		return -1;
+
+	ConstantBuffer& cb = ConstantBufferPool[buffers[bufferHandle].poolIndex];
+	for (ConstantBuffer::Parameter& p : cb.parameters)
+	{
+		if (p.name == name)
+		{
+			if (bytes)
+				*bytes = (uint)p.bytes;
+			return (int)p.offset;
+		}
+	}
+	return -1;
+}
+
+auto DX11Shader::SetConstantBuffer(int bufferHandle, ICoreConstantBuffer *buffer) -> void
+{
+	if (bufferHandle < 0 || bufferHandle >= (int)buffers.size())
+		return;
+
+	ID3D11DeviceContext *ctx = getContext();
+
+	NamedBuffer& b = buffers[bufferHandle];
+	ID3D11Buffer *pointer = buffer ? static_cast<DX11ConstantBuffer*>(buffer)->Buffer() : ConstantBufferPool[b.poolIndex].buffer.Get();
+
+	for (BufferBinding& binding : b.bindings)
+	{
+		switch (binding.type)
+		{
+			case SHADER_TYPE::SHADER_VERTEX:	ctx->VSSetConstantBuffers(binding.slot, 1, &pointer); break;
+			case SHADER_TYPE::SHADER_GEOMETRY:	ctx->GSSetConstantBuffers(binding.slot, 1, &pointer); break;
+			case SHADER_TYPE::SHADER_FRAGMENT:	ctx->PSSetConstantBuffers(binding.slot, 1, &pointer); break;
+			case SHADER_TYPE::SHADER_COMPUTE:	ctx->CSSetConstantBuffers(binding.slot, 1, &pointer); break;
+		};
+	}
+}
+
 auto DX11Shader::FlushParameters() -> void
 {
 	ID3D11DeviceContext *ctx = getContext();
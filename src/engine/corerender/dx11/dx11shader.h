@@ -18,7 +18,21 @@ class DX11Shader : public ICoreShader
 		int bufferIndex = -1; // in ConstantBufferPool
 		int parameterIndex = -1; // in ConstantBuffer::parameters
 	};
-	std::map<std::string, Parameter, std::less<>> parameters; // all shader parameters
+	std::vector<Parameter> parameters; // all shader parameters, index is handle
+	std::map<std::string, int, std::less<>> parametersMap; // name -> handle
+
+	struct BufferBinding
+	{
+		SHADER_TYPE type;
+		uint slot;
+	};
+	struct NamedBuffer
+	{
+		std::string name;
+		size_t poolIndex; // in ConstantBufferPool
+		std::vector<BufferBinding> bindings;
+	};
+	std::vector<NamedBuffer> buffers; // index is buffer handle
 
 	SubShader v{};
 	SubShader f{};
@@ -27,6 +41,7 @@ class DX11Shader : public ICoreShader
 
 	void initSubShader(ShaderInitData& data, SHADER_TYPE type);
 	void setParameter(std::string_view name, const void *data);
+	void setParameter(int handle, const void *data);
 
 public:
 
@@ -45,6 +60,15 @@ public:
 	auto virtual SetVec4Parameter(const char* name, const vec4 *value) -> void override;
 	auto virtual SetMat4Parameter(const char* name, const mat4 *value) -> void override;
 	auto virtual SetUintParameter(const char* name, uint value) -> void override;
+	auto virtual GetParameterHandle(const char* name) -> int override;
+	auto virtual SetFloatParameter(int handle, float value) -> void override;
+	auto virtual SetVec4Parameter(int handle, const vec4 *value) -> void override;
+	auto virtual SetMat4Parameter(int handle, const mat4 *value) -> void override;
+	auto virtual SetUintParameter(int handle, uint value) -> void override;
+	auto virtual GetConstantBufferHandle(const char* name) -> int override;
+	auto virtual GetConstantBufferSize(int bufferHandle) -> uint override;
+	auto virtual GetParameterOffset(int bufferHandle, const char* name, uint *bytes) -> int override;
+	auto virtual SetConstantBuffer(int bufferHandle, ICoreConstantBuffer *buffer) -> void override;
 	auto virtual FlushParameters() -> void override;
 };
 
@@ -0,0 +1,733 @@
+#include "pch.h"
+#include "nullcorerender.h"
+#include "nullresources.h"
+#include "core.h"
+#include "render.h"
+#include "texture.h"
+#include "mesh.h"
+#include "shader.h"
+#include "structured_buffer.h"
+#include "filesystem.h"
+#include "crc.h"
+#include <stack>
+#include <chrono>
+
+#define NULL_SURFACE_WIDTH 1280
+#define NULL_SURFACE_HEIGHT 720
+#define NULL_RECORDING_MAGIC "NCR1"
+
+static std::stack<NullCoreRender::State> statesStack_;
+
+static uint64_t floatBits(float f)
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static uint textureId(Texture *tex)
+{
+	ICoreTexture *coreTex = tex ? tex->GetCoreTexture() : nullptr;
+	return coreTex ? static_cast<NullTexture*>(coreTex)->id() : 0;
+}
+
+static NullMesh *getNullMesh(Mesh *mesh)
+{
+	return static_cast<NullMesh*>(mesh->GetCoreMesh());
+}
+
+static uint shaderId(Shader *shader)
+{
+	return shader ? static_cast<NullShader*>(shader->GetCoreShader())->id() : 0;
+}
+
+static void writeVarint(vector<uint8>& out, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		out.push_back(uint8(v) | 0x80);
+		v >>= 7;
+	}
+	out.push_back(uint8(v));
+}
+
+// Returns false if data ends before varint
+static bool readVarint(const vector<uint8>& in, size_t& pos, uint64_t& v)
+{
+	v = 0;
+	for (uint shift = 0; pos < in.size() && shift < 64; shift += 7)
+	{
+		uint8 b = in[pos++];
+		v |= uint64_t(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+NullCoreRender::~NullCoreRender() = default;
+
+void NullCoreRender::writeLines(TextArena& out)
+{
+	out.AddLine("==== Null Core Render ====");
+	out.AddLine("Commands: %i", oldStat_.commands);
+	out.AddLine("Draw Calls: %i", oldStat_.drawCalls);
+	out.AddLine("Triangles: %llu", (unsigned long long)oldStat_.triangles);
+	out.AddLine("Instances: %i", oldStat_.instances);
+	out.AddLine("Dispatches: %i", oldStat_.dispatches);
+	out.AddLine("Clear calls: %i", oldStat_.clearCalls);
+	out.AddLine("Shader changes: %i", oldStat_.shaderChanges);
+	out.AddLine("Mesh changes: %i", oldStat_.meshChanges);
+	out.AddLine("Texture changes: %i", oldStat_.textureChanges);
+	out.AddLine("State changes: %i", oldStat_.stateChanges);
+	out.AddLine("Uploaded: %s", bytesToMBytes(oldStat_.uploadedBytes).c_str());
+	out.AddLine("Readback: %s", bytesToMBytes(oldStat_.readbackBytes).c_str());
+	if (recording)
+		out.AddLine("Recording: %s", bytesToMBytes(log.size()).c_str());
+	out.AddLine("");
+}
+
+void NullCoreRender::Update()
+{
+	oldStat_ = stat_;
+	stat_.clear();
+}
+
+auto NullCoreRender::Record(NULL_COMMAND c, std::initializer_list<uint64_t> args, const void *data, size_t bytes) -> void
+{
+	record(c, args.begin(), args.size(), data, bytes);
+}
+
+void NullCoreRender::record(NULL_COMMAND c, const uint64_t *args, size_t num, const void *data, size_t bytes)
+{
+	stat_.commands++;
+
+	if (!recording)
+		return;
+
+	payload.clear();
+	for (size_t i = 0; i < num; i++)
+		writeVarint(payload, args[i]);
+	if (bytes)
+		payload.insert(payload.end(), static_cast<const uint8*>(data), static_cast<const uint8*>(data) + bytes);
+
+	log.push_back(static_cast<uint8>(c));
+	writeVarint(log, payload.size());
+	log.insert(log.end(), payload.begin(), payload.end());
+}
+
+auto NullCoreRender::Init(const WindowHandle* handle, int MSAASamples, int VSyncOn) -> bool
+{
+	createSurface(NULL_SURFACE_WIDTH, NULL_SURFACE_HEIGHT);
+
+	state_.width = surfaceWidth;
+	state_.height = surfaceHeight;
+	state_.renderTargets[0] = surfaceColor.get();
+	state_.renderDepth = surfaceDepth.get();
+
+	_core->AddProfilerCallback(this);
+
+	Log("NullCoreRender Inited");
+	return true;
+}
+
+auto NullCoreRender::Free() -> void
+{
+	_core->RemoveProfilerCallback(this);
+
+	while (!statesStack_.empty())
+		statesStack_.pop();
+
+	state_ = State();
+	surfaceColor = nullptr;
+	surfaceDepth = nullptr;
+
+	recording = false;
+	log.clear();
+	log.shrink_to_fit();
+
+	Log("NullCoreRender Free");
+}
+
+void NullCoreRender::createSurface(uint w, uint h)
+{
+	surfaceWidth = w;
+	surfaceHeight = h;
+	surfaceColor = std::unique_ptr<Texture>(new Texture(unique_ptr<ICoreTexture>(new NullTexture(NextId(), nullptr, w, h, TEXTURE_TYPE::TYPE_2D, TEXTURE_FORMAT::RGBA8, TEXTURE_CREATE_FLAGS::USAGE_RENDER_TARGET, 0))));
+	surfaceDepth = std::unique_ptr<Texture>(new Texture(unique_ptr<ICoreTexture>(new NullTexture(NextId(), nullptr, w, h, TEXTURE_TYPE::TYPE_2D, TEXTURE_FORMAT::D24S8, TEXTURE_CREATE_FLAGS::USAGE_RENDER_TARGET, 0))));
+}
+
+auto NullCoreRender::MakeCurrent(const WindowHandle* handle) -> void
+{
+	// Without window surface keeps its size, with window it follows client area as in DX11 backend
+#ifdef WIN32
+	if (handle && *handle)
+	{
+		RECT r;
+		GetClientRect(*handle, &r);
+		uint w = r.right - r.left;
+		uint h = r.bottom - r.top;
+
+		if (w > 0 && h > 0 && (w != surfaceWidth || h != surfaceHeight))
+			createSurface(w, h);
+	}
+#endif
+
+	Texture *color = surfaceColor.get();
+	SetRenderTextures(1, &color, surfaceDepth.get());
+}
+
+auto NullCoreRender::SwapBuffers() -> void
+{
+	Record(NULL_COMMAND::FRAME, {});
+}
+
+auto NullCoreRender::CreateMesh(const MeshDataDesc *dataDesc, const MeshIndexDesc *indexDesc, VERTEX_TOPOLOGY mode) -> ICoreMesh*
+{
+	const int normals = dataDesc->normalsPresented;
+	const int texCoords = dataDesc->texCoordPresented;
+	const int colors = dataDesc->colorPresented;
+	const int bytesWidth = 16 + 16 * normals + 8 * texCoords + 16 * colors;
+
+	INPUT_ATTRUBUTE attribs = INPUT_ATTRUBUTE::POSITION;
+	if (dataDesc->normalsPresented)
+		attribs = attribs | INPUT_ATTRUBUTE::NORMAL;
+	if (dataDesc->texCoordPresented)
+		attribs = attribs | INPUT_ATTRUBUTE::TEX_COORD;
+	if (dataDesc->colorPresented)
+		attribs = attribs | INPUT_ATTRUBUTE::COLOR;
+
+	NullMesh *mesh = new NullMesh(NextId(), dataDesc, indexDesc, mode, attribs, bytesWidth);
+
+	const size_t bytes = mesh->GetVideoMemoryUsage();
+	Record(NULL_COMMAND::CREATE_MESH, {mesh->id(), dataDesc->numberOfVertex, mesh->indexNumber(), (uint64_t)mode, (uint64_t)attribs, bytes});
+	stat_.uploadedBytes += bytes;
+
+	return mesh;
+}
+
+auto NullCoreRender::CreateTexture(const uint8 *pData, uint width, uint height, TEXTURE_TYPE type, TEXTURE_FORMAT format, TEXTURE_CREATE_FLAGS flags, int mipmapsPresented) -> ICoreTexture*
+{
+	NullTexture *tex = new NullTexture(NextId(), pData, width, height, type, format, flags, mipmapsPresented);
+
+	size_t bytes = 0;
+	if (pData)
+	{
+		const uint faces = type == TEXTURE_TYPE::TYPE_CUBE ? 6 : 1;
+		bytes = NullTexture::ChainBytes(width, height, format, mipmapsPresented ? tex->GetMipmaps() : 1) * faces;
+	}
+
+	Record(NULL_COMMAND::CREATE_TEXTURE, {tex->id(), width, height, (uint64_t)type, (uint64_t)format, (uint64_t)flags, (uint64_t)tex->GetMipmaps(), bytes});
+	stat_.uploadedBytes += bytes;
+
+	return tex;
+}
+
+auto NullCoreRender::CreateShader(const char *vertText, const char *fragText, const char *geomText, ERROR_COMPILE_SHADER &err) -> ICoreShader*
+{
+	err = ERROR_COMPILE_SHADER::NONE;
+
+	uint64_t hash = 0;
+	for (const char *text : {vertText, fragText, geomText})
+		if (text)
+			hash = hash64(text, strlen(text), hash);
+
+	NullShader *shader = new NullShader(NextId(), false);
+	Record(NULL_COMMAND::CREATE_SHADER, {shader->id(), 0, hash});
+
+	return shader;
+}
+
+auto NullCoreRender::CreateComputeShader(const char *compText, ERROR_COMPILE_SHADER &err) -> ICoreShader*
+{
+	err = ERROR_COMPILE_SHADER::NONE;
+
+	NullShader *shader = new NullShader(NextId(), true);
+	Record(NULL_COMMAND::CREATE_SHADER, {shader->id(), 1, hash64(compText, strlen(compText))});
+
+	return shader;
+}
+
+auto NullCoreRender::CreateStructuredBuffer(uint size, uint elementSize, BUFFER_USAGE usage) -> ICoreStructuredBuffer*
+{
+	assert(size % 16 == 0);
+
+	NullStructuredBuffer *buffer = new NullStructuredBuffer(NextId(), size, elementSize);
+	Record(NULL_COMMAND::CREATE_STRUCTURED_BUFFER, {buffer->id(), size, elementSize, (uint64_t)usage});
+
+	return buffer;
+}
+
+auto NullCoreRender::CreateConstantBuffer(uint size) -> ICoreConstantBuffer*
+{
+	NullConstantBuffer *buffer = new NullConstantBuffer(NextId(), size);
+	Record(NULL_COMMAND::CREATE_CONSTANT_BUFFER, {buffer->id(), buffer->GetSize()});
+
+	return buffer;
+}
+
+auto NullCoreRender::PushStates() -> void
+{
+	statesStack_.push(state_);
+	Record(NULL_COMMAND::PUSH_STATES, {});
+}
+
+auto NullCoreRender::PopStates() -> void
+{
+	State& state = statesStack_.top();
+
+	SetMesh(state.mesh);
+	SetShader(state.shader);
+
+	state_ = state;
+	statesStack_.pop();
+
+	Record(NULL_COMMAND::POP_STATES, {});
+}
+
+auto NullCoreRender::SetRenderTextures(int units, Texture **textures, Texture *depthTex) -> void
+{
+	assert(units <= 8);
+
+	for (int i = 0; i < 8; i++)
+		state_.renderTargets[i] = nullptr;
+
+	uint64_t args[1 + 8 + 1];
+	args[0] = units;
+
+	for (int i = 0; i < units; i++)
+	{
+		Texture *tex = textures ? textures[i] : nullptr;
+		state_.renderTargets[i] = tex;
+		args[1 + i] = textureId(tex);
+	}
+
+	state_.renderDepth = depthTex;
+	args[1 + units] = textureId(depthTex);
+
+	stat_.stateChanges++;
+	record(NULL_COMMAND::SET_RENDER_TEXTURES, args, units + 2);
+}
+
+auto NullCoreRender::Clear() -> void
+{
+	// Contents are not cleared: nothing is rasterized, and touching targets would distort CPU cost
+	uint cleared = 0;
+
+	for (int i = 0; i < 8; i++)
+		if (state_.renderTargets[i])
+			cleared++;
+
+	if (state_.renderDepth)
+		cleared++;
+
+	stat_.clearCalls += cleared;
+	Record(NULL_COMMAND::CLEAR, {cleared});
+}
+
+auto NullCoreRender::SetDepthTest(int enabled) -> void
+{
+	if (state_.depthTest == enabled)
+		return;
+
+	state_.depthTest = enabled;
+	stat_.stateChanges++;
+	Record(NULL_COMMAND::SET_DEPTH_TEST, {(uint64_t)enabled});
+}
+
+auto NullCoreRender::SetDepthFunc(DEPTH_FUNC func) -> void
+{
+	if (state_.depthFunc == func)
+		return;
+
+	state_.depthFunc = func;
+	stat_.stateChanges++;
+	Record(NULL_COMMAND::SET_DEPTH_FUNC, {(uint64_t)func});
+}
+
+auto NullCoreRender::SetBlendState(BLEND_FACTOR src, BLEND_FACTOR dest) -> void
+{
+	if (state_.blendSrc == src && state_.blendDest == dest)
+		return;
+
+	state_.blendSrc = src;
+	state_.blendDest = dest;
+	stat_.stateChanges++;
+	Record(NULL_COMMAND::SET_BLEND_STATE, {(uint64_t)src, (uint64_t)dest});
+}
+
+auto NullCoreRender::SetCullingMode(CULLING_MODE value) -> void
+{
+	if (state_.cullingMode == value)
+		return;
+
+	state_.cullingMode = value;
+	stat_.stateChanges++;
+	Record(NULL_COMMAND::SET_CULLING_MODE, {(uint64_t)value});
+}
+
+auto NullCoreRender::SetDepthBias(float bias) -> void
+{
+	if (floatBits(state_.depthBias) == floatBits(bias))
+		return;
+
+	state_.depthBias = bias;
+	stat_.stateChanges++;
+	Record(NULL_COMMAND::SET_DEPTH_BIAS, {floatBits(bias)});
+}
+
+auto NullCoreRender::SetFillingMode(FILLING_MODE value) -> void
+{
+	if (state_.fillingMode == value)
+		return;
+
+	state_.fillingMode = value;
+	stat_.stateChanges++;
+	Record(NULL_COMMAND::SET_FILLING_MODE, {(uint64_t)value});
+}
+
+auto NullCoreRender::BindTextures(int units, Texture **textures, BIND_TETURE_FLAGS flags) -> void
+{
+	assert(units <= 16);
+
+	uint srvs[16]{};
+	bool needUpdate = false;
+
+	for (int i = 0; i < units; i++)
+	{
+		srvs[i] = textures ? textureId(textures[i]) : 0;
+		if (state_.srvs[i] != srvs[i])
+			needUpdate = true;
+	}
+
+	if (!needUpdate)
+		return;
+
+	memcpy(state_.srvs, srvs, sizeof(state_.srvs));
+	stat_.textureChanges++;
+
+	uint64_t args[2 + 16];
+	args[0] = units;
+	args[1] = (uint64_t)flags;
+	for (int i = 0; i < units; i++)
+		args[2 + i] = srvs[i];
+
+	record(NULL_COMMAND::BIND_TEXTURES, args, units + 2);
+}
+
+auto NullCoreRender::CSBindUnorderedAccessTextures(int units, Texture **textures) -> void
+{
+	assert(units <= 16);
+
+	uint uavs[16]{};
+	bool needUpdate = false;
+
+	for (int i = 0; i < units; i++)
+	{
+		uavs[i] = textures ? textureId(textures[i]) : 0;
+		if (state_.uavs[i] != uavs[i])
+			needUpdate = true;
+	}
+
+	if (!needUpdate)
+		return;
+
+	memcpy(state_.uavs, uavs, sizeof(state_.uavs));
+
+	uint64_t args[1 + 16];
+	args[0] = units;
+	for (int i = 0; i < units; i++)
+		args[1 + i] = uavs[i];
+
+	record(NULL_COMMAND::BIND_UNORDERED_ACCESS, args, units + 1);
+}
+
+auto NullCoreRender::BindStructuredBuffer(int unit, StructuredBuffer *buffer) -> void
+{
+	uint id = buffer ? static_cast<NullStructuredBuffer*>(buffer->GetCoreBuffer())->id() : 0;
+
+	if (state_.srvs[unit] == id)
+		return;
+
+	state_.srvs[unit] = id;
+	Record(NULL_COMMAND::BIND_STRUCTURED_BUFFER, {(uint64_t)unit, id});
+}
+
+auto NullCoreRender::SetMesh(Mesh *mesh) -> void
+{
+	if (state_.mesh == mesh)
+		return;
+
+	state_.mesh = mesh;
+	stat_.meshChanges++;
+	Record(NULL_COMMAND::SET_MESH, {mesh ? getNullMesh(mesh)->id() : 0});
+}
+
+auto NullCoreRender::SetShader(Shader *shader) -> void
+{
+	if (state_.shader == shader)
+		return;
+
+	state_.shader = shader;
+	stat_.shaderChanges++;
+	Record(NULL_COMMAND::SET_SHADER, {shaderId(shader)});
+}
+
+auto NullCoreRender::Draw(Mesh *mesh, uint instances) -> void
+{
+	if (!state_.shader)
+	{
+		LogCritical("NullCoreRender::Draw(): shader not set");
+		return;
+	}
+
+	if (state_.mesh != mesh)
+		SetMesh(mesh);
+
+	NullMesh *nullMesh = getNullMesh(mesh);
+
+	stat_.drawCalls++;
+	stat_.instances += instances;
+	stat_.triangles += instances * (nullMesh->indexFormat() != MESH_INDEX_FORMAT::NONE ? nullMesh->indexNumber() : nullMesh->vertexNumber()) / 3;
+	Record(NULL_COMMAND::DRAW, {nullMesh->id(), instances});
+}
+
+auto NullCoreRender::Dispatch(uint x, uint y, uint z) -> void
+{
+	stat_.dispatches++;
+	Record(NULL_COMMAND::DISPATCH, {x, y, z});
+}
+
+auto NullCoreRender::GetViewport(uint* w, uint* h) -> void
+{
+	*w = state_.width;
+	*h = state_.height;
+}
+
+auto NullCoreRender::SetViewport(int w, int h, int count) -> void
+{
+	if (w < 1 || h < 1)
+		return;
+
+	if (state_.width == (uint)w && state_.height == (uint)h)
+		return;
+
+	state_.width = w;
+	state_.height = h;
+	stat_.stateChanges++;
+	Record(NULL_COMMAND::SET_VIEWPORT, {(uint64_t)w, (uint64_t)h, (uint64_t)count});
+}
+
+auto NullCoreRender::ResizeBuffersByViewort() -> void
+{
+	if (surfaceWidth == state_.width && surfaceHeight == state_.height)
+		return;
+
+	createSurface(state_.width, state_.height);
+	Record(NULL_COMMAND::RESIZE_BUFFERS, {state_.width, state_.height});
+
+	Texture *color = surfaceColor.get();
+	SetRenderTextures(1, &color, surfaceDepth.get());
+}
+
+auto NullCoreRender::StartRecording() -> void
+{
+	log.clear();
+	recording = true;
+}
+
+auto NullCoreRender::SaveRecording(const char *path) -> bool
+{
+	File f = FS->OpenFile(path, FILE_OPEN_MODE::WRITE | FILE_OPEN_MODE::BINARY);
+	if (!f.IsOpen())
+	{
+		LogCritical("NullCoreRender::SaveRecording(): can't open '%s'", path);
+		return false;
+	}
+
+	f.Write(reinterpret_cast<const uint8*>(NULL_RECORDING_MAGIC), 4);
+	f.Write(log.data(), log.size());
+
+	if (!f.Flush())
+	{
+		LogCritical("NullCoreRender::SaveRecording(): can't write '%s'", path);
+		return false;
+	}
+
+	Log("NullCoreRender::SaveRecording(): %s saved to %s", bytesToMBytes(log.size()).c_str(), path);
+	return true;
+}
+
+auto NullCoreRender::LoadRecording(const char *path, vector<uint8>& out) -> bool
+{
+	if (!FS->FileExist(path))
+	{
+		LogCritical("NullCoreRender::LoadRecording(): file '%s' not found", path);
+		return false;
+	}
+
+	File f = FS->OpenFile(path, FILE_OPEN_MODE::READ | FILE_OPEN_MODE::BINARY);
+	size_t fileSize = f.FileSize();
+
+	char magic[4]{};
+	if (fileSize >= 4)
+		f.Read(reinterpret_cast<uint8*>(magic), 4);
+
+	if (memcmp(magic, NULL_RECORDING_MAGIC, 4))
+	{
+		LogCritical("NullCoreRender::LoadRecording(): '%s' is not a recording", path);
+		return false;
+	}
+
+	out.resize(fileSize - 4);
+	f.Read(out.data(), out.size());
+	return true;
+}
+
+auto NullCoreRender::CompareRecordings(const vector<uint8>& a, const vector<uint8>& b) -> int64_t
+{
+	size_t i = 0, j = 0;
+	int64_t frame = 0;
+
+	for (int64_t command = 0;; command++)
+	{
+		if (i == a.size() && j == b.size())
+			return -1;
+
+		if (i == a.size() || j == b.size())
+		{
+			Log("NullCoreRender::CompareRecordings(): recording %s ends at command %lli of frame %lli", i == a.size() ? "a" : "b", command, frame);
+			return command;
+		}
+
+		NULL_COMMAND ca = static_cast<NULL_COMMAND>(a[i++]);
+		NULL_COMMAND cb = static_cast<NULL_COMMAND>(b[j++]);
+		uint64_t sizeA, sizeB;
+
+		if (!readVarint(a, i, sizeA) || !readVarint(b, j, sizeB) || sizeA > a.size() - i || sizeB > b.size() - j)
+		{
+			LogWarning("NullCoreRender::CompareRecordings(): recording is corrupted at command %lli", command);
+			return command;
+		}
+
+		if (ca != cb || sizeA != sizeB || memcmp(a.data() + i, b.data() + j, sizeA))
+		{
+			Log("NullCoreRender::CompareRecordings(): command %lli of frame %lli differs: %s / %s", command, frame, CommandName(ca), CommandName(cb));
+			return command;
+		}
+
+		if (ca == NULL_COMMAND::FRAME)
+			frame++;
+
+		i += sizeA;
+		j += sizeB;
+	}
+}
+
+auto NullCoreRender::CommandName(NULL_COMMAND c) -> const char*
+{
+	static const char *names[] =
+	{
+		"FRAME",
+		"CREATE_MESH",
+		"CREATE_TEXTURE",
+		"CREATE_SHADER",
+		"CREATE_STRUCTURED_BUFFER",
+		"CREATE_CONSTANT_BUFFER",
+		"UPLOAD_STRUCTURED_BUFFER",
+		"UPLOAD_CONSTANT_BUFFER",
+		"READBACK_TEXTURE",
+		"CREATE_MIPMAPS",
+		"SET_PARAMETER",
+		"SET_CONSTANT_BUFFER",
+		"FLUSH_PARAMETERS",
+		"PUSH_STATES",
+		"POP_STATES",
+		"SET_RENDER_TEXTURES",
+		"CLEAR",
+		"SET_DEPTH_TEST",
+		"SET_DEPTH_FUNC",
+		"SET_BLEND_STATE",
+		"SET_CULLING_MODE",
+		"SET_DEPTH_BIAS",
+		"SET_FILLING_MODE",
+		"BIND_TEXTURES",
+		"BIND_UNORDERED_ACCESS",
+		"BIND_STRUCTURED_BUFFER",
+		"SET_MESH",
+		"SET_SHADER",
+		"DRAW",
+		"DISPATCH",
+		"SET_VIEWPORT",
+		"RESIZE_BUFFERS",
+	};
+	static_assert(_countof(names) == (size_t)NULL_COMMAND::NUM, "NullCoreRender::CommandName(): names are not in sync with NULL_COMMAND");
+
+	return c < NULL_COMMAND::NUM ? names[(size_t)c] : "UNKNOWN";
+}
+
+void BenchmarkRenderSubmission(const Engine::CameraData& camera, uint frames)
+{
+	if (strcmp(CORE_RENDER->GetName(), "nullcorerender"))
+	{
+		LogWarning("BenchmarkRenderSubmission(): engine must be initialized with INIT_FLAGS::NULL_RENDER");
+		return;
+	}
+
+	if (!frames)
+		return;
+
+	NullCoreRender *render = static_cast<NullCoreRender*>(CORE_RENDER);
+
+	uint w, h;
+	render->GetViewport(&w, &h);
+
+	typedef std::chrono::high_resolution_clock clock;
+
+	auto frame = [&]() -> double
+	{
+		_core->ManualUpdate();
+
+		clock::time_point t = clock::now();
+		RENDER->RenderFrame(0, camera, nullptr, 0);
+		render->SwapBuffers();
+		return std::chrono::duration<double, std::milli>(clock::now() - t).count();
+	};
+
+	// first frames create render targets and load resources
+	for (int i = 0; i < 3; i++)
+		frame();
+
+	vector<double> ms(frames);
+	size_t commands = 0, drawCalls = 0, uploaded = 0;
+
+	for (uint i = 0; i < frames; i++)
+	{
+		ms[i] = frame();
+
+		const NullCoreRender::Stat& s = render->GetStat();
+		commands += s.commands;
+		drawCalls += s.drawCalls;
+		uploaded += s.uploadedBytes;
+	}
+
+	// size of log of one frame
+	size_t logBytes = 0;
+	if (!render->IsRecording())
+	{
+		render->StartRecording();
+		frame();
+		render->StopRecording();
+		logBytes = render->GetRecording().size();
+	}
+
+	double total = 0.0;
+	for (double t : ms)
+		total += t;
+
+	std::sort(ms.begin(), ms.end());
+
+	Log("BenchmarkRenderSubmission(): %u frames %ux%u", frames, w, h);
+	Log("  RenderFrame(): mean %.3f ms, median %.3f ms, min %.3f ms, 95%% %.3f ms", total / frames, ms[frames / 2], ms[0], ms[frames * 95 / 100]);
+	Log("  per frame: %u commands, %u draw calls, %s uploaded, %s of log", (uint)(commands / frames), (uint)(drawCalls / frames), bytesToMBytes(uploaded / frames).c_str(), bytesToMBytes(logBytes).c_str());
+}
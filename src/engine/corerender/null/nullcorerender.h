@@ -0,0 +1,183 @@
+#pragma once
+#include "common.h"
+#include "icorerender.h"
+
+//
+// Backend without GPU for headless runs (benchmarks of CPU submission cost, command stream diffs).
+// Resources keep their contents in system memory. Commands which DX11 backend would send to device
+// (state changes after redundancy filtering, binds, draws, dispatches, uploads) are counted each frame
+// and, while recording, written to a compact binary log.
+//
+// Log format: for each command opcode byte, payload size and payload.
+// Payload is a sequence of LEB128 integers (floats as bits), raw bytes only for parameter values.
+// Resources are referenced by ids given in creation order, 0 is null.
+//
+enum class NULL_COMMAND : uint8
+{
+	FRAME,					// SwapBuffers()
+	CREATE_MESH,			// id, vertices, indices, topology, attributes, bytes
+	CREATE_TEXTURE,			// id, width, height, type, format, flags, mipmaps, bytes
+	CREATE_SHADER,			// id, compute, hash of text
+	CREATE_STRUCTURED_BUFFER,	// id, size, element size, usage
+	CREATE_CONSTANT_BUFFER,	// id, size
+	UPLOAD_STRUCTURED_BUFFER,	// id, bytes
+	UPLOAD_CONSTANT_BUFFER,	// id, bytes
+	READBACK_TEXTURE,		// id, bytes
+	CREATE_MIPMAPS,			// id
+	SET_PARAMETER,			// shader, handle, value bytes
+	SET_CONSTANT_BUFFER,	// shader, buffer handle, buffer
+	FLUSH_PARAMETERS,		// shader, bytes
+	PUSH_STATES,
+	POP_STATES,
+	SET_RENDER_TEXTURES,	// units, textures..., depth
+	CLEAR,					// targets cleared
+	SET_DEPTH_TEST,			// enabled
+	SET_DEPTH_FUNC,			// func
+	SET_BLEND_STATE,		// src, dest
+	SET_CULLING_MODE,		// mode
+	SET_DEPTH_BIAS,			// bias
+	SET_FILLING_MODE,		// mode
+	BIND_TEXTURES,			// units, flags, textures...
+	BIND_UNORDERED_ACCESS,	// units, textures...
+	BIND_STRUCTURED_BUFFER,	// unit, buffer
+	SET_MESH,				// mesh
+	SET_SHADER,				// shader
+	DRAW,					// mesh, instances
+	DISPATCH,				// x, y, z
+	SET_VIEWPORT,			// width, height, count
+	RESIZE_BUFFERS,			// width, height
+	NUM
+};
+
+class NullCoreRender : public ICoreRender, IProfilerCallback
+{
+public:
+	struct Stat
+	{
+		int commands{0};
+		int drawCalls{0};
+		int instances{0};
+		size_t triangles{0};
+		int dispatches{0};
+		int clearCalls{0};
+		int shaderChanges{0};
+		int meshChanges{0};
+		int textureChanges{0};
+		int stateChanges{0}; // depth, blend, rasterizer, render targets, viewport
+		size_t uploadedBytes{0};
+		size_t readbackBytes{0};
+
+		void clear() { *this = Stat(); }
+	};
+
+	struct State
+	{
+		uint width{0}, height{0};
+
+		Shader *shader{};
+		Mesh *mesh{};
+
+		uint srvs[16]{}; // ids of textures and structured buffers
+		uint uavs[16]{};
+
+		Texture *renderTargets[8]{};
+		Texture *renderDepth{};
+
+		int depthTest{1};
+		DEPTH_FUNC depthFunc{DEPTH_FUNC::LESS};
+		BLEND_FACTOR blendSrc{BLEND_FACTOR::NONE};
+		BLEND_FACTOR blendDest{BLEND_FACTOR::NONE};
+		CULLING_MODE cullingMode{CULLING_MODE::BACK};
+		float depthBias{0.0f};
+		FILLING_MODE fillingMode{FILLING_MODE::SOLID};
+	};
+
+protected:
+	State state_{};
+	Stat stat_;
+	Stat oldStat_;
+
+	uint surfaceWidth{0};
+	uint surfaceHeight{0};
+	std::unique_ptr<Texture> surfaceColor;
+	std::unique_ptr<Texture> surfaceDepth;
+
+	uint lastId{0};
+	bool recording{false};
+	vector<uint8> log;
+	vector<uint8> payload; // of current command
+
+	void createSurface(uint w, uint h);
+	void record(NULL_COMMAND c, const uint64_t *args, size_t num, const void *data = nullptr, size_t bytes = 0);
+
+public:
+	virtual ~NullCoreRender();
+	auto Init(const WindowHandle* handle, int MSAASamples, int VSyncOn) -> bool override;
+	auto Free() -> void override;
+	auto MakeCurrent(const WindowHandle* handle) -> void override;
+	auto SwapBuffers() -> void override;
+	auto GetSurfaceColorTexture() -> Texture* override { return surfaceColor.get(); }
+	auto GetSurfaceDepthTexture() -> Texture* override { return surfaceDepth.get(); }
+
+	auto CreateMesh(const MeshDataDesc *dataDesc, const MeshIndexDesc *indexDesc, VERTEX_TOPOLOGY mode) -> ICoreMesh* override;
+	auto CreateTexture(const uint8 *pData, uint width, uint height, TEXTURE_TYPE type, TEXTURE_FORMAT format, TEXTURE_CREATE_FLAGS flags, int mipmapsPresented) -> ICoreTexture* override;
+	auto CreateShader(const char *vertText, const char *fragText, const char *geomText, ERROR_COMPILE_SHADER &err) -> ICoreShader* override;
+	auto CreateComputeShader(const char *compText, ERROR_COMPILE_SHADER &err) -> ICoreShader* override;
+	auto CreateStructuredBuffer(uint size, uint elementSize, BUFFER_USAGE usage) -> ICoreStructuredBuffer* override;
+	auto CreateConstantBuffer(uint size) -> ICoreConstantBuffer* override;
+
+	auto PushStates() -> void override;
+	auto PopStates() -> void override;
+
+	auto SetRenderTextures(int units, Texture **textures, Texture *depthTex) -> void override;
+	auto Clear() -> void override;
+	auto SetDepthTest(int enabled) -> void override;
+	auto SetDepthFunc(DEPTH_FUNC func) -> void override;
+	auto SetBlendState(BLEND_FACTOR src, BLEND_FACTOR dest) -> void override;
+	auto SetCullingMode(CULLING_MODE value) -> void override;
+	auto SetDepthBias(float bias) -> void override;
+	auto SetFillingMode(FILLING_MODE value) -> void override;
+	auto BindTextures(int units, Texture **textures, BIND_TETURE_FLAGS flags) -> void override;
+	auto CSBindUnorderedAccessTextures(int units, Texture **textures) -> void override;
+	auto BindStructuredBuffer(int unit, StructuredBuffer *buffer) -> void override;
+	auto SetMesh(Mesh* mesh) -> void override;
+	auto SetShader(Shader *shader) -> void override;
+	auto Draw(Mesh *mesh, uint instances) -> void override;
+	auto Dispatch(uint x, uint y, uint z) -> void override;
+	auto GetViewport(uint* w, uint* h) -> void override;
+	auto SetViewport(int w, int h, int count = 1) -> void override;
+	auto ResizeBuffersByViewort() -> void override;
+
+	auto CreateGPUTiming(uint32_t frames, uint32_t timers) -> void override {}
+	auto TimersBeginFrame(uint32_t timerID) -> void override {}
+	auto TimersEndFrame(uint32_t timerID) -> void override {}
+	auto TimersBeginPoint(uint32_t timerID, uint32_t pointID) -> void override {}
+	auto TimersEndPoint(uint32_t timerID, uint32_t pointID) -> void override {}
+	auto GetTimeInMsForPoint(uint32_t timerID, uint32_t pointID) -> float override { return 0.0f; }
+
+	auto GetName() -> const char * override { return "nullcorerender"; }
+
+public:
+	// Internal API
+	void writeLines(TextArena& out) override;
+	void Update() override;
+
+	// Called by resources and commands. Counts command and appends it to log while recording
+	auto Record(NULL_COMMAND c, std::initializer_list<uint64_t> args, const void *data = nullptr, size_t bytes = 0) -> void;
+	auto NextId() -> uint { return ++lastId; }
+	auto GetStat() -> Stat& { return stat_; } // of current frame
+	auto GetLastFrameStat() const -> const Stat& { return oldStat_; }
+
+	auto StartRecording() -> void; // clears previous log
+	auto StopRecording() -> void { recording = false; }
+	auto IsRecording() const -> bool { return recording; }
+	auto GetRecording() const -> const vector<uint8>& { return log; }
+	auto SaveRecording(const char *path) -> bool;
+
+	static auto LoadRecording(const char *path, vector<uint8>& out) -> bool;
+	static auto CompareRecordings(const vector<uint8>& a, const vector<uint8>& b) -> int64_t; // index of first different command, -1 if equal
+	static auto CommandName(NULL_COMMAND c) -> const char*;
+};
+
+// Renders frames with NullCoreRender and logs CPU time of Render::RenderFrame() and commands per frame
+void BenchmarkRenderSubmission(const Engine::CameraData& camera, uint frames = 200);
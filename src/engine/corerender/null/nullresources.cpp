@@ -0,0 +1,269 @@
+#include "pch.h"
+#include "nullresources.h"
+#include "nullcorerender.h"
+#include "core.h"
+
+static NullCoreRender* getRender()
+{
+	return static_cast<NullCoreRender*>(CORE_RENDER);
+}
+
+static uint mipmapsNumber(uint width, uint height) // rounding down rule
+{
+	uint n = 1;
+	for (uint s = max(width, height); s > 1; s >>= 1)
+		n++;
+	return n;
+}
+
+static size_t levelBytes(uint width, uint height, TEXTURE_FORMAT format)
+{
+	if (isCompressedFormat(format))
+		return size_t((width + 3) / 4) * ((height + 3) / 4) * (format == TEXTURE_FORMAT::DXT1 ? 8 : 16);
+	return size_t(width) * height * bytesPerPixel(format);
+}
+
+NullMesh::NullMesh(uint id, const MeshDataDesc *dataDesc, const MeshIndexDesc *indexDesc, VERTEX_TOPOLOGY mode, INPUT_ATTRUBUTE a, int bytesWidth) :
+	_id(id), _number_of_vertices(dataDesc->numberOfVertex), _topology(mode), _attributes(a), _bytesWidth(bytesWidth)
+{
+	_vertices.resize(size_t(bytesWidth) * dataDesc->numberOfVertex);
+	if (dataDesc->pData)
+		memcpy(_vertices.data(), dataDesc->pData, _vertices.size());
+
+	if (indexDesc->format != MESH_INDEX_FORMAT::NONE)
+	{
+		_index_format = indexDesc->format;
+		_number_of_indicies = indexDesc->number;
+		_indices.resize(size_t(indexDesc->number) * (indexDesc->format == MESH_INDEX_FORMAT::INT32 ? 4 : 2));
+		if (indexDesc->pData)
+			memcpy(_indices.data(), indexDesc->pData, _indices.size());
+	}
+}
+
+NullTexture::NullTexture(uint id, const uint8 *pData, uint width, uint height, TEXTURE_TYPE type, TEXTURE_FORMAT format, TEXTURE_CREATE_FLAGS flags, int mipmapsPresented) :
+	_id(id), _width(width), _height(height), _format(format), _type(type), _flags(flags)
+{
+	const bool generate = bool(flags & TEXTURE_CREATE_FLAGS::GENERATE_MIPMAPS) && !isCompressedFormat(format);
+	_mipmaps = mipmapsPresented || generate ? mipmapsNumber(width, height) : 1;
+
+	const uint faces = type == TEXTURE_TYPE::TYPE_CUBE ? 6 : 1;
+	const size_t chain = ChainBytes(width, height, format, _mipmaps);
+	_data.resize(chain * faces);
+
+	if (!pData)
+		return;
+
+	if (mipmapsPresented || _mipmaps == 1)
+		memcpy(_data.data(), pData, _data.size());
+	else
+	{
+		// only top level of each face is passed
+		const size_t top = levelBytes(width, height, format);
+		for (uint f = 0; f < faces; f++)
+			memcpy(_data.data() + f * chain, pData + f * top, top);
+	}
+}
+
+size_t NullTexture::ChainBytes(uint width, uint height, TEXTURE_FORMAT format, uint mipmaps)
+{
+	size_t bytes = 0;
+	for (uint i = 0; i < mipmaps; i++)
+		bytes += levelBytes(max(width >> i, 1u), max(height >> i, 1u), format);
+	return bytes;
+}
+
+auto NullTexture::GetVideoMemoryUsage() -> size_t
+{
+	size_t samples = 1;
+	switch (_flags & TEXTURE_CREATE_FLAGS::MSAA)
+	{
+		case TEXTURE_CREATE_FLAGS::MSAA_2x: samples = 2; break;
+		case TEXTURE_CREATE_FLAGS::MSAA_4x: samples = 4; break;
+		case TEXTURE_CREATE_FLAGS::MSAA_8x: samples = 8; break;
+	}
+	return _data.size() * samples;
+}
+
+auto NullTexture::ReadPixel2D(void *data, int x, int y) -> int
+{
+	const int bytes = (int)bytesPerPixel(_format);
+	memcpy(data, _data.data() + (size_t(y) * _width + x) * bytes, bytes);
+
+	NullCoreRender *render = getRender();
+	render->Record(NULL_COMMAND::READBACK_TEXTURE, {_id, (uint64_t)bytes});
+	render->GetStat().readbackBytes += bytes;
+	return bytes;
+}
+
+auto NullTexture::GetData(uint8_t* pDataOut, size_t length) -> void
+{
+	const size_t bytes = min(length, _data.size());
+	memcpy(pDataOut, _data.data(), bytes);
+
+	NullCoreRender *render = getRender();
+	render->Record(NULL_COMMAND::READBACK_TEXTURE, {_id, bytes});
+	render->GetStat().readbackBytes += bytes;
+}
+
+template<typename T>
+static void downsample(const T *src, uint srcWidth, uint srcHeight, T *dst, uint channels)
+{
+	const uint w = max(srcWidth >> 1, 1u);
+	const uint h = max(srcHeight >> 1, 1u);
+
+	for (uint y = 0; y < h; y++)
+	{
+		const uint y0 = min(y * 2, srcHeight - 1), y1 = min(y * 2 + 1, srcHeight - 1);
+		for (uint x = 0; x < w; x++)
+		{
+			const uint x0 = min(x * 2, srcWidth - 1), x1 = min(x * 2 + 1, srcWidth - 1);
+			for (uint c = 0; c < channels; c++)
+			{
+				float sum = float(src[(y0 * srcWidth + x0) * channels + c]) + float(src[(y0 * srcWidth + x1) * channels + c]) +
+					float(src[(y1 * srcWidth + x0) * channels + c]) + float(src[(y1 * srcWidth + x1) * channels + c]);
+				dst[(y * w + x) * channels + c] = std::is_integral<T>::value ? T(sum * 0.25f + 0.5f) : T(sum * 0.25f);
+			}
+		}
+	}
+}
+
+auto NullTexture::CreateMipmaps() -> void
+{
+	getRender()->Record(NULL_COMMAND::CREATE_MIPMAPS, {_id});
+
+	// box filter for formats with 8-bit and 32-bit float channels, others keep their levels
+	uint channels = 0;
+	bool floats = false;
+	switch (_format)
+	{
+		case TEXTURE_FORMAT::R8:		channels = 1; break;
+		case TEXTURE_FORMAT::RG8:		channels = 2; break;
+		case TEXTURE_FORMAT::RGBA8:
+		case TEXTURE_FORMAT::BGRA8:		channels = 4; break;
+		case TEXTURE_FORMAT::R32F:		channels = 1; floats = true; break;
+		case TEXTURE_FORMAT::RG32F:		channels = 2; floats = true; break;
+		case TEXTURE_FORMAT::RGBA32F:	channels = 4; floats = true; break;
+		default: return;
+	}
+
+	const uint faces = _type == TEXTURE_TYPE::TYPE_CUBE ? 6 : 1;
+	const size_t chain = ChainBytes(_width, _height, _format, _mipmaps);
+
+	for (uint f = 0; f < faces; f++)
+	{
+		uint8 *level = _data.data() + f * chain;
+		for (uint i = 1; i < _mipmaps; i++)
+		{
+			const uint w = max(_width >> (i - 1), 1u);
+			const uint h = max(_height >> (i - 1), 1u);
+			uint8 *next = level + levelBytes(w, h, _format);
+
+			if (floats)
+				downsample(reinterpret_cast<const float*>(level), w, h, reinterpret_cast<float*>(next), channels);
+			else
+				downsample(level, w, h, next, channels);
+
+			level = next;
+		}
+	}
+}
+
+void NullShader::setParameter(int handle, const void *data, size_t bytes)
+{
+	if (handle < 0)
+		return;
+
+	memcpy(constants.data() + handle * SLOT_BYTES, data, bytes);
+	dirtyBytes += bytes;
+
+	getRender()->Record(NULL_COMMAND::SET_PARAMETER, {_id, (uint64_t)handle}, data, bytes);
+}
+
+auto NullShader::GetParameterHandle(const char* name) -> int
+{
+	auto it = parametersMap.find(name);
+	if (it != parametersMap.end())
+		return it->second;
+
+	int handle = (int)parametersMap.size();
+	parametersMap.emplace(name, handle);
+	constants.resize(constants.size() + SLOT_BYTES);
+	return handle;
+}
+
+auto NullShader::SetFloatParameter(const char* name, float value) -> void
+{
+	setParameter(GetParameterHandle(name), &value, sizeof(value));
+}
+
+auto NullShader::SetVec4Parameter(const char* name, const vec4 *value) -> void
+{
+	setParameter(GetParameterHandle(name), value, sizeof(vec4));
+}
+
+auto NullShader::SetMat4Parameter(const char* name, const mat4 *value) -> void
+{
+	setParameter(GetParameterHandle(name), value, sizeof(mat4));
+}
+
+auto NullShader::SetUintParameter(const char* name, uint value) -> void
+{
+	setParameter(GetParameterHandle(name), &value, sizeof(value));
+}
+
+auto NullShader::SetFloatParameter(int handle, float value) -> void
+{
+	setParameter(handle, &value, sizeof(value));
+}
+
+auto NullShader::SetVec4Parameter(int handle, const vec4 *value) -> void
+{
+	setParameter(handle, value, sizeof(vec4));
+}
+
+auto NullShader::SetMat4Parameter(int handle, const mat4 *value) -> void
+{
+	setParameter(handle, value, sizeof(mat4));
+}
+
+auto NullShader::SetUintParameter(int handle, uint value) -> void
+{
+	setParameter(handle, &value, sizeof(value));
+}
+
+auto NullShader::SetConstantBuffer(int bufferHandle, ICoreConstantBuffer *buffer) -> void
+{
+	uint bufferId = buffer ? static_cast<NullConstantBuffer*>(buffer)->id() : 0;
+	getRender()->Record(NULL_COMMAND::SET_CONSTANT_BUFFER, {_id, (uint64_t)bufferHandle, bufferId});
+}
+
+auto NullShader::FlushParameters() -> void
+{
+	if (!dirtyBytes)
+		return;
+
+	NullCoreRender *render = getRender();
+	render->Record(NULL_COMMAND::FLUSH_PARAMETERS, {_id, dirtyBytes});
+	render->GetStat().uploadedBytes += dirtyBytes;
+	dirtyBytes = 0;
+}
+
+auto NullStructuredBuffer::SetData(uint8 *data, size_t size) -> void
+{
+	assert(size <= _data.size());
+	memcpy(_data.data(), data, size);
+
+	NullCoreRender *render = getRender();
+	render->Record(NULL_COMMAND::UPLOAD_STRUCTURED_BUFFER, {_id, size});
+	render->GetStat().uploadedBytes += size;
+}
+
+auto NullConstantBuffer::SetData(const uint8 *data, size_t size) -> void
+{
+	assert(size <= _data.size());
+	memcpy(_data.data(), data, size);
+
+	NullCoreRender *render = getRender();
+	render->Record(NULL_COMMAND::UPLOAD_CONSTANT_BUFFER, {_id, size});
+	render->GetStat().uploadedBytes += size;
+}
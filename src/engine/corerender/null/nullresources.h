@@ -0,0 +1,143 @@
+#pragma once
+#include "common.h"
+#include "icorerender.h"
+#include <map>
+
+//
+// Resources of NullCoreRender. Contents are kept in system memory in the same layout as DX11 backend uploads them.
+//
+
+class NullMesh : public ICoreMesh
+{
+	uint _id;
+	vector<uint8> _vertices; // interleaved: position, normal, tex coord, color
+	vector<uint8> _indices;
+	uint _number_of_vertices = 0u;
+	uint _number_of_indicies = 0u;
+	MESH_INDEX_FORMAT _index_format = MESH_INDEX_FORMAT::NONE;
+	VERTEX_TOPOLOGY _topology = VERTEX_TOPOLOGY::TRIANGLES;
+	INPUT_ATTRUBUTE _attributes = INPUT_ATTRUBUTE::UNKNOWN;
+	int _bytesWidth = 0;
+
+public:
+	NullMesh(uint id, const MeshDataDesc *dataDesc, const MeshIndexDesc *indexDesc, VERTEX_TOPOLOGY mode, INPUT_ATTRUBUTE a, int bytesWidth);
+
+	uint				id() const { return _id; }
+	const uint8*		vertices() const { return _vertices.data(); }
+	const uint8*		indices() const { return _indices.data(); }
+	int					stride() const { return _bytesWidth; }
+	uint				vertexNumber() const { return _number_of_vertices; }
+	MESH_INDEX_FORMAT	indexFormat() const { return _index_format; }
+	uint				indexNumber() const { return _number_of_indicies; }
+
+	// ICoreMesh
+	auto GetNumberOfVertex()-> int override { return _number_of_vertices; }
+	auto GetAttributes() -> INPUT_ATTRUBUTE override { return _attributes; }
+	auto GetVertexTopology() -> VERTEX_TOPOLOGY override { return _topology; }
+	auto GetVideoMemoryUsage() -> size_t override { return _vertices.size() + _indices.size(); }
+};
+
+class NullTexture : public ICoreTexture
+{
+	uint _id;
+	vector<uint8> _data; // all mipmaps of all faces
+	uint _width;
+	uint _height;
+	uint _mipmaps;
+	TEXTURE_FORMAT _format;
+	TEXTURE_TYPE _type;
+	TEXTURE_CREATE_FLAGS _flags;
+
+public:
+	NullTexture(uint id, const uint8 *pData, uint width, uint height, TEXTURE_TYPE type, TEXTURE_FORMAT format, TEXTURE_CREATE_FLAGS flags, int mipmapsPresented);
+
+	uint			id() const { return _id; }
+	uint8*			data() { return _data.data(); }
+	TEXTURE_FORMAT	format() const { return _format; }
+	TEXTURE_TYPE	type() const { return _type; }
+	TEXTURE_CREATE_FLAGS flags() const { return _flags; }
+
+	// Bytes of all mipmaps of one face
+	static size_t	ChainBytes(uint width, uint height, TEXTURE_FORMAT format, uint mipmaps);
+
+	// ICoreTexture
+	auto GetVideoMemoryUsage() -> size_t override;
+	auto GetWidth() -> int override { return _width; }
+	auto GetHeight() -> int override { return _height; }
+	auto GetMipmaps() -> int override { return _mipmaps; }
+	auto ReadPixel2D(void *data, int x, int y) -> int override;
+	auto GetData(uint8_t* pDataOut, size_t length) -> void override;
+	auto CreateMipmaps() -> void override;
+};
+
+class NullShader : public ICoreShader
+{
+	// Without reflection handles are given to names on first request,
+	// each parameter has slot big enough for mat4. Constant buffers are not reported,
+	// so materials set parameters one by one.
+	static constexpr uint SLOT_BYTES = sizeof(mat4);
+
+	uint _id;
+	bool _compute;
+	vector<uint8> constants;
+	std::map<std::string, int, std::less<>> parametersMap; // name -> handle
+	size_t dirtyBytes = 0;
+
+	void setParameter(int handle, const void *data, size_t bytes);
+
+public:
+	NullShader(uint id, bool compute) : _id(id), _compute(compute) {}
+
+	uint id() const { return _id; }
+	bool isCompute() const { return _compute; }
+	const uint8 *parameter(int handle) const { return constants.data() + handle * SLOT_BYTES; }
+
+	auto SetFloatParameter(const char* name, float value) -> void override;
+	auto SetVec4Parameter(const char* name, const vec4 *value) -> void override;
+	auto SetMat4Parameter(const char* name, const mat4 *value) -> void override;
+	auto SetUintParameter(const char* name, uint value) -> void override;
+	auto GetParameterHandle(const char* name) -> int override;
+	auto SetFloatParameter(int handle, float value) -> void override;
+	auto SetVec4Parameter(int handle, const vec4 *value) -> void override;
+	auto SetMat4Parameter(int handle, const mat4 *value) -> void override;
+	auto SetUintParameter(int handle, uint value) -> void override;
+	auto GetConstantBufferHandle(const char* name) -> int override { return -1; }
+	auto GetConstantBufferSize(int bufferHandle) -> uint override { return 0; }
+	auto GetParameterOffset(int bufferHandle, const char* name, uint *bytes) -> int override { return -1; }
+	auto SetConstantBuffer(int bufferHandle, ICoreConstantBuffer *buffer) -> void override;
+	auto FlushParameters() -> void override;
+};
+
+class NullStructuredBuffer : public ICoreStructuredBuffer
+{
+	uint _id;
+	vector<uint8> _data;
+	uint elementSize;
+
+public:
+	NullStructuredBuffer(uint id, uint size, uint elementSize_) : _id(id), _data(size), elementSize(elementSize_) {}
+
+	uint id() const { return _id; }
+	const uint8 *data() const { return _data.data(); }
+
+	auto SetData(uint8 *data, size_t size) -> void override;
+	auto GetSize() -> uint override { return (uint)_data.size(); }
+	auto GetElementSize() -> uint override { return elementSize; }
+	auto GetVideoMemoryUsage() -> size_t override { return _data.size(); }
+};
+
+class NullConstantBuffer : public ICoreConstantBuffer
+{
+	uint _id;
+	vector<uint8> _data;
+
+public:
+	NullConstantBuffer(uint id, uint size) : _id(id), _data((size + 15) & ~15) {}
+
+	uint id() const { return _id; }
+	const uint8 *data() const { return _data.data(); }
+
+	auto SetData(const uint8 *data, size_t size) -> void override;
+	auto GetSize() -> uint override { return (uint)_data.size(); }
+	auto GetVideoMemoryUsage() -> size_t override { return _data.size(); }
+};
@@ -0,0 +1,1056 @@
+#include "pch.h"
+#include "softwarecorerender.h"
+#include "corerender/null/nullresources.h"
+#include "core.h"
+#include "render.h"
+#include "texture.h"
+#include "mesh.h"
+#include "shader.h"
+#include "structured_buffer.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <climits>
+
+#define TRIANGLES_PER_CHUNK 256
+#define MAX_CHUNKS 64
+#define VERTICES_PER_TASK 1024
+#define DEPTH_MAX 0x00FFFFFFu
+#define INSTANCE_BUFFER_SLOT 15 // see model/vertex.hlsli
+
+// Layout of instance_buffer of ENG_INSTANCED shaders
+struct InstanceTransformation
+{
+	mat4 MVP;
+	mat4 MVP_prev;
+	mat4 M;
+	mat4 NM;
+};
+
+struct SoftwareCoreRender::DrawContext
+{
+	ShaderInfo info;
+	const NullShader *shader;
+	const NullMesh *mesh;
+	const InstanceTransformation *instanceTransforms; // nullptr for not instanced shaders
+	uint vertexCount;
+	uint trianglesPerInstance;
+	int varyings; // normal xyz, MVP_prev * position xyzw
+	bool normals;
+
+	vec4 outputs[2]; // constant outputs of shader
+	uint id;
+
+	NullTexture *targets[8];
+	int numTargets;
+	NullTexture *depth;
+	bool depthTest;
+	DEPTH_FUNC depthFunc;
+	float depthBias; // in units of depth buffer
+	CULLING_MODE cullingMode;
+	BLEND_FACTOR blendSrc;
+	BLEND_FACTOR blendDest;
+
+	int viewportWidth, viewportHeight;
+	int width, height; // rasterized area: viewport clamped by sizes of targets
+	int tilesX, tilesY;
+};
+
+static NullTexture *getNullTexture(Texture *tex)
+{
+	return tex ? static_cast<NullTexture*>(tex->GetCoreTexture()) : nullptr;
+}
+
+static uint8 unorm8(float v)
+{
+	return uint8(saturate(v) * 255.0f + 0.5f);
+}
+
+static uint16_t floatToHalf(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+
+	const uint32_t sign = (x >> 16) & 0x8000;
+	const uint32_t exponent = (x >> 23) & 0xFF;
+	uint32_t mantissa = x & 0x7FFFFF;
+
+	if (exponent == 0xFF) // inf, nan
+		return uint16_t(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+	const int e = int(exponent) - 127 + 15;
+
+	if (e >= 31)
+		return uint16_t(sign | 0x7C00);
+
+	if (e <= 0) // subnormal
+	{
+		if (e < -10)
+			return uint16_t(sign);
+
+		mantissa |= 0x800000;
+		const uint32_t shift = uint32_t(14 - e);
+		const uint32_t rem = mantissa & ((1u << shift) - 1);
+		const uint32_t half = 1u << (shift - 1);
+		uint32_t h = mantissa >> shift;
+		if (rem > half || (rem == half && (h & 1)))
+			h++;
+		return uint16_t(sign | h);
+	}
+
+	// round to nearest even, carry into exponent is correct
+	uint32_t h = sign | uint32_t(e) << 10 | mantissa >> 13;
+	const uint32_t rem = mantissa & 0x1FFF;
+	if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+		h++;
+	return uint16_t(h);
+}
+
+static float halfToFloat(uint16_t h)
+{
+	const uint32_t sign = uint32_t(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1F;
+	uint32_t mantissa = h & 0x3FF;
+	uint32_t x;
+
+	if (exponent == 0)
+	{
+		if (!mantissa)
+			x = sign;
+		else
+		{
+			exponent = 127 - 15 + 1;
+			while (!(mantissa & 0x400))
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			x = sign | exponent << 23 | (mantissa & 0x3FF) << 13;
+		}
+	}
+	else if (exponent == 31)
+		x = sign | 0x7F800000 | mantissa << 13;
+	else
+		x = sign | (exponent - 15 + 127) << 23 | mantissa << 13;
+
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+static void writePixel(uint8 *p, TEXTURE_FORMAT format, const float v[4])
+{
+	uint16_t h[4];
+
+	switch (format)
+	{
+		case TEXTURE_FORMAT::R8:		p[0] = unorm8(v[0]); break;
+		case TEXTURE_FORMAT::RG8:		p[0] = unorm8(v[0]); p[1] = unorm8(v[1]); break;
+		case TEXTURE_FORMAT::RGBA8:		for (int i = 0; i < 4; i++) p[i] = unorm8(v[i]); break;
+		case TEXTURE_FORMAT::BGRA8:		p[0] = unorm8(v[2]); p[1] = unorm8(v[1]); p[2] = unorm8(v[0]); p[3] = unorm8(v[3]); break;
+		case TEXTURE_FORMAT::R16F:
+		case TEXTURE_FORMAT::RG16F:
+		case TEXTURE_FORMAT::RGBA16F:
+		{
+			const size_t channels = bytesPerPixel(format) / 2;
+			for (size_t i = 0; i < channels; i++)
+				h[i] = floatToHalf(v[i]);
+			memcpy(p, h, channels * 2);
+			break;
+		}
+		case TEXTURE_FORMAT::R32F:		memcpy(p, v, 4); break;
+		case TEXTURE_FORMAT::RG32F:		memcpy(p, v, 8); break;
+		case TEXTURE_FORMAT::RGBA32F:	memcpy(p, v, 16); break;
+		case TEXTURE_FORMAT::R32UI:
+		{
+			const uint32_t u = uint32_t(max(v[0], 0.0f));
+			memcpy(p, &u, 4);
+			break;
+		}
+		default: break;
+	}
+}
+
+static void readPixel(const uint8 *p, TEXTURE_FORMAT format, float v[4])
+{
+	v[0] = v[1] = v[2] = 0.0f;
+	v[3] = 1.0f;
+
+	switch (format)
+	{
+		case TEXTURE_FORMAT::R8:
+		case TEXTURE_FORMAT::RG8:
+		case TEXTURE_FORMAT::RGBA8:
+			for (size_t i = 0; i < bytesPerPixel(format); i++)
+				v[i] = p[i] / 255.0f;
+			break;
+		case TEXTURE_FORMAT::BGRA8:
+			v[0] = p[2] / 255.0f; v[1] = p[1] / 255.0f; v[2] = p[0] / 255.0f; v[3] = p[3] / 255.0f;
+			break;
+		case TEXTURE_FORMAT::R16F:
+		case TEXTURE_FORMAT::RG16F:
+		case TEXTURE_FORMAT::RGBA16F:
+			for (size_t i = 0; i < bytesPerPixel(format) / 2; i++)
+			{
+				uint16_t h;
+				memcpy(&h, p + i * 2, 2);
+				v[i] = halfToFloat(h);
+			}
+			break;
+		case TEXTURE_FORMAT::R32F:
+		case TEXTURE_FORMAT::RG32F:
+		case TEXTURE_FORMAT::RGBA32F:
+			memcpy(v, p, bytesPerPixel(format));
+			break;
+		default: break;
+	}
+}
+
+static float blendFactor(BLEND_FACTOR f, const float src[4], const float dst[4], int c)
+{
+	switch (f)
+	{
+		case BLEND_FACTOR::ZERO:					return 0.0f;
+		case BLEND_FACTOR::ONE:						return 1.0f;
+		case BLEND_FACTOR::SRC_COLOR:				return src[c];
+		case BLEND_FACTOR::ONE_MINUS_SRC_COLOR:		return 1.0f - src[c];
+		case BLEND_FACTOR::SRC_ALPHA:				return src[3];
+		case BLEND_FACTOR::ONE_MINUS_SRC_ALPHA:		return 1.0f - src[3];
+		case BLEND_FACTOR::DEST_ALPHA:				return dst[3];
+		case BLEND_FACTOR::ONE_MINUS_DEST_ALPHA:	return 1.0f - dst[3];
+		case BLEND_FACTOR::DEST_COLOR:				return dst[c];
+		case BLEND_FACTOR::ONE_MINUS_DEST_COLOR:	return 1.0f - dst[c];
+		default:									return 1.0f;
+	}
+}
+
+static bool depthPass(DEPTH_FUNC func, uint32_t d, uint32_t stored)
+{
+	switch (func)
+	{
+		case DEPTH_FUNC::NEVER:			return false;
+		case DEPTH_FUNC::LESS:			return d < stored;
+		case DEPTH_FUNC::EQUAL:			return d == stored;
+		case DEPTH_FUNC::LESS_EQUAL:	return d <= stored;
+		case DEPTH_FUNC::GREATER:		return d > stored;
+		case DEPTH_FUNC::NOT_EQUAL:		return d != stored;
+		case DEPTH_FUNC::GREATER_EQUAL:	return d >= stored;
+		default:						return true;
+	}
+}
+
+static uint32_t quantizeDepth(float z)
+{
+	return uint32_t(saturate(z) * float(DEPTH_MAX) + 0.5f);
+}
+
+static string removeSpaces(const char *text)
+{
+	string out;
+	if (!text)
+		return out;
+
+	out.reserve(strlen(text));
+	for (const char *c = text; *c; c++)
+		if (!isspace((unsigned char)*c))
+			out += *c;
+	return out;
+}
+
+// Evaluates edge functions A * x + row and depth for 4 pixels of row starting at x (multiple of 4).
+// Returns mask of pixels inside of triangle and inside of [x0, x1]
+static int coverBlock(const float A[3], const float row[3], uint topLeft, const float depths[3], float invArea, int x, int x0, int x1, float e[3][4], float z[4])
+{
+#if defined(VECTOR_MATH_SSE)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128i xi = _mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3));
+	const __m128 px = _mm_add_ps(_mm_cvtepi32_ps(xi), _mm_set1_ps(0.5f));
+
+	__m128 inside = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(xi, _mm_set1_epi32(x0 - 1)), _mm_cmplt_epi32(xi, _mm_set1_epi32(x1 + 1))));
+	__m128 depth = zero;
+
+	for (int k = 0; k < 3; k++)
+	{
+		// same operations order for both triangles of shared edge: their values are exactly opposite
+		const __m128 ek = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[k]), px), _mm_set1_ps(row[k]));
+		const __m128 tl = _mm_castsi128_ps(_mm_set1_epi32(topLeft & (1u << k) ? -1 : 0));
+
+		inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(ek, zero), _mm_and_ps(_mm_cmpeq_ps(ek, zero), tl)));
+		depth = _mm_add_ps(depth, _mm_mul_ps(ek, _mm_set1_ps(depths[k])));
+
+		_mm_storeu_ps(e[k], ek);
+	}
+
+	const int mask = _mm_movemask_ps(inside);
+	if (mask)
+		_mm_storeu_ps(z, _mm_mul_ps(depth, _mm_set1_ps(invArea)));
+	return mask;
+#else
+	int mask = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		const float px = float(x + i) + 0.5f;
+		bool inside = x + i >= x0 && x + i <= x1;
+		float depth = 0.0f;
+
+		for (int k = 0; k < 3; k++)
+		{
+			e[k][i] = A[k] * px + row[k];
+			inside = inside && (e[k][i] > 0.0f || (e[k][i] == 0.0f && (topLeft & (1u << k))));
+			depth += e[k][i] * depths[k];
+		}
+
+		z[i] = depth * invArea;
+		if (inside)
+			mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
+
+auto SoftwareCoreRender::Init(const WindowHandle* handle, int MSAASamples, int VSyncOn) -> bool
+{
+	if (!NullCoreRender::Init(handle, MSAASamples, VSyncOn))
+		return false;
+
+	Log("SoftwareCoreRender Inited: %u threads, %ix%i tiles", _core->GetThreadPool()->GetWorkers() + 1, TILE_SIZE, TILE_SIZE);
+	return true;
+}
+
+auto SoftwareCoreRender::Free() -> void
+{
+	shaders_.clear();
+	memset(structuredBuffers_, 0, sizeof(structuredBuffers_));
+
+	clipVertices_ = vector<ClipVertex>();
+	chunks_ = vector<Chunk>();
+
+	NullCoreRender::Free();
+}
+
+void SoftwareCoreRender::writeLines(TextArena& out)
+{
+	NullCoreRender::writeLines(out);
+
+	out.AddLine("==== Software Core Render ====");
+	out.AddLine("Submitted triangles: %llu", (unsigned long long)oldRasterStat_.submitted);
+	out.AddLine("Rasterized triangles: %llu", (unsigned long long)oldRasterStat_.triangles);
+	out.AddLine("Pixels: %llu", (unsigned long long)oldRasterStat_.pixels);
+	out.AddLine("Skipped draws: %i", oldRasterStat_.skippedDraws);
+	out.AddLine("Draw time: %.2f ms", oldRasterStat_.ms);
+	out.AddLine("");
+}
+
+void SoftwareCoreRender::Update()
+{
+	NullCoreRender::Update();
+
+	oldRasterStat_ = rasterStat_;
+	rasterStat_.clear();
+}
+
+auto SoftwareCoreRender::RecognizeShader(const char *vertText, const char *fragText, bool& instanced) -> SOFTWARE_SHADER
+{
+	const string vert = removeSpaces(vertText);
+	const string frag = removeSpaces(fragText);
+
+	instanced = vert.find("instance_buffer") != string::npos;
+
+	// all known shaders output clip position as MVP * position
+	if (vert.find("vs_output.position=mul(MVP,vs_input.PositionIn)") == string::npos)
+		return SOFTWARE_SHADER::UNKNOWN;
+
+	if (frag.find("FS_OUTmainFS") != string::npos && frag.find("SV_Target3") != string::npos && frag.find("out_color.color=base_color") != string::npos)
+		return SOFTWARE_SHADER::DEFERRED;
+
+	if (frag.find("uintmainFS") != string::npos && frag.find("returnid;") != string::npos)
+		return SOFTWARE_SHADER::ID;
+
+	if (frag.find("float4mainFS()") != string::npos && frag.find("returnmain_color;") != string::npos)
+		return SOFTWARE_SHADER::PRIMITIVE;
+
+	return SOFTWARE_SHADER::UNKNOWN;
+}
+
+auto SoftwareCoreRender::CreateShader(const char *vertText, const char *fragText, const char *geomText, ERROR_COMPILE_SHADER &err) -> ICoreShader*
+{
+	NullShader *shader = static_cast<NullShader*>(NullCoreRender::CreateShader(vertText, fragText, geomText, err));
+
+	ShaderInfo info;
+	info.kind = geomText ? SOFTWARE_SHADER::UNKNOWN : RecognizeShader(vertText, fragText, info.instanced);
+
+	if (info.kind != SOFTWARE_SHADER::UNKNOWN)
+	{
+		if (!info.instanced)
+		{
+			info.MVP = shader->GetParameterHandle("MVP");
+			info.MVP_prev = shader->GetParameterHandle("MVP_prev");
+			info.NM = shader->GetParameterHandle("NM");
+		}
+
+		switch (info.kind)
+		{
+			case SOFTWARE_SHADER::DEFERRED:
+				info.base_color = shader->GetParameterHandle("base_color");
+				info.roughness = shader->GetParameterHandle("roughness");
+				info.metalness = shader->GetParameterHandle("metalness");
+				info.reflectivity = shader->GetParameterHandle("reflectivity");
+				break;
+			case SOFTWARE_SHADER::ID:			info.id = shader->GetParameterHandle("id"); break;
+			case SOFTWARE_SHADER::PRIMITIVE:	info.main_color = shader->GetParameterHandle("main_color"); break;
+			default: break;
+		}
+	}
+
+	shaders_[shader->id()] = info;
+	return shader;
+}
+
+auto SoftwareCoreRender::Clear() -> void
+{
+	NullCoreRender::Clear();
+
+	// as DX11 backend: color to zero, depth to 1.0, stencil is kept
+	for (int i = 0; i < 8; i++)
+	{
+		NullTexture *tex = getNullTexture(state_.renderTargets[i]);
+		if (tex)
+			memset(tex->data(), 0, size_t(tex->GetWidth()) * tex->GetHeight() * bytesPerPixel(tex->format()));
+	}
+
+	if (NullTexture *depth = getNullTexture(state_.renderDepth))
+	{
+		uint32_t *d = reinterpret_cast<uint32_t*>(depth->data());
+		const size_t n = size_t(depth->GetWidth()) * depth->GetHeight();
+		for (size_t i = 0; i < n; i++)
+			d[i] = (d[i] & ~DEPTH_MAX) | DEPTH_MAX;
+	}
+}
+
+auto SoftwareCoreRender::BindStructuredBuffer(int unit, StructuredBuffer *buffer) -> void
+{
+	NullCoreRender::BindStructuredBuffer(unit, buffer);
+	structuredBuffers_[unit] = buffer;
+}
+
+void SoftwareCoreRender::transformVertices(const DrawContext& ctx, size_t begin, size_t end)
+{
+	const uint8 *vertices = ctx.mesh->vertices();
+	const size_t stride = ctx.mesh->stride();
+
+	// ranges can cross instances
+	for (size_t i = begin; i < end;)
+	{
+		const size_t instance = i / ctx.vertexCount;
+		const size_t first = i % ctx.vertexCount;
+		const size_t n = min(end - i, ctx.vertexCount - first);
+
+		const mat4 *MVP, *MVP_prev, *NM;
+		if (ctx.instanceTransforms)
+		{
+			const InstanceTransformation& t = ctx.instanceTransforms[instance];
+			MVP = &t.MVP;
+			MVP_prev = &t.MVP_prev;
+			NM = &t.NM;
+		}
+		else
+		{
+			MVP = reinterpret_cast<const mat4*>(ctx.shader->parameter(ctx.info.MVP));
+			MVP_prev = reinterpret_cast<const mat4*>(ctx.shader->parameter(ctx.info.MVP_prev));
+			NM = reinterpret_cast<const mat4*>(ctx.shader->parameter(ctx.info.NM));
+		}
+
+		const uint8 *src = vertices + first * stride;
+		ClipVertex *dst = &clipVertices_[i];
+
+		transformPoints(*MVP, src, stride, &dst->pos, sizeof(ClipVertex), n);
+
+		if (ctx.varyings)
+		{
+			// normal goes to varyings 0..2, its w is overwritten by position of previous frame in 3..6
+			if (ctx.normals)
+				transformPoints(*NM, src + sizeof(vec4), stride, dst->varyings, sizeof(ClipVertex), n);
+			transformPoints(*MVP_prev, src, stride, dst->varyings + 3, sizeof(ClipVertex), n);
+		}
+
+		i += n;
+	}
+}
+
+void SoftwareCoreRender::emitTriangle(const DrawContext& ctx, Chunk& chunk, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2)
+{
+	const ClipVertex *v[3] = {&v0, &v1, &v2};
+
+	float x[3], y[3], invW[3];
+	for (int k = 0; k < 3; k++)
+	{
+		invW[k] = 1.0f / v[k]->pos.w;
+
+		// viewport transform and snapping to 1/16 of pixel
+		const float sx = (v[k]->pos.x * invW[k] * 0.5f + 0.5f) * ctx.viewportWidth;
+		const float sy = (0.5f - v[k]->pos.y * invW[k] * 0.5f) * ctx.viewportHeight;
+		x[k] = std::floor(sx * 16.0f + 0.5f) * (1.0f / 16.0f);
+		y[k] = std::floor(sy * 16.0f + 0.5f) * (1.0f / 16.0f);
+	}
+
+	// positive for clockwise triangles on screen, they are front faces as in DX11 backend
+	const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0.0f || !std::isfinite(area))
+		return;
+
+	if ((ctx.cullingMode == CULLING_MODE::BACK && area < 0.0f) || (ctx.cullingMode == CULLING_MODE::FRONT && area > 0.0f))
+		return;
+
+	int order[3] = {0, 1, 2};
+	if (area < 0.0f)
+		std::swap(order[1], order[2]);
+
+	const float minx = min(min(x[0], x[1]), x[2]), maxx = max(max(x[0], x[1]), x[2]);
+	const float miny = min(min(y[0], y[1]), y[2]), maxy = max(max(y[0], y[1]), y[2]);
+
+	// pixel is inside if its center is inside
+	Triangle tri;
+	tri.minX = (int)std::ceil(min(max(minx - 0.5f, -1.0f), (float)ctx.width));
+	tri.maxX = (int)std::floor(min(max(maxx - 0.5f, -1.0f), (float)ctx.width));
+	tri.minY = (int)std::ceil(min(max(miny - 0.5f, -1.0f), (float)ctx.height));
+	tri.maxY = (int)std::floor(min(max(maxy - 0.5f, -1.0f), (float)ctx.height));
+	tri.minX = max(tri.minX, 0);
+	tri.minY = max(tri.minY, 0);
+	tri.maxX = min(tri.maxX, ctx.width - 1);
+	tri.maxY = min(tri.maxY, ctx.height - 1);
+
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return;
+
+	tri.topLeft = 0;
+	tri.invArea = 1.0f / std::abs(area);
+
+	for (int k = 0; k < 3; k++)
+	{
+		// edge k is opposite to vertex k
+		const int a = order[(k + 1) % 3];
+		const int b = order[(k + 2) % 3];
+		const int c = order[k];
+
+		tri.A[k] = y[a] - y[b];
+		tri.B[k] = x[b] - x[a];
+		tri.C[k] = x[a] * y[b] - y[a] * x[b];
+
+		// top edge goes right, left edge goes up
+		const float dx = x[b] - x[a], dy = y[b] - y[a];
+		if (dy < 0.0f || (dy == 0.0f && dx > 0.0f))
+			tri.topLeft |= 1u << k;
+
+		tri.z[k] = v[c]->pos.z * invW[c] + ctx.depthBias;
+		tri.invW[k] = invW[c];
+		for (int j = 0; j < ctx.varyings; j++)
+			tri.varyings[k][j] = v[c]->varyings[j] * invW[c];
+	}
+
+	const uint index = (uint)chunk.triangles.size();
+	chunk.triangles.push_back(tri);
+
+	const int tx0 = tri.minX / TILE_SIZE, tx1 = tri.maxX / TILE_SIZE;
+	const int ty0 = tri.minY / TILE_SIZE, ty1 = tri.maxY / TILE_SIZE;
+
+	for (int ty = ty0; ty <= ty1; ty++)
+		for (int tx = tx0; tx <= tx1; tx++)
+			chunk.bins[ty * ctx.tilesX + tx].push_back(index);
+
+	chunk.tileMinX = min(chunk.tileMinX, tx0);
+	chunk.tileMinY = min(chunk.tileMinY, ty0);
+	chunk.tileMaxX = max(chunk.tileMaxX, tx1);
+	chunk.tileMaxY = max(chunk.tileMaxY, ty1);
+}
+
+void SoftwareCoreRender::setupTriangles(const DrawContext& ctx, Chunk& chunk, size_t begin, size_t end)
+{
+	const uint8 *indices = ctx.mesh->indices();
+	const MESH_INDEX_FORMAT indexFormat = ctx.mesh->indexFormat();
+
+	auto vertexIndex = [&](size_t i) -> uint
+	{
+		switch (indexFormat)
+		{
+			case MESH_INDEX_FORMAT::INT32: return reinterpret_cast<const uint32_t*>(indices)[i];
+			case MESH_INDEX_FORMAT::INT16: return reinterpret_cast<const uint16_t*>(indices)[i];
+			default: return (uint)i;
+		}
+	};
+
+	for (size_t t = begin; t < end; t++)
+	{
+		const size_t instance = t / ctx.trianglesPerInstance;
+		const size_t first = (t % ctx.trianglesPerInstance) * 3;
+
+		const ClipVertex *v[3];
+		bool valid = true;
+		for (int k = 0; k < 3; k++)
+		{
+			const uint i = vertexIndex(first + k);
+			valid = valid && i < ctx.vertexCount;
+			v[k] = valid ? &clipVertices_[instance * ctx.vertexCount + i] : nullptr;
+		}
+
+		if (!valid)
+			continue;
+
+		uint outside = ~0u, clipNear = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const vec4& p = v[k]->pos;
+			uint code = 0;
+			if (p.x < -p.w) code |= 1;
+			if (p.x > p.w) code |= 2;
+			if (p.y < -p.w) code |= 4;
+			if (p.y > p.w) code |= 8;
+			if (p.z < 0.0f) code |= 16;
+			if (p.z > p.w) code |= 32;
+			outside &= code;
+			clipNear |= code & 16;
+		}
+
+		// all vertices are outside of one plane
+		if (outside)
+			continue;
+
+		if (!clipNear)
+		{
+			emitTriangle(ctx, chunk, *v[0], *v[1], *v[2]);
+			continue;
+		}
+
+		// clip by near plane z = 0, result is triangle or quad
+		ClipVertex polygon[4];
+		int n = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const ClipVertex& a = *v[k];
+			const ClipVertex& b = *v[(k + 1) % 3];
+
+			if (a.pos.z >= 0.0f)
+				polygon[n++] = a;
+
+			if ((a.pos.z >= 0.0f) != (b.pos.z >= 0.0f))
+			{
+				const float f = a.pos.z / (a.pos.z - b.pos.z);
+				ClipVertex& c = polygon[n++];
+				c.pos = a.pos + (b.pos - a.pos) * f;
+				for (int j = 0; j < ctx.varyings; j++)
+					c.varyings[j] = a.varyings[j] + (b.varyings[j] - a.varyings[j]) * f;
+			}
+		}
+
+		for (int k = 2; k < n; k++)
+			emitTriangle(ctx, chunk, polygon[0], polygon[k - 1], polygon[k]);
+	}
+}
+
+auto SoftwareCoreRender::rasterizeTile(const DrawContext& ctx, int tile, size_t chunks) -> size_t
+{
+	const int tileX0 = (tile % ctx.tilesX) * TILE_SIZE;
+	const int tileY0 = (tile / ctx.tilesX) * TILE_SIZE;
+	const int tileX1 = min(tileX0 + TILE_SIZE, ctx.width) - 1;
+	const int tileY1 = min(tileY0 + TILE_SIZE, ctx.height) - 1;
+
+	uint32_t *depth = ctx.depth ? reinterpret_cast<uint32_t*>(ctx.depth->data()) : nullptr;
+	const size_t depthWidth = ctx.depth ? ctx.depth->GetWidth() : 0;
+
+	size_t pixels = 0;
+
+	for (size_t c = 0; c < chunks; c++)
+	{
+		const Chunk& chunk = chunks_[c];
+
+		for (uint index : chunk.bins[tile])
+		{
+			const Triangle& tri = chunk.triangles[index];
+
+			const int x0 = max(tri.minX, tileX0), x1 = min(tri.maxX, tileX1);
+			const int y0 = max(tri.minY, tileY0), y1 = min(tri.maxY, tileY1);
+
+			for (int y = y0; y <= y1; y++)
+			{
+				const float py = float(y) + 0.5f;
+				const float row[3] = {tri.B[0] * py + tri.C[0], tri.B[1] * py + tri.C[1], tri.B[2] * py + tri.C[2]};
+
+				for (int x = x0 & ~3; x <= x1; x += 4)
+				{
+					float e[3][4], z[4];
+					int mask = coverBlock(tri.A, row, tri.topLeft, tri.z, tri.invArea, x, x0, x1, e, z);
+
+					for (int i = 0; mask; i++, mask >>= 1)
+					{
+						if (!(mask & 1))
+							continue;
+
+						const int px = x + i;
+
+						if (depth && ctx.depthTest)
+						{
+							uint32_t& stored = depth[y * depthWidth + px];
+							const uint32_t d = quantizeDepth(z[i]);
+
+							if (!depthPass(ctx.depthFunc, d, stored & DEPTH_MAX))
+								continue;
+
+							stored = (stored & ~DEPTH_MAX) | d;
+						}
+
+						pixels++;
+
+						float out[4][4]; // outputs for targets
+						int outputs = 0;
+
+						switch (ctx.info.kind)
+						{
+							case SOFTWARE_SHADER::PRIMITIVE:
+								memcpy(out[0], &ctx.outputs[0], sizeof(vec4));
+								outputs = 1;
+								break;
+
+							case SOFTWARE_SHADER::ID:
+								outputs = 0; // written as integer below
+								break;
+
+							case SOFTWARE_SHADER::DEFERRED:
+							{
+								memcpy(out[0], &ctx.outputs[0], sizeof(vec4));
+								memcpy(out[1], &ctx.outputs[1], sizeof(vec4));
+
+								// perspective correct interpolation
+								const float l[3] = {e[0][i] * tri.invArea, e[1][i] * tri.invArea, e[2][i] * tri.invArea};
+								const float w = 1.0f / (l[0] * tri.invW[0] + l[1] * tri.invW[1] + l[2] * tri.invW[2]);
+
+								float v[MAX_VARYINGS];
+								for (int j = 0; j < ctx.varyings; j++)
+									v[j] = (l[0] * tri.varyings[0][j] + l[1] * tri.varyings[1][j] + l[2] * tri.varyings[2][j]) * w;
+
+								if (ctx.normals)
+								{
+									const float len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+									const float s = len > 0.0f ? 0.5f / len : 0.0f;
+									out[2][0] = v[0] * s + 0.5f;
+									out[2][1] = v[1] * s + 0.5f;
+									out[2][2] = v[2] * s + 0.5f;
+									out[2][3] = 0.0f;
+								}
+
+								// uv of current position is uv of pixel center
+								const float uvPrevX = v[3] / v[6] * 0.5f + 0.5f;
+								const float uvPrevY = v[4] / v[6] * 0.5f + 0.5f;
+								out[3][0] = (float(px) + 0.5f) / ctx.viewportWidth - uvPrevX;
+								out[3][1] = 1.0f - py / ctx.viewportHeight - uvPrevY;
+								out[3][2] = 0.0f;
+								out[3][3] = 0.0f;
+
+								outputs = 4;
+								break;
+							}
+
+							default: break;
+						}
+
+						for (int t = 0; t < ctx.numTargets; t++)
+						{
+							NullTexture *target = ctx.targets[t];
+							if (!target)
+								continue;
+
+							const TEXTURE_FORMAT format = target->format();
+							uint8 *p = target->data() + (size_t(y) * target->GetWidth() + px) * bytesPerPixel(format);
+
+							if (ctx.info.kind == SOFTWARE_SHADER::ID)
+							{
+								if (t > 0)
+									continue;
+
+								if (format == TEXTURE_FORMAT::R32UI)
+									memcpy(p, &ctx.id, sizeof(uint32_t));
+								else
+								{
+									const float id[4] = {float(ctx.id), 0.0f, 0.0f, 0.0f};
+									writePixel(p, format, id);
+								}
+								continue;
+							}
+
+							if (t >= outputs || (t == 2 && !ctx.normals))
+								continue;
+
+							if (ctx.blendSrc == BLEND_FACTOR::NONE || format == TEXTURE_FORMAT::R32UI)
+							{
+								writePixel(p, format, out[t]);
+								continue;
+							}
+
+							float dst[4], blended[4];
+							readPixel(p, format, dst);
+							for (int k = 0; k < 4; k++)
+								blended[k] = out[t][k] * blendFactor(ctx.blendSrc, out[t], dst, k) + dst[k] * blendFactor(ctx.blendDest, out[t], dst, k);
+							writePixel(p, format, blended);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return pixels;
+}
+
+auto SoftwareCoreRender::Draw(Mesh *mesh, uint instances) -> void
+{
+	NullCoreRender::Draw(mesh, instances);
+
+	if (!state_.shader || !instances)
+		return;
+
+	typedef std::chrono::high_resolution_clock clock;
+	clock::time_point start = clock::now();
+
+	DrawContext ctx{};
+	ctx.shader = static_cast<NullShader*>(state_.shader->GetCoreShader());
+	ctx.mesh = static_cast<NullMesh*>(mesh->GetCoreMesh());
+
+	auto it = shaders_.find(ctx.shader->id());
+	if (it != shaders_.end())
+		ctx.info = it->second;
+
+	NullMesh *nullMesh = static_cast<NullMesh*>(mesh->GetCoreMesh());
+
+	if (ctx.info.kind == SOFTWARE_SHADER::UNKNOWN || nullMesh->GetVertexTopology() != VERTEX_TOPOLOGY::TRIANGLES || state_.fillingMode == FILLING_MODE::WIREFRAME)
+	{
+		rasterStat_.skippedDraws++;
+		return;
+	}
+
+	if (ctx.info.instanced)
+	{
+		StructuredBuffer *buffer = structuredBuffers_[INSTANCE_BUFFER_SLOT];
+		NullStructuredBuffer *instanceBuffer = buffer ? static_cast<NullStructuredBuffer*>(buffer->GetCoreBuffer()) : nullptr;
+
+		if (!instanceBuffer || instanceBuffer->GetSize() < instances * sizeof(InstanceTransformation))
+		{
+			LogWarning("SoftwareCoreRender::Draw(): instance buffer is not bound");
+			rasterStat_.skippedDraws++;
+			return;
+		}
+
+		ctx.instanceTransforms = reinterpret_cast<const InstanceTransformation*>(instanceBuffer->data());
+	}
+	else
+		instances = 1; // instances of not instanced shaders are equal
+
+	ctx.vertexCount = nullMesh->vertexNumber();
+	ctx.trianglesPerInstance = (nullMesh->indexFormat() != MESH_INDEX_FORMAT::NONE ? nullMesh->indexNumber() : ctx.vertexCount) / 3;
+	ctx.normals = ctx.info.kind == SOFTWARE_SHADER::DEFERRED && bool(nullMesh->GetAttributes() & INPUT_ATTRUBUTE::NORMAL);
+	ctx.varyings = ctx.info.kind == SOFTWARE_SHADER::DEFERRED ? 7 : 0;
+
+	switch (ctx.info.kind)
+	{
+		case SOFTWARE_SHADER::DEFERRED:
+			memcpy(&ctx.outputs[0], ctx.shader->parameter(ctx.info.base_color), sizeof(vec4));
+			memcpy(&ctx.outputs[1].x, ctx.shader->parameter(ctx.info.roughness), sizeof(float));
+			memcpy(&ctx.outputs[1].y, ctx.shader->parameter(ctx.info.metalness), sizeof(float));
+			memcpy(&ctx.outputs[1].z, ctx.shader->parameter(ctx.info.reflectivity), sizeof(float));
+			ctx.outputs[1].w = 0.0f;
+			break;
+		case SOFTWARE_SHADER::ID:			memcpy(&ctx.id, ctx.shader->parameter(ctx.info.id), sizeof(uint)); break;
+		case SOFTWARE_SHADER::PRIMITIVE:	memcpy(&ctx.outputs[0], ctx.shader->parameter(ctx.info.main_color), sizeof(vec4)); break;
+		default: break;
+	}
+
+	ctx.viewportWidth = (int)state_.width;
+	ctx.viewportHeight = (int)state_.height;
+	ctx.width = ctx.viewportWidth;
+	ctx.height = ctx.viewportHeight;
+
+	for (int i = 0; i < 8; i++)
+	{
+		ctx.targets[i] = getNullTexture(state_.renderTargets[i]);
+		if (!ctx.targets[i])
+			continue;
+
+		ctx.numTargets = i + 1;
+		ctx.width = min(ctx.width, ctx.targets[i]->GetWidth());
+		ctx.height = min(ctx.height, ctx.targets[i]->GetHeight());
+	}
+
+	ctx.depth = getNullTexture(state_.renderDepth);
+	if (ctx.depth)
+	{
+		ctx.width = min(ctx.width, ctx.depth->GetWidth());
+		ctx.height = min(ctx.height, ctx.depth->GetHeight());
+	}
+
+	if ((!ctx.numTargets && !ctx.depth) || ctx.width <= 0 || ctx.height <= 0 || !ctx.vertexCount || !ctx.trianglesPerInstance)
+		return;
+
+	ctx.depthTest = state_.depthTest != 0;
+	ctx.depthFunc = state_.depthFunc;
+	ctx.depthBias = state_.depthBias / float(DEPTH_MAX);
+	ctx.cullingMode = state_.cullingMode;
+	ctx.blendSrc = state_.blendSrc;
+	ctx.blendDest = state_.blendDest;
+
+	ctx.tilesX = (ctx.width + TILE_SIZE - 1) / TILE_SIZE;
+	ctx.tilesY = (ctx.height + TILE_SIZE - 1) / TILE_SIZE;
+	const int tiles = ctx.tilesX * ctx.tilesY;
+
+	ThreadPool *pool = _core->GetThreadPool();
+
+	// vertices
+	const size_t vertices = size_t(ctx.vertexCount) * instances;
+	if (clipVertices_.size() < vertices)
+		clipVertices_.resize(vertices);
+
+	pool->ParallelFor(vertices, VERTICES_PER_TASK, [&](size_t begin, size_t end)
+	{
+		transformVertices(ctx, begin, end);
+	});
+
+	// triangles
+	const size_t triangles = size_t(ctx.trianglesPerInstance) * instances;
+	const size_t chunks = min<size_t>((triangles + TRIANGLES_PER_CHUNK - 1) / TRIANGLES_PER_CHUNK, MAX_CHUNKS);
+	const size_t trianglesPerChunk = (triangles + chunks - 1) / chunks;
+	rasterStat_.submitted += triangles;
+
+	if (chunks_.size() < chunks)
+		chunks_.resize(chunks);
+
+	pool->ParallelFor(chunks, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+		{
+			Chunk& chunk = chunks_[c];
+			chunk.triangles.clear();
+			chunk.bins.resize(max(chunk.bins.size(), (size_t)tiles));
+			for (int t = 0; t < tiles; t++)
+				chunk.bins[t].clear();
+			chunk.tileMinX = chunk.tileMinY = INT_MAX;
+			chunk.tileMaxX = chunk.tileMaxY = -1;
+
+			setupTriangles(ctx, chunk, c * trianglesPerChunk, min(triangles, (c + 1) * trianglesPerChunk));
+		}
+	});
+
+	// tiles touched by any chunk
+	int tileMinX = INT_MAX, tileMinY = INT_MAX, tileMaxX = -1, tileMaxY = -1;
+	for (size_t c = 0; c < chunks; c++)
+	{
+		rasterStat_.triangles += chunks_[c].triangles.size();
+		tileMinX = min(tileMinX, chunks_[c].tileMinX);
+		tileMinY = min(tileMinY, chunks_[c].tileMinY);
+		tileMaxX = max(tileMaxX, chunks_[c].tileMaxX);
+		tileMaxY = max(tileMaxY, chunks_[c].tileMaxY);
+	}
+
+	if (tileMaxX >= 0)
+	{
+		const int rectWidth = tileMaxX - tileMinX + 1;
+		std::atomic<size_t> pixels{0};
+
+		pool->ParallelFor(size_t(rectWidth) * (tileMaxY - tileMinY + 1), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const int tile = (tileMinY + int(i) / rectWidth) * ctx.tilesX + tileMinX + int(i) % rectWidth;
+				pixels += rasterizeTile(ctx, tile, chunks);
+			}
+		});
+
+		rasterStat_.pixels += pixels;
+	}
+
+	rasterStat_.ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+}
+
+void BenchmarkSoftwareRaster(const Engine::CameraData& camera, uint frames)
+{
+	if (strcmp(CORE_RENDER->GetName(), "softwarecorerender"))
+	{
+		LogWarning("BenchmarkSoftwareRaster(): engine must be initialized with INIT_FLAGS::SOFTWARE_RENDER");
+		return;
+	}
+
+	if (!frames)
+		return;
+
+	SoftwareCoreRender *render = static_cast<SoftwareCoreRender*>(CORE_RENDER);
+
+	uint w, h;
+	render->GetViewport(&w, &h);
+
+	const mat4 VP = camera.ProjMat * camera.ViewMat;
+
+	// targets of G-buffer pass of RenderPathRealtime
+	Texture *gbuffer[4] =
+	{
+		RENDER->GetRenderTexture(w, h, TEXTURE_FORMAT::RGBA8),
+		RENDER->GetRenderTexture(w, h, TEXTURE_FORMAT::RGBA8),
+		RENDER->GetRenderTexture(w, h, TEXTURE_FORMAT::RGBA32F),
+		RENDER->GetRenderTexture(w, h, TEXTURE_FORMAT::RG16F)
+	};
+	Texture *id = RENDER->GetRenderTexture(w, h, TEXTURE_FORMAT::R32UI);
+	Texture *depth = RENDER->GetRenderTexture(w, h, TEXTURE_FORMAT::D24S8);
+
+	typedef std::chrono::high_resolution_clock clock;
+
+	struct Result
+	{
+		double ms{0.0};
+		size_t submitted{0}; // triangles
+		size_t rasterized{0};
+		size_t pixels{0};
+	};
+
+	auto pass = [&](PASS p, int targets, Texture **texs, Result& r)
+	{
+		_core->ManualUpdate();
+
+		render->PushStates();
+		render->SetRenderTextures(targets, texs, depth);
+		render->Clear();
+		render->SetDepthTest(1);
+
+		clock::time_point t = clock::now();
+		RENDER->DrawMeshes(p, VP);
+		r.ms += std::chrono::duration<double, std::milli>(clock::now() - t).count();
+
+		render->PopStates();
+
+		// statistic is reset by next ManualUpdate()
+		r.submitted += render->GetRasterStat().submitted;
+		r.rasterized += render->GetRasterStat().triangles;
+		r.pixels += render->GetRasterStat().pixels;
+	};
+
+	// first frame creates shaders
+	Result warmUp;
+	pass(PASS::DEFERRED, 4, gbuffer, warmUp);
+	pass(PASS::ID, 1, &id, warmUp);
+
+	Result deferred, ids;
+	for (uint i = 0; i < frames; i++)
+	{
+		pass(PASS::DEFERRED, 4, gbuffer, deferred);
+		pass(PASS::ID, 1, &id, ids);
+	}
+
+	for (Texture *tex : gbuffer)
+		RENDER->ReleaseRenderTexture(tex);
+	RENDER->ReleaseRenderTexture(id);
+	RENDER->ReleaseRenderTexture(depth);
+
+	Log("BenchmarkSoftwareRaster(): %u frames %ux%u, %u threads", frames, w, h, _core->GetThreadPool()->GetWorkers() + 1);
+
+	auto print = [frames](const char *name, const Result& r)
+	{
+		Log("  %s: %.3f ms, %u triangles (%u rasterized), %.1f Mpixels, %.2f Mtris/s", name, r.ms / frames,
+			(uint)(r.submitted / frames), (uint)(r.rasterized / frames), double(r.pixels) / frames * 1e-6, r.ms > 0.0 ? r.submitted / (r.ms * 1e3) : 0.0);
+	};
+
+	print("G-buffer", deferred);
+	print("ID", ids);
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "corerender/null/nullcorerender.h"
+#include <unordered_map>
+
+//
+// CPU backend for render nodes without GPU. Resources, state tracking, statistics and recording
+// are inherited from NullCoreRender, draws are rasterized into system memory of render targets.
+//
+// Draw(): vertices are transformed in parallel, then triangles are clipped by near plane, set up and
+// binned to tiles by chunks in parallel, then tiles are rasterized in parallel.
+// Tile walks chunks in submission order, so result doesn't depend on number of threads.
+// Edge functions and depth test are evaluated for 4 pixels at once (SSE2).
+// Depth buffer has D24S8 layout: 24-bit unorm depth in low bits, stencil in high bits is kept.
+//
+// HLSL is not executed, standard shaders are recognized by text and replaced by C++ equivalents:
+// model/deferred.hlsl (without texture maps), model/id.hlsl, primitive.hlsl and primitive_id.hlsl.
+// Draws with other shaders, lines and wireframe are counted as skipped.
+//
+enum class SOFTWARE_SHADER : uint8
+{
+	UNKNOWN,
+	DEFERRED,	// base_color, (roughness, metalness, reflectivity), packed normal, velocity
+	ID,			// id
+	PRIMITIVE,	// main_color
+};
+
+class SoftwareCoreRender final : public NullCoreRender
+{
+public:
+	struct RasterStat
+	{
+		size_t submitted{0}; // triangles of drawn instances
+		size_t triangles{0}; // after culling and clipping
+		size_t pixels{0}; // passed depth test
+		int skippedDraws{0};
+		double ms{0.0}; // in Draw()
+
+		void clear() { *this = RasterStat(); }
+	};
+
+	static constexpr int TILE_SIZE = 64;
+	static constexpr int MAX_VARYINGS = 8;
+
+private:
+	struct ShaderInfo
+	{
+		SOFTWARE_SHADER kind{SOFTWARE_SHADER::UNKNOWN};
+		bool instanced{false};
+		int MVP{-1}, MVP_prev{-1}, NM{-1}; // parameter handles
+		int id{-1}, main_color{-1}, base_color{-1};
+		int roughness{-1}, metalness{-1}, reflectivity{-1};
+	};
+
+	struct ClipVertex
+	{
+		vec4 pos;
+		float varyings[MAX_VARYINGS];
+	};
+
+	struct Triangle
+	{
+		float A[3], B[3], C[3]; // edge functions A * x + B * y + C, positive inside
+		uint topLeft; // bit per edge, pixels on these edges are inside
+		float invArea;
+		float z[3];
+		float invW[3];
+		float varyings[3][MAX_VARYINGS]; // divided by w
+		int minX, minY, maxX, maxY;
+	};
+
+	struct Chunk
+	{
+		vector<Triangle> triangles;
+		vector<vector<uint>> bins; // indices of triangles for each tile
+		int tileMinX, tileMinY, tileMaxX, tileMaxY; // touched tiles
+	};
+
+	struct DrawContext;
+
+	std::unordered_map<uint, ShaderInfo> shaders_; // by shader id
+	StructuredBuffer *structuredBuffers_[16]{};
+
+	vector<ClipVertex> clipVertices_;
+	vector<Chunk> chunks_;
+
+	RasterStat rasterStat_;
+	RasterStat oldRasterStat_;
+
+	void transformVertices(const DrawContext& ctx, size_t begin, size_t end);
+	void setupTriangles(const DrawContext& ctx, Chunk& chunk, size_t begin, size_t end);
+	void emitTriangle(const DrawContext& ctx, Chunk& chunk, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2);
+	auto rasterizeTile(const DrawContext& ctx, int tile, size_t chunks) -> size_t; // returns shaded pixels
+
+public:
+	auto Init(const WindowHandle* handle, int MSAASamples, int VSyncOn) -> bool override;
+	auto Free() -> void override;
+
+	auto CreateShader(const char *vertText, const char *fragText, const char *geomText, ERROR_COMPILE_SHADER &err) -> ICoreShader* override;
+
+	auto Clear() -> void override;
+	auto BindStructuredBuffer(int unit, StructuredBuffer *buffer) -> void override;
+	auto Draw(Mesh *mesh, uint instances) -> void override;
+
+	auto GetName() -> const char * override { return "softwarecorerender"; }
+
+	void writeLines(TextArena& out) override;
+	void Update() override;
+
+	auto GetRasterStat() const -> const RasterStat& { return rasterStat_; } // of current frame
+	auto GetLastFrameRasterStat() const -> const RasterStat& { return oldRasterStat_; }
+
+	static auto RecognizeShader(const char *vertText, const char *fragText, bool& instanced) -> SOFTWARE_SHADER;
+};
+
+// Rasterizes G-buffer and ID passes of current scene with SoftwareCoreRender, logs time and Mtris/s
+void BenchmarkSoftwareRaster(const Engine::CameraData& camera, uint frames = 20);
@@ -0,0 +1,268 @@
+#include "pch.h"
+#include "cpu_profiler.h"
+#include "core.h"
+#include "filesystem.h"
+#include <atomic>
+#include <chrono>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define EVENTS_PER_THREAD (1 << 16) // power of two
+
+struct Event
+{
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+	uint32_t frame;
+	uint32_t depth;
+};
+
+struct ThreadBuffer
+{
+	std::unique_ptr<Event[]> events{new Event[EVENTS_PER_THREAD]};
+	std::atomic<uint64_t> count{0}; // written by owner thread only, published with release
+	uint32_t depth{0};
+	uint32_t tid{0};
+	std::string name;
+	std::mutex mtx; // name only
+};
+
+struct ThreadSlot
+{
+	ThreadBuffer *buffer{nullptr};
+	uint32_t generation{0};
+};
+
+// Buffers are not deleted by Free(): thread that is still running can write its buffer.
+// They are reused by threads of next Init()
+static std::mutex buffersMtx;
+static vector<std::unique_ptr<ThreadBuffer>> buffers;
+static size_t usedBuffers; // by threads of current Init()
+static std::atomic<uint32_t> generation{1}; // slots of previous Init() are not used
+static thread_local ThreadSlot slot;
+
+static std::atomic<bool> enabled{false};
+static std::atomic<uint32_t> frame{0};
+static uint historyFrames_ = 120;
+static uint64_t frameBegin;
+static const char *frameName = "Frame";
+
+static uint64_t initTicks;
+static std::chrono::steady_clock::time_point initTime;
+
+static uint64_t ticks()
+{
+#ifdef _MSC_VER
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+static ThreadBuffer *threadBuffer()
+{
+	uint32_t g = generation.load(std::memory_order_acquire);
+	if (slot.generation == g)
+		return slot.buffer;
+
+	std::lock_guard<std::mutex> lock(buffersMtx);
+
+	if (usedBuffers == buffers.size())
+		buffers.emplace_back(new ThreadBuffer);
+
+	ThreadBuffer *b = buffers[usedBuffers].get();
+	{
+		std::lock_guard<std::mutex> lockBuffer(b->mtx);
+		b->name = "Thread " + std::to_string(usedBuffers);
+	}
+	b->count.store(0, std::memory_order_release);
+	b->depth = 0;
+	b->tid = (uint32_t)usedBuffers;
+	usedBuffers++;
+
+	slot.buffer = b;
+	slot.generation = g;
+
+	return b;
+}
+
+static void record(ThreadBuffer *b, const char *name, uint64_t begin, uint64_t end, uint32_t depth)
+{
+	uint64_t c = b->count.load(std::memory_order_relaxed);
+	b->events[c & (EVENTS_PER_THREAD - 1)] = {name, begin, end, frame.load(std::memory_order_relaxed), depth};
+	b->count.store(c + 1, std::memory_order_release);
+}
+
+CpuProfiler::Zone::Zone(const char *name_) : name(name_), begin(0)
+{
+	if (!enabled.load(std::memory_order_relaxed))
+		return;
+
+	threadBuffer()->depth++;
+	begin = ticks();
+}
+
+CpuProfiler::Zone::~Zone()
+{
+	if (!begin)
+		return;
+
+	uint64_t end = ticks();
+
+	ThreadBuffer *b = threadBuffer();
+	if (b->depth) // buffer can be new if profiler was reinited inside zone
+		b->depth--;
+	record(b, name, begin, end, b->depth);
+}
+
+void CpuProfiler::Init(uint historyFrames)
+{
+	historyFrames_ = historyFrames;
+	initTicks = ticks();
+	initTime = std::chrono::steady_clock::now();
+	frameBegin = initTicks;
+
+	SetThreadName("Main");
+}
+
+void CpuProfiler::Free()
+{
+	enabled = false;
+
+	std::lock_guard<std::mutex> lock(buffersMtx);
+	usedBuffers = 0;
+	generation++;
+}
+
+void CpuProfiler::SetEnabled(bool value)
+{
+	if (value && !enabled)
+		frameBegin = ticks();
+
+	enabled = value;
+}
+
+auto CpuProfiler::IsEnabled() -> bool
+{
+	return enabled;
+}
+
+void CpuProfiler::SetThreadName(const char *name)
+{
+	ThreadBuffer *b = threadBuffer();
+
+	std::lock_guard<std::mutex> lock(b->mtx);
+	b->name = name;
+}
+
+void CpuProfiler::BeginFrame()
+{
+	uint64_t t = ticks();
+
+	if (enabled)
+		record(threadBuffer(), frameName, frameBegin, t, 0);
+
+	frame++;
+	frameBegin = t;
+}
+
+static void appendEscaped(std::string& out, const char *str)
+{
+	for (const char *c = str; *c; c++)
+	{
+		if ((unsigned char)*c < 0x20)
+		{
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)*c);
+			out += buf;
+			continue;
+		}
+
+		if (*c == '"' || *c == '\\')
+			out += '\\';
+		out += *c;
+	}
+}
+
+auto CpuProfiler::ExportChromeTrace(const char *path) -> bool
+{
+	// ticks to microseconds
+	double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - initTime).count();
+	uint64_t t = ticks();
+	double usPerTick = t > initTicks ? us / (double)(t - initTicks) : 0.0;
+
+	// current frame is not finished and counts as one of history frames
+	uint32_t current = frame.load();
+	uint32_t minFrame = current >= historyFrames_ ? current - historyFrames_ + 1 : 0;
+
+	std::string out = "{\"traceEvents\":[\n";
+	char buf[256];
+	bool first = true;
+	size_t numEvents = 0;
+	vector<Event> events;
+
+	{
+		std::lock_guard<std::mutex> lockBuffers(buffersMtx);
+
+		for (size_t i = 0; i < usedBuffers; i++)
+		{
+			ThreadBuffer *b = buffers[i].get();
+
+			out += first ? "" : ",\n";
+			first = false;
+
+			snprintf(buf, sizeof(buf), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"", b->tid);
+			out += buf;
+			{
+				std::lock_guard<std::mutex> lock(b->mtx);
+				appendEscaped(out, b->name.c_str());
+			}
+			out += "\"}}";
+
+			// Owner thread keeps writing while events are copied, so oldest ones can be overwritten.
+			// They are dropped by count read after the copy, as in seqlock. Slot of unpublished event
+			// that can be in progress is dropped too.
+			uint64_t end = b->count.load(std::memory_order_acquire);
+			uint64_t start = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+
+			events.resize(end - start);
+			for (uint64_t i = start; i < end; i++)
+				events[i - start] = b->events[i & (EVENTS_PER_THREAD - 1)];
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t after = b->count.load(std::memory_order_relaxed);
+			uint64_t valid = after + 1 > EVENTS_PER_THREAD ? after + 1 - EVENTS_PER_THREAD : 0;
+
+			for (uint64_t i = max(start, valid); i < end; i++)
+			{
+				const Event& e = events[i - start];
+				if (e.frame < minFrame)
+					continue;
+
+				out += ",\n{\"name\":\"";
+				appendEscaped(out, e.name);
+				snprintf(buf, sizeof(buf), "\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"frame\":%u,\"depth\":%u}}",
+					(double)(int64_t)(e.begin - initTicks) * usPerTick, (double)(e.end - e.begin) * usPerTick, b->tid, e.frame, e.depth);
+				out += buf;
+				numEvents++;
+			}
+		}
+	}
+
+	out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	File f = FS->OpenFile(path, FILE_OPEN_MODE::WRITE | FILE_OPEN_MODE::BINARY);
+	f.WriteStr(out.c_str());
+
+	if (!f.Flush())
+	{
+		LogCritical("CpuProfiler::ExportChromeTrace(): can't write '%s'", path);
+		return false;
+	}
+
+	Log("CpuProfiler::ExportChromeTrace(): %u zones of %u frames saved to %s", (uint)numEvents, current - minFrame + 1, path);
+
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "common.h"
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) CpuProfiler::Zone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+
+//
+// Scoped CPU zones.
+// Every thread writes finished zones to its own ring buffer and publishes them with an atomic counter, so recording takes no locks.
+// Timestamps are rdtsc ticks, converted to microseconds on export.
+// Zones of last N frames are exported as Chrome trace JSON (chrome://tracing, Perfetto).
+//
+class CpuProfiler
+{
+public:
+	class Zone
+	{
+		const char *name;
+		uint64_t begin;
+
+	public:
+		Zone(const char *name_);
+		~Zone();
+	};
+
+	static void Init(uint historyFrames = 120);
+	static void Free(); // recorded zones are dropped, buffers are kept for threads that are still running
+
+	static void SetEnabled(bool value);
+	static auto IsEnabled() -> bool;
+	static void SetThreadName(const char *name); // name of calling thread in trace
+
+	static void BeginFrame(); // main thread, closes zone of previous frame
+	static auto ExportChromeTrace(const char *path) -> bool; // false if file can't be written
+};
@@ -1,6 +1,429 @@
 #include "pch.h"
 #include "crc.h"
+#include "core.h"
+#include <chrono>
 
-uint32_t crc32::table[256];
-uint32_t crc32::initial;
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define CRC_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define CRC_TARGET_PCLMUL
+	#else
+		#include <cpuid.h>
+		#define CRC_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+	#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	#define CRC_ARM64
+	#include <arm_acle.h>
+	#ifdef __GNUC__
+		#include <sys/auxv.h>
+		#include <asm/hwcap.h>
+	#endif
+#endif
 
+#define CRC_POLYNOMIAL 0xEDB88320u
+
+struct Crc32Tables
+{
+	uint32_t t[8][256];
+
+	Crc32Tables()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int j = 0; j < 8; j++)
+				c = (c & 1) ? CRC_POLYNOMIAL ^ (c >> 1) : c >> 1;
+			t[0][i] = c;
+		}
+
+		for (uint32_t i = 0; i < 256; i++)
+			for (int k = 1; k < 8; k++)
+				t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+	}
+};
+
+static const Crc32Tables& tables()
+{
+	static const Crc32Tables t; // initialization is thread-safe
+	return t;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+uint32_t crc32::updateBytewise(const void *buf, size_t len, uint32_t crc)
+{
+	const uint32_t *t = tables().t[0];
+	const uint8_t *u = static_cast<const uint8_t*>(buf);
+
+	uint32_t c = ~crc;
+	for (size_t i = 0; i < len; ++i)
+		c = t[(c ^ u[i]) & 0xFF] ^ (c >> 8);
+
+	return ~c;
+}
+
+// Little endian only
+uint32_t crc32::updateSlicing8(const void *buf, size_t len, uint32_t crc)
+{
+	const Crc32Tables& tb = tables();
+	const uint8_t *u = static_cast<const uint8_t*>(buf);
+
+	uint32_t c = ~crc;
+
+	for (; len >= 8; len -= 8, u += 8)
+	{
+		uint32_t one = read32(u) ^ c;
+		uint32_t two = read32(u + 4);
+
+		c = tb.t[7][one & 0xFF] ^
+			tb.t[6][(one >> 8) & 0xFF] ^
+			tb.t[5][(one >> 16) & 0xFF] ^
+			tb.t[4][one >> 24] ^
+			tb.t[3][two & 0xFF] ^
+			tb.t[2][(two >> 8) & 0xFF] ^
+			tb.t[1][(two >> 16) & 0xFF] ^
+			tb.t[0][two >> 24];
+	}
+
+	for (; len; len--, u++)
+		c = tb.t[0][(c ^ *u) & 0xFF] ^ (c >> 8);
+
+	return ~c;
+}
+
+#ifdef CRC_X86
+
+// Folding with carry-less multiplication.
+// Intel "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+// len >= 64 and multiple of 16, c is not inverted
+CRC_TARGET_PCLMUL static uint32_t crc32Pclmul(const uint8_t *buf, size_t len, uint32_t c)
+{
+	alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+	alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+	alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+	alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+	x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+	x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+	x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+	x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)c));
+
+	x0 = _mm_load_si128((const __m128i*)k1k2);
+
+	buf += 64;
+	len -= 64;
+
+	// fold 4 blocks in parallel
+	while (len >= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+		y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+		y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+		y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+		y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+		buf += 64;
+		len -= 64;
+	}
+
+	// fold into 128 bits
+	x0 = _mm_load_si128((const __m128i*)k3k4);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// fold remaining blocks of 16
+	while (len >= 16)
+	{
+		x2 = _mm_loadu_si128((const __m128i*)buf);
+
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+		buf += 16;
+		len -= 16;
+	}
+
+	// fold 128 bits to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+
+	x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x0 = _mm_load_si128((const __m128i*)poly);
+
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static bool detectHardware()
+{
+	// PCLMULQDQ and SSE4.1
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	unsigned ecx = (unsigned)info[2];
+#else
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+#endif
+	return (ecx & (1u << 1)) && (ecx & (1u << 19));
+}
+
+uint32_t crc32::updateHardware(const void *buf, size_t len, uint32_t crc)
+{
+	const uint8_t *u = static_cast<const uint8_t*>(buf);
+
+	if (len < 64)
+		return updateSlicing8(u, len, crc);
+
+	size_t blocks = len & ~size_t(15);
+	crc = ~crc32Pclmul(u, blocks, ~crc);
+
+	return updateSlicing8(u + blocks, len - blocks, crc);
+}
+
+#elif defined(CRC_ARM64)
+
+static bool detectHardware()
+{
+#ifdef _MSC_VER
+	return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != 0;
+#else
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+}
+
+uint32_t crc32::updateHardware(const void *buf, size_t len, uint32_t crc)
+{
+	const uint8_t *u = static_cast<const uint8_t*>(buf);
+
+	uint32_t c = ~crc;
+
+	for (; len >= 8; len -= 8, u += 8)
+		c = __crc32d(c, read64(u));
+
+	for (; len; len--, u++)
+		c = __crc32b(c, *u);
+
+	return ~c;
+}
+
+#else
+
+static bool detectHardware()
+{
+	return false;
+}
+
+uint32_t crc32::updateHardware(const void *buf, size_t len, uint32_t crc)
+{
+	return updateSlicing8(buf, len, crc);
+}
+
+#endif
+
+bool crc32::hardwareSupported()
+{
+	static const bool supported = detectHardware();
+	return supported;
+}
+
+uint32_t crc32::update(const void *buf, size_t len, uint32_t crc)
+{
+	return hardwareSupported() ? updateHardware(buf, len, crc) : updateSlicing8(buf, len, crc);
+}
+
+// xxHash64
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME64_2;
+	acc = rotl64(acc, 31);
+	return acc * PRIME64_1;
+}
+
+static inline uint64_t mergeRound64(uint64_t acc, uint64_t val)
+{
+	acc ^= round64(0, val);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t hash64(const void *buf, size_t len, uint64_t seed)
+{
+	const uint8_t *p = static_cast<const uint8_t*>(buf);
+	const uint8_t *end = p + len;
+	uint64_t h;
+
+	if (len >= 32)
+	{
+		const uint8_t *limit = end - 32;
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME64_1;
+
+		do
+		{
+			v1 = round64(v1, read64(p));
+			v2 = round64(v2, read64(p + 8));
+			v3 = round64(v3, read64(p + 16));
+			v4 = round64(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = mergeRound64(h, v1);
+		h = mergeRound64(h, v2);
+		h = mergeRound64(h, v3);
+		h = mergeRound64(h, v4);
+	}
+	else
+		h = seed + PRIME64_5;
+
+	h += (uint64_t)len;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= round64(0, read64(p));
+		h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+
+	if (p + 4 <= end)
+	{
+		h ^= (uint64_t)read32(p) * PRIME64_1;
+		h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	for (; p < end; p++)
+	{
+		h ^= (*p) * PRIME64_5;
+		h = rotl64(h, 11) * PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+void BenchmarkHashing(size_t bytes)
+{
+	typedef std::chrono::high_resolution_clock clock;
+
+	vector<uint8_t> data(bytes);
+	uint32_t x = 0x12345678u;
+	for (size_t i = 0; i < bytes; i++)
+	{
+		x = x * 1664525u + 1013904223u;
+		data[i] = (uint8_t)(x >> 24);
+	}
+
+	// -1 to test unaligned tail
+	size_t len = bytes - 1;
+
+	auto gbs = [len](clock::time_point t)
+	{
+		double sec = std::chrono::duration<double>(clock::now() - t).count();
+		return (double)len / sec / 1e9;
+	};
+
+	clock::time_point t = clock::now();
+	uint32_t bytewise = crc32::updateBytewise(data.data(), len);
+	double bytewiseGBs = gbs(t);
+
+	t = clock::now();
+	uint32_t slicing8 = crc32::updateSlicing8(data.data(), len);
+	double slicing8GBs = gbs(t);
+
+	Log("BenchmarkHashing(): %u MB", (uint)(bytes >> 20));
+	Log("  crc32 bytewise:     %.2f GB/s", bytewiseGBs);
+	Log("  crc32 slicing-by-8: %.2f GB/s%s", slicing8GBs, slicing8 == bytewise ? "" : " MISMATCH");
+
+	if (crc32::hardwareSupported())
+	{
+		t = clock::now();
+		uint32_t hw = crc32::updateHardware(data.data(), len);
+		double hwGBs = gbs(t);
+
+		Log("  crc32 hardware:     %.2f GB/s%s", hwGBs, hw == bytewise ? "" : " MISMATCH");
+	}
+	else
+		Log("  crc32 hardware:     not supported");
+
+	t = clock::now();
+	volatile uint64_t h = hash64(data.data(), len);
+	(void)h;
+	Log("  hash64:             %.2f GB/s", gbs(t));
+}
@@ -1,40 +1,24 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
+//
+// Stateless hashing, all functions are thread-safe.
+//
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320), same values as zlib crc32().
+// Pass result of previous call as crc to continue checksum of split data.
 struct crc32
 {
-	static uint32_t table[256];
-	static uint32_t initial;
+	static uint32_t update(const void *buf, size_t len, uint32_t crc = 0); // fastest path supported by CPU
+	static uint32_t updateBytewise(const void *buf, size_t len, uint32_t crc = 0);
+	static uint32_t updateSlicing8(const void *buf, size_t len, uint32_t crc = 0);
+	static uint32_t updateHardware(const void *buf, size_t len, uint32_t crc = 0); // PCLMULQDQ or ARMv8 CRC32, only if hardwareSupported()
+	static bool hardwareSupported();
+};
 
-	crc32()
-	{
-		uint32_t polynomial = 0xEDB88320;
-		for (uint32_t i = 0; i < 256; i++)
-		{
-			uint32_t c = i;
-			for (size_t j = 0; j < 8; j++)
-			{
-				if (c & 1) {
-					c = polynomial ^ (c >> 1);
-				}
-				else {
-					c >>= 1;
-				}
-			}
-			table[i] = c;
-		}
-	}
+// Fast non-cryptographic 64-bit hash for cache keys (xxHash64)
+uint64_t hash64(const void *buf, size_t len, uint64_t seed = 0);
 
-	static uint32_t update(const void* buf, size_t len)
-	{
-		uint32_t c = 0 ^ 0xFFFFFFFF;
-		const uint8_t* u = static_cast<const uint8_t*>(buf);
-		for (size_t i = 0; i < len; ++i)
-		{
-			c = table[(c ^ u[i]) & 0xFF] ^ (c >> 8);
-		}
-		initial = c ^ 0xFFFFFFFF;
-		return initial;
-	}
-};
+void BenchmarkHashing(size_t bytes = 64 * 1024 * 1024);
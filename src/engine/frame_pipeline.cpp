@@ -0,0 +1,76 @@
+#include "pch.h"
+#include "frame_pipeline.h"
+#include "cpu_profiler.h"
+#include <chrono>
+
+void FramePipeline::Init()
+{
+	quit = false;
+	thread = std::thread(&FramePipeline::loop, this);
+}
+
+void FramePipeline::Free()
+{
+	if (!thread.joinable())
+		return;
+
+	Wait();
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		quit = true;
+	}
+	cv.notify_all();
+
+	thread.join();
+}
+
+void FramePipeline::loop()
+{
+	CpuProfiler::SetThreadName("Frame pipeline");
+
+	std::unique_lock<std::mutex> lock(mtx);
+
+	while (true)
+	{
+		cv.wait(lock, [this]() { return quit || busy; });
+
+		if (quit)
+			return;
+
+		std::function<void()> fn = std::move(stage);
+		lock.unlock();
+
+		auto t = std::chrono::steady_clock::now();
+		fn();
+		float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+
+		lock.lock();
+		stageMs = ms;
+		busy = false;
+		cv.notify_all();
+	}
+}
+
+void FramePipeline::Kick(std::function<void()>&& fn)
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		assert(!busy);
+		stage = std::move(fn);
+		busy = true;
+	}
+	cv.notify_all();
+}
+
+void FramePipeline::Wait()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock, [this]() { return !busy; });
+}
+
+auto FramePipeline::IsBusy() -> bool
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return busy;
+}
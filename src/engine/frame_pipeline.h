@@ -0,0 +1,32 @@
+#pragma once
+#include "common.h"
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+
+//
+// Thread for the first stage of pipelined frame: simulation and extraction of render scene.
+// Main thread kicks stage of frame N + 1, renders frame N and waits the stage before next frame.
+// Not a pool job: stage takes the whole frame and would hold a worker that render jobs need.
+//
+class FramePipeline
+{
+	std::thread thread;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::function<void()> stage;
+	bool busy{false};
+	bool quit{false};
+	std::atomic<float> stageMs{0.0f};
+
+	void loop();
+
+public:
+	void Init();
+	void Free();
+
+	void Kick(std::function<void()>&& fn); // previous stage must be finished
+	void Wait(); // until kicked stage is finished
+	auto IsBusy() -> bool;
+	auto GetStageMs() const -> float { return stageMs; } // of last finished stage
+};
@@ -4,6 +4,7 @@
 #include "core.h"
 #include "input.h"
 #include "yaml.inl"
+#include "scene_file.h"
 
 #define MOVE_SPEED 30.f
 #define ROTATE_SPEED 0.2f
@@ -94,6 +95,24 @@ void Camera::LoadYAML(void *yaml)
 	if (n["fovAngle"]) fovAngle_ = n["fovAngle"].as<float>();
 }
 
+void Camera::SaveBinary(SceneFileObject& obj, SceneWriter& writer)
+{
+	GameObject::SaveBinary(obj, writer);
+
+	obj.params[0] = zNear_;
+	obj.params[1] = zFar_;
+	obj.params[2] = fovAngle_;
+}
+
+void Camera::LoadBinary(const SceneFileObject& obj)
+{
+	GameObject::LoadBinary(obj);
+
+	zNear_ = obj.params[0];
+	zFar_ = obj.params[1];
+	fovAngle_ = obj.params[2];
+}
+
 void Camera::Copy(GameObject * original)
 {
 	GameObject::Copy(original);
@@ -2,9 +2,11 @@
 #include "core.h"
 #include "console.h"
 #include "gameobject.h"
+#include "transform_system.h"
+#include "object_registry.h"
+#include "scene_file.h"
 #include "yaml.inl"
 
-static RandomInstance<GameObject> rand_;
 
 static const char *names[] = {"GameObject", "Model", "Light", "Camera"};
 
@@ -29,7 +31,8 @@ OBJECT_TYPE getTypeByName(const std::string& name)
 
 GameObject::GameObject()
 {
-	id_ = rand_.getRandomInt();
+	handle_ = ObjectRegistry::Add(this);
+	transform_ = TransformSystem::Allocate(this);
 	//Log("GameObject() %i", id_);
 }
 
@@ -38,23 +41,15 @@ void GameObject::Copy(GameObject * original)
 	//Log("GameObject.Copy()");
 	enabled_ = original->enabled_;
 	name_ = original->name_;
-	pos_ = original->pos_;
-	rot_ = original->rot_;
-	scale_ = original->scale_;
-	localTransform_ = original->localTransform_;
-	worldPos_ = original->worldPos_;
-	worldRot_ = original->worldRot_;
-	worldScale_ = original->worldScale_;
-	worldTransform_ = original->worldTransform_;
 	parent_ = original->parent_;
+	TransformSystem::SetParent(transform_, parent_ ? parent_->transform_ : -1);
+	TransformSystem::SetLocalMatrix(transform_, TransformSystem::GetLocalMatrix(original->transform_));
 
 	// TODO: childs
 }
 
 void GameObject::Update(float dt)
 {
-	worldTransformPrev_ = worldTransform_;
-
 	for(int i = 0; i < childs_.size(); i++)
 		childs_[i]->Update(dt);
 }
@@ -67,7 +62,7 @@ void GameObject::SaveYAML(void *yaml)
 	n << YAML::Key << "id" << YAML::Value << id_;
 	n << YAML::Key << "enabled" << YAML::Value << enabled_;
 	n << YAML::Key << "type" << YAML::Value << getNameByType(type_);
-	n << YAML::Key << "worldTransform" << YAML::Value << worldTransform_;
+	n << YAML::Key << "worldTransform" << YAML::Value << GetWorldTransform();
 }
 
 void GameObject::LoadYAML(void * yaml)
@@ -75,7 +70,7 @@ void GameObject::LoadYAML(void * yaml)
 	YAML::Node *_n = static_cast<YAML::Node*>(yaml);
 	YAML::Node& n = *_n;
 
-	id_ = n["id"].as<int>();
+	SetId(n["id"].as<int>());
 	enabled_ = n["enabled"].as<bool>();
 
 	YAML::Node wt = n["worldTransform"];
@@ -84,135 +79,156 @@ void GameObject::LoadYAML(void * yaml)
 	SetWorldTransform(transform);
 }
 
+void GameObject::SaveBinary(SceneFileObject& obj, SceneWriter& writer)
+{
+	obj.id = id_;
+	obj.type = (uint8_t)type_;
+	obj.enabled = enabled_;
+	obj.childs = (uint32_t)childs_.size();
+	obj.mesh = -1;
+	obj.material = -1;
+}
+
+void GameObject::LoadBinary(const SceneFileObject& obj)
+{
+	SetId(obj.id);
+	enabled_ = obj.enabled != 0;
+}
+
 GameObject::~GameObject()
 {
 	for(int i = 0; i < childs_.size(); i++)
 		delete childs_[i];
 
+	TransformSystem::Release(transform_);
+	ObjectRegistry::Remove(handle_);
+
 	//Log("destory ~GameObject() %i", id_);
 }
 
+auto DLLEXPORT GameObject::SetId(int id) -> void
+{
+	if (ObjectRegistry::SetId(handle_, id))
+		id_ = id;
+}
+
 auto DLLEXPORT GameObject::SetLocalPosition(vec3 pos) -> void
 {
-	pos_ = pos;
-	compositeTransform(localTransform_, pos_, rot_, scale_);
-	SetLocalTransform(localTransform_);
+	TransformSystem::SetLocal(transform_, pos, GetLocalRotation(), GetLocalScale());
 }
 
 auto DLLEXPORT GameObject::GetLocalPosition() -> vec3
 {
-	return pos_;
+	return TransformSystem::GetLocalPosition(transform_);
 }
 
 auto DLLEXPORT GameObject::SetLocalRotation(quat rot) -> void
 {
-	rot_ = rot;
-	compositeTransform(localTransform_, pos_, rot_, scale_);
-	SetLocalTransform(localTransform_);
+	TransformSystem::SetLocal(transform_, GetLocalPosition(), rot, GetLocalScale());
 }
 
 auto DLLEXPORT GameObject::GetLocalRotation() -> quat
 {
-	return rot_;
+	return TransformSystem::GetLocalRotation(transform_);
 }
 
 auto DLLEXPORT GameObject::SetLocalScale(vec3 scale) -> void
 {
-	scale_ = scale;
-	compositeTransform(localTransform_, pos_, rot_, scale_);
-	SetLocalTransform(localTransform_);
+	TransformSystem::SetLocal(transform_, GetLocalPosition(), GetLocalRotation(), scale);
 }
 
 auto DLLEXPORT GameObject::GetLocalScale() -> vec3
 {
-	return scale_;
+	return TransformSystem::GetLocalScale(transform_);
 }
 
 auto DLLEXPORT GameObject::SetLocalTransform(const mat4& m) -> void
 {
-	localTransform_ = m;
-	decompositeTransform(localTransform_, pos_, rot_, scale_);
-
-	if (parent_)
-		worldTransform_ = parent_->GetWorldTransform() * localTransform_;
-	else
-		worldTransform_ = localTransform_;
-	decompositeTransform(worldTransform_, worldPos_, worldRot_, worldScale_);
-	
-	for(int i = 0; i < childs_.size(); i++) // update childs
-		childs_[i]->SetLocalTransform(childs_[i]->localTransform_);
+	TransformSystem::SetLocalMatrix(transform_, m);
 }
 
 auto DLLEXPORT GameObject::GetLocalTransform() -> mat4
 {
-	return localTransform_;
+	return TransformSystem::GetLocalMatrix(transform_);
 }
 
 auto DLLEXPORT GameObject::SetWorldPosition(vec3 pos) -> void
 {
-	worldPos_ = pos;
-	compositeTransform(worldTransform_, worldPos_, worldRot_, worldScale_);
-	SetWorldTransform(worldTransform_);
+	vec3 t, s;
+	quat r;
+	decompositeTransform(GetWorldTransform(), t, r, s);
+
+	mat4 m;
+	compositeTransform(m, pos, r, s);
+	SetWorldTransform(m);
 }
 
 auto DLLEXPORT GameObject::GetWorldPosition() -> vec3
 {
-	return worldPos_;
+	return GetWorldTransform().Column3(3);
 }
 
-auto DLLEXPORT GameObject::SetWorldRotation(const quat & r) -> void
+auto DLLEXPORT GameObject::SetWorldRotation(const quat & rot) -> void
 {
-	worldRot_ = r;
-	compositeTransform(worldTransform_, worldPos_, worldRot_, worldScale_);
-	SetWorldTransform(worldTransform_);
+	vec3 t, s;
+	quat r;
+	decompositeTransform(GetWorldTransform(), t, r, s);
+
+	mat4 m;
+	compositeTransform(m, t, rot, s);
+	SetWorldTransform(m);
 }
 
 auto DLLEXPORT GameObject::GetWorldRotation() -> quat
 {
-	return worldRot_;
+	vec3 t, s;
+	quat r;
+	decompositeTransform(GetWorldTransform(), t, r, s);
+	return r;
 }
 
-auto DLLEXPORT GameObject::SetWorldScale(vec3 s) -> void
+auto DLLEXPORT GameObject::SetWorldScale(vec3 scale) -> void
 {
-	worldScale_ = s;
-	compositeTransform(worldTransform_, worldPos_, worldRot_, worldScale_);
-	SetWorldTransform(worldTransform_);
+	vec3 t, s;
+	quat r;
+	decompositeTransform(GetWorldTransform(), t, r, s);
+
+	mat4 m;
+	compositeTransform(m, t, r, scale);
+	SetWorldTransform(m);
 }
 
 auto DLLEXPORT GameObject::GetWorldScale() -> vec3
 {
-	return worldScale_;
+	vec3 t, s;
+	quat r;
+	decompositeTransform(GetWorldTransform(), t, r, s);
+	return s;
 }
 
 auto DLLEXPORT GameObject::SetWorldTransform(const mat4& m) -> void
 {
-	worldTransform_ = m;
-	decompositeTransform(worldTransform_, worldPos_, worldRot_, worldScale_);
-
-	if (parent_)
-		localTransform_ = parent_->GetWorldTransform().Inverse() * worldTransform_;
-	else
-		localTransform_ = worldTransform_;
-	decompositeTransform(localTransform_, pos_, rot_, scale_);
-
-	for(int i = 0; i < childs_.size(); i++) // update childs
-		childs_[i]->SetLocalTransform(childs_[i]->localTransform_);
+	TransformSystem::SetWorldMatrix(transform_, m);
 }
 
 auto DLLEXPORT GameObject::GetWorldTransform() -> mat4
 {
-	return worldTransform_;
+	return TransformSystem::GetWorldMatrix(transform_);
 }
 
 auto DLLEXPORT GameObject::GetInvWorldTransform() -> mat4
 {
-	mat4 mat = worldTransform_.Inverse();
-	return mat;
+	return TransformSystem::GetWorldMatrixInverse(transform_);
+}
+
+auto DLLEXPORT GameObject::GetNormalMatrix() -> mat4
+{
+	return TransformSystem::GetNormalMatrix(transform_);
 }
 
 auto DLLEXPORT GameObject::GetWorldTransformPrev() -> mat4
 {
-	return worldTransformPrev_;
+	return TransformSystem::GetWorldMatrixPrev(transform_);
 }
 
 auto DLLEXPORT GameObject::GetChild(size_t i) -> GameObject*
@@ -226,9 +242,11 @@ auto DLLEXPORT GameObject::RemoveChild(GameObject *obj) -> void
 	auto it = std::find(childs_.begin(), childs_.end(), obj);
 	if (it != childs_.end())
 	{
+		mat4 world = obj->GetWorldTransform();
 		childs_.erase(it);
 		obj->parent_ = nullptr;
-		obj->SetWorldTransform(obj->worldTransform_);
+		TransformSystem::SetParent(obj->transform_, -1);
+		obj->SetWorldTransform(world);
 	}
 	else
 		LogWarning("GameObject::RemoveChild(): child not found");
@@ -240,8 +258,10 @@ auto DLLEXPORT GameObject::InsertChild(GameObject *obj, int row) -> void
 		childs_.push_back(obj);
 	else
 		childs_.insert(childs_.begin() + row, obj);
+	mat4 world = obj->GetWorldTransform();
 	obj->parent_ = this;
-	obj->SetWorldTransform(obj->worldTransform_);
+	TransformSystem::SetParent(obj->transform_, transform_);
+	obj->SetWorldTransform(world);
 }
 
 auto DLLEXPORT GameObject::Clone() -> GameObject *
@@ -285,32 +305,42 @@ void print_mat(mat4& m)
 void DLLEXPORT GameObject::print_local()
 {
 	Log("Object %s", name_.c_str());
+	vec3 pos = GetLocalPosition();
+	quat rot = GetLocalRotation();
+	vec3 scale = GetLocalScale();
+	mat4 localTransform = GetLocalTransform();
+
 	Log("pos_:");
-	print_vec(pos_);
+	print_vec(pos);
 
 	Log("rot_:");
-	print_quat(rot_);
+	print_quat(rot);
 
 	Log("scale_:");
-	print_vec(scale_);
+	print_vec(scale);
 
 	Log("localTransform:");
-	print_mat(localTransform_);
+	print_mat(localTransform);
 }
 
 void DLLEXPORT GameObject::print_global()
 {
 	Log("Object %s", name_.c_str());
+	mat4 worldTransform = GetWorldTransform();
+	vec3 worldPos, worldScale;
+	quat worldRot;
+	decompositeTransform(worldTransform, worldPos, worldRot, worldScale);
+
 	Log("worldPos:");
-	print_vec(worldPos_);
+	print_vec(worldPos);
 
 	Log("worldRot:");
-	print_quat(worldRot_);
+	print_quat(worldRot);
 
 	Log("worldScale:");
-	print_vec(worldScale_);
+	print_vec(worldScale);
 
 	Log("worldTransform:");
-	print_mat(worldTransform_);
+	print_mat(worldTransform);
 }
 
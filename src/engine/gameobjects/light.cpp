@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "light.h"
 #include "yaml.inl"
+#include "scene_file.h"
 
 void Light::Copy(GameObject * original)
 {
@@ -33,6 +34,22 @@ void Light::LoadYAML(void * yaml)
 	if (n["light_type"]) lightType_ = (LIGHT_TYPE)n["light_type"].as<int>();
 }
 
+void Light::SaveBinary(SceneFileObject& obj, SceneWriter& writer)
+{
+	GameObject::SaveBinary(obj, writer);
+
+	obj.params[0] = intensity_;
+	obj.params[1] = (float)lightType_;
+}
+
+void Light::LoadBinary(const SceneFileObject& obj)
+{
+	GameObject::LoadBinary(obj);
+
+	intensity_ = obj.params[0];
+	lightType_ = (LIGHT_TYPE)(int)obj.params[1];
+}
+
 Light::Light()
 {
 	type_ = OBJECT_TYPE::LIGHT;
@@ -4,7 +4,18 @@
 #include "core.h"
 #include "material_manager.h"
 #include "yaml.inl"
+#include "scene_file.h"
 #include "mesh.h"
+#include "aabb_tree.h"
+#include "render_proxies.h"
+#include "thread_pool.h"
+
+#define RAYTRACING_TRIANGLES_GRAIN 4096
+
+static AABBTree modelsTree; // world bounds of models with known mesh bounds
+static vector<Model*> pendingModels; // waiting for mesh to be loaded
+static vector<void*> visibleModels;
+static uint cullingStamp;
 
 
 void Model::Copy(GameObject * original)
@@ -14,12 +25,50 @@ void Model::Copy(GameObject * original)
 	Model *original_model = static_cast<Model*>(original);
 	meshPtr = original_model->meshPtr;
 	mat_ = original_model->mat_;
+
+	resetBounds();
+}
+
+void Model::onTransformChanged()
+{
+	updateWorldBounds();
+	RenderProxies::UpdateTransform(this);
+}
+
+void Model::onEnabledChanged()
+{
+	RenderProxies::UpdateFlags(this);
+}
+
+void Model::updateWorldBounds()
+{
+	if (!hasBounds_)
+		return;
+
+	worldBounds_ = meshBounds_.Transform(GetWorldTransform());
+
+	if (treeProxy_ < 0)
+		treeProxy_ = modelsTree.Insert(worldBounds_, this);
+	else
+		modelsTree.Move(treeProxy_, worldBounds_);
+}
+
+void Model::resetBounds()
+{
+	if (treeProxy_ >= 0)
+	{
+		modelsTree.Remove(treeProxy_);
+		treeProxy_ = -1;
+		pendingModels.push_back(this);
+	}
+	hasBounds_ = false;
 }
 
 Model::Model()
 {
 	type_ = OBJECT_TYPE::MODEL;
 	mat_ = MAT_MAN->GetDiffuseMaterial();
+	pendingModels.push_back(this);
 }
 
 Model::Model(StreamPtr<Mesh> mesh) : Model()
@@ -27,9 +76,61 @@ Model::Model(StreamPtr<Mesh> mesh) : Model()
 	meshPtr = mesh;
 }
 
+void Model::SetMesh(StreamPtr<Mesh>& mesh)
+{
+	meshPtr = mesh;
+	resetBounds();
+}
+
+Model::~Model()
+{
+	RenderProxies::Remove(this);
+
+	if (treeProxy_ >= 0)
+		modelsTree.Remove(treeProxy_);
+	else
+		pendingModels.erase(std::remove(pendingModels.begin(), pendingModels.end(), this), pendingModels.end());
+}
+
+void Model::CullModels(const mat4& VP)
+{
+	// models get into the tree once their mesh is loaded
+	for (size_t i = 0; i < pendingModels.size();)
+	{
+		Model *m = pendingModels[i];
+		Mesh *mesh = m->meshPtr.isLoaded() ? m->meshPtr.get() : nullptr;
+
+		if (!mesh)
+		{
+			i++;
+			continue;
+		}
+
+		m->meshBounds_ = mesh->GetBounds();
+		m->hasBounds_ = true;
+		m->updateWorldBounds();
+
+		pendingModels[i] = pendingModels.back();
+		pendingModels.pop_back();
+	}
+
+	cullingStamp++;
+	visibleModels.clear();
+	modelsTree.Query(Frustum(VP), visibleModels);
+
+	for (void *m : visibleModels)
+		static_cast<Model*>(m)->visibleStamp_ = cullingStamp;
+}
+
+bool Model::IsVisible()
+{
+	return visibleStamp_ == cullingStamp;
+}
+
 std::shared_ptr<RaytracingData> Model::GetRaytracingData(uint mat)
 {
 	vector<GPURaytracingTriangle>& dataIn = meshPtr.get()->GetRaytracingData()->triangles;
+	mat4 worldTransform = GetWorldTransform();
 
 	if (!trianglesDataPtrWorldSpace)
 	{
@@ -37,37 +138,48 @@ std::shared_ptr<RaytracingData> Model::GetRaytracingData(uint mat)
 		trianglesDataTransform = {};
 	}
 
-	if (memcmp(&trianglesDataTransform, &worldTransform_, sizeof(mat4)) != 0 || raytracingMaterial != mat)
+	if (memcmp(&trianglesDataTransform, &worldTransform, sizeof(mat4)) != 0 || raytracingMaterial != mat)
 	{
 		raytracingMaterial = mat;
 
 		vector<GPURaytracingTriangle>& dataOut = trianglesDataPtrWorldSpace->triangles;
-		mat4 NM = worldTransform_.Inverse().Transpose();
 
-		for (int i = 0; i < dataIn.size(); ++i)
-		{
-			GPURaytracingTriangle& ti = dataIn[i];
-			GPURaytracingTriangle& to = dataOut[i];
+		TransformRaytracingTriangles(_core->GetThreadPool(), worldTransform, GetNormalMatrix(), dataIn.data(), dataOut.data(), dataIn.size(), mat);
 
-			to.p0 = worldTransform_ * ti.p0;
-			to.p1 = worldTransform_ * ti.p1;
-			to.p2 = worldTransform_ * ti.p2;
+		trianglesDataTransform = worldTransform;
+	}
 
-			to.n = NM * ti.n;
+	return trianglesDataPtrWorldSpace;
+}
 
-			to.materialID = mat;
-		}
+void Model::TransformRaytracingTriangles(ThreadPool *pool, const mat4& M, const mat4& NM, const GPURaytracingTriangle *in, GPURaytracingTriangle *out, size_t num, uint mat)
+{
+	const size_t stride = sizeof(GPURaytracingTriangle);
 
-		trianglesDataTransform = worldTransform_;
-	}
+	pool->ParallelFor(num, RAYTRACING_TRIANGLES_GRAIN, [&](size_t begin, size_t end)
+	{
+		const size_t n = end - begin;
 
-	return trianglesDataPtrWorldSpace;
+		transformPoints(M, &in[begin].p0, stride, &out[begin].p0, stride, n);
+		transformPoints(M, &in[begin].p1, stride, &out[begin].p1, stride, n);
+		transformPoints(M, &in[begin].p2, stride, &out[begin].p2, stride, n);
+		transformPoints(NM, &in[begin].n, stride, &out[begin].n, stride, n);
+
+		for (size_t i = begin; i < end; ++i)
+			out[i].materialID = mat;
+	});
 }
 
 auto DLLEXPORT Model::GetMesh() -> Mesh *
 {
 	return meshPtr.get();
 }
+auto DLLEXPORT Model::SetMaterial(Material *mat) -> void
+{
+	mat_ = mat;
+	RenderProxies::UpdateMaterial(this);
+}
+
 auto DLLEXPORT Model::GetMeshPath() -> const char *
 {
 	return meshPtr.path().c_str();
@@ -76,7 +188,7 @@ auto DLLEXPORT Model::GetMeshPath() -> const char *
 auto DLLEXPORT Model::GetWorldCenter() -> vec3
 {
 	vec3 center = meshPtr.isLoaded() ? meshPtr.get()->GetCenter() : vec3();
-	vec4 centerWS = worldTransform_ * vec4(center);
+	vec4 centerWS = GetWorldTransform() * vec4(center);
 	return (vec3)centerWS;
 }
 
@@ -119,3 +231,14 @@ void Model::LoadYAML(void * yaml)
 	}
 }
 
+void Model::SaveBinary(SceneFileObject& obj, SceneWriter& writer)
+{
+	GameObject::SaveBinary(obj, writer);
+
+	if (!meshPtr.path().empty())
+		obj.mesh = writer.AddString(meshPtr.path().c_str());
+
+	if (mat_)
+		obj.material = writer.AddString(mat_->GetId());
+}
+
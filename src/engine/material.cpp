@@ -11,6 +11,18 @@
 #include <sstream>
 
 #define MAX_DEFINES_COUNT 10
+#define MATERIAL_PARAMETERS_BUFFER "material_parameters"
+
+static int getHandle(std::unordered_map<uint, int>& handles, Shader *shader, const char *name)
+{
+	auto it = handles.find(shader->GetId());
+	if (it != handles.end())
+		return it->second;
+
+	int handle = shader->GetParameterHandle(name);
+	handles.emplace(shader->GetId(), handle);
+	return handle;
+}
 
 
 void GenericMaterial::LoadXML()
@@ -152,8 +164,19 @@ void GenericMaterial::Clear()
 	forwardShader_.clear();
 }
 
+void GenericMaterial::OnShaderDestroyed(uint shaderId)
+{
+	for (Param& p : params_)
+		p.handles.erase(shaderId);
+
+	for (MaterialTexture& t : textures_)
+		t.uvHandles.erase(shaderId);
+}
+
 void Material::initializeFromParent()
 {
+	paramBlocks_.clear();
+
 	runtimeParams_.clear();
 	for (auto& p : parent_->params_)
 		runtimeParams_.push_back(p.defaultValue);
@@ -163,18 +186,89 @@ void Material::initializeFromParent()
 		runtimeTextures_[p.id] = { p.path, RES_MAN->CreateStreamTexture(p.path.c_str(), TEXTURE_CREATE_FLAGS::GENERATE_MIPMAPS | TEXTURE_CREATE_FLAGS::FILTER_ANISOTROPY_8X) };
 }
 
+Material::ParamBlock& Material::getParamBlock(Shader *shader, PASS pass)
+{
+	for (ParamBlock& b : paramBlocks_)
+		if (b.shaderId == shader->GetId() && b.pass == pass)
+			return b;
+
+	ParamBlock& b = paramBlocks_.emplace_back();
+	b.shaderId = shader->GetId();
+	b.pass = pass;
+	b.bufferHandle = shader->GetConstantBufferHandle(MATERIAL_PARAMETERS_BUFFER);
+
+	if (b.bufferHandle < 0)
+		return b;
+
+	b.bytes = shader->GetConstantBufferSize(b.bufferHandle);
+	b.data = unique_ptr<uint8[]>(new uint8[b.bytes]);
+	memset(b.data.get(), 0, b.bytes);
+
+	for (GenericMaterial::Param& p : parent_->params_)
+	{
+		uint bytes = 0;
+		int offset = p.pass == pass ? shader->GetParameterOffset(b.bufferHandle, p.id.c_str(), &bytes) : -1;
+		uint paramBytes = p.type == GenericMaterial::PARAM_TYPE::COLOR ? sizeof(vec4) : sizeof(float);
+
+		b.offsets.push_back(offset);
+		b.sizes.push_back(min(bytes, paramBytes));
+	}
+
+	b.buffer = unique_ptr<ICoreConstantBuffer>(CORE_RENDER->CreateConstantBuffer(b.bytes));
+
+	return b;
+}
+
+void Material::paramChanged(size_t param)
+{
+	for (ParamBlock& b : paramBlocks_)
+		if (b.bufferHandle >= 0 && b.offsets[param] >= 0)
+			b.dirty = true;
+}
+
+void Material::OnShaderDestroyed(uint shaderId)
+{
+	paramBlocks_.erase(std::remove_if(paramBlocks_.begin(), paramBlocks_.end(),
+		[shaderId](const ParamBlock& b) { return b.shaderId == shaderId; }),
+		paramBlocks_.end());
+}
+
 void Material::UploadShaderParameters(Shader *shader, PASS pass)
 {
+	ParamBlock& b = getParamBlock(shader, pass);
+
+	if (b.bufferHandle >= 0)
+	{
+		if (b.dirty)
+		{
+			for (size_t i = 0; i < runtimeParams_.size(); i++)
+			{
+				if (b.offsets[i] < 0)
+					continue;
+				memcpy(b.data.get() + b.offsets[i], &runtimeParams_[i], b.sizes[i]);
+			}
+
+			b.buffer->SetData(b.data.get(), b.bytes);
+			b.dirty = false;
+		}
+
+		shader->SetConstantBuffer(b.bufferHandle, b.buffer.get());
+		return;
+	}
+
+	// shader without parameters block
 	for (auto i = 0; i < runtimeParams_.size(); i++)
 	{
 		GenericMaterial::Param& p = parent_->params_[i];
 		if (p.pass != pass)
 			continue;
 
+		int handle = getHandle(p.handles, shader, p.id.c_str());
+
 		if(p.type == GenericMaterial::PARAM_TYPE::FLOAT)
-			shader->SetFloatParameter(p.id.c_str(), runtimeParams_[i].x);
+			shader->SetFloatParameter(handle, runtimeParams_[i].x);
 		else if(p.type == GenericMaterial::PARAM_TYPE::COLOR)
-			shader->SetVec4Parameter(p.id.c_str(), &runtimeParams_[i]);
+			shader->SetVec4Parameter(handle, &runtimeParams_[i]);
 	}
 }
 
@@ -204,8 +298,13 @@ void Material::BindShaderTextures(Shader* shader, PASS pass)
 
 		if (texs[slot])
 		{
-			string shader_par = "uv_transform_" + tex.id;
-			shader->SetVec4Parameter(shader_par.c_str(), &t.uv);
+			auto it = tex.uvHandles.find(shader->GetId());
+			if (it == tex.uvHandles.end())
+			{
+				string shader_par = "uv_transform_" + tex.id;
+				it = tex.uvHandles.emplace(shader->GetId(), shader->GetParameterHandle(shader_par.c_str())).first;
+			}
+			shader->SetVec4Parameter(it->second, &t.uv);
 		}
 	}
 
@@ -353,6 +452,9 @@ auto DLLEXPORT Material::LoadXML() -> void
 		runtimeParams_[id] = vec;
 	}
 
+	for (ParamBlock& b : paramBlocks_)
+		b.dirty = true;
+
 	for (pugi::xml_node i = mat.child("texture"); i; i = i.next_sibling("texture"))
 	{
 		string id = i.attribute("id").as_string();
@@ -376,6 +478,8 @@ auto DLLEXPORT Material::SetParamFloat(const char* def, float value) -> void
 	auto id = parent_->nameToIndexMap_[def];
 	runtimeParams_[id].x = value;
 
+	paramChanged(id);
+
 	MaterialManager* mm = _core->GetMaterialManager();
 	mm->MaterialChanged(this);
 }
@@ -391,6 +495,8 @@ auto DLLEXPORT Material::SetParamFloat4(const char* def, const vec4& value) -> v
 	auto id = parent_->nameToIndexMap_[def];
 	runtimeParams_[id] = value;
 
+	paramChanged(id);
+
 	MaterialManager* mm = _core->GetMaterialManager();
 	mm->MaterialChanged(this);
 }
@@ -492,28 +598,28 @@ auto DLLEXPORT Material::GetUV(const char* name) -> vec4
 	return runtimeTextures_[name].uv;
 }
 
-Shader* Material::GetShader(Mesh* mesh)
+Shader* Material::GetShader(Mesh* mesh, bool instanced)
 {
 	Render *render = _core->GetRender();
-	return render->GetShader(parent_->shader_.c_str(), mesh, &currentDefinesVec_);
+	return render->GetShader(parent_->shader_.c_str(), mesh, &currentDefinesVec_, instanced ? Render::LS_INSTANCED : Render::LS_NONE);
 }
-Shader* Material::GetDeferredShader(Mesh* mesh)
+Shader* Material::GetDeferredShader(Mesh* mesh, bool instanced)
 {
 	Render *render = _core->GetRender();
-	return render->GetShader(parent_->deferredShader_.c_str(), mesh, &currentDefinesVec_);
+	return render->GetShader(parent_->deferredShader_.c_str(), mesh, &currentDefinesVec_, instanced ? Render::LS_INSTANCED : Render::LS_NONE);
 }
-Shader* Material::GetIdShader(Mesh* mesh)
+Shader* Material::GetIdShader(Mesh* mesh, bool instanced)
 {
 	Render *render = _core->GetRender();
-	return render->GetShader(parent_->idShader_.c_str(), mesh, &currentDefinesVec_);
+	return render->GetShader(parent_->idShader_.c_str(), mesh, &currentDefinesVec_, instanced ? Render::LS_INSTANCED : Render::LS_NONE);
 }
-Shader* Material::GetWireframeShader(Mesh* mesh)
+Shader* Material::GetWireframeShader(Mesh* mesh, bool instanced)
 {
 	Render *render = _core->GetRender();
-	return render->GetShader(parent_->wireframeShader_.c_str(), mesh, &currentDefinesVec_);
+	return render->GetShader(parent_->wireframeShader_.c_str(), mesh, &currentDefinesVec_, instanced ? Render::LS_INSTANCED : Render::LS_NONE);
 }
-Shader* Material::GetForwardShader(Mesh* mesh)
+Shader* Material::GetForwardShader(Mesh* mesh, bool instanced)
 {
 	Render *render = _core->GetRender();
-	return render->GetShader(parent_->forwardShader_.c_str(), mesh, &currentDefinesVec_);
+	return render->GetShader(parent_->forwardShader_.c_str(), mesh, &currentDefinesVec_, instanced ? Render::LS_INSTANCED : Render::LS_NONE);
 }
@@ -4,6 +4,7 @@
 #include "console.h"
 #include "filesystem.h"
 #include "material.h"
+#include "resource_manager.h"
 #include <unordered_map>
 
 static std::unordered_map<std::string, Material*> materials; // id -> Material
@@ -11,10 +12,25 @@ static std::set<Material*> internalMaterials;
 static std::unordered_map<std::string, GenericMaterial*> genericMaterials; // id -> GenericMaterial
 static int matNameCounter;
 static Material *diffuseMaterial;
+static vector<Material*> destroyedMaterials; // deleted by next Update(): frame in flight can use them
 
+static void onShaderDestroyed(uint shaderId)
+{
+	for (auto& m : genericMaterials)
+		m.second->OnShaderDestroyed(shaderId);
+
+	for (auto& m : materials)
+		m.second->OnShaderDestroyed(shaderId);
+	for (Material *mat : internalMaterials)
+		mat->OnShaderDestroyed(shaderId);
+	for (Material *mat : destroyedMaterials)
+		mat->OnShaderDestroyed(shaderId);
+}
 
 void MaterialManager::Init()
 {
+	RES_MAN->AddCallbackShaderDestroyed(onShaderDestroyed);
+
 	//
 	// Load generic materials
 	vector<string> paths = FS->FilterPaths(GENERIC_MATERIAL_EXT);
@@ -49,8 +65,19 @@ void MaterialManager::Init()
 	diffuseMaterial = CreateInternalMaterial("mesh");
 }
 
+void MaterialManager::Update()
+{
+	for (Material *mat : destroyedMaterials)
+		delete mat;
+	destroyedMaterials.clear();
+}
+
 void MaterialManager::Free()
 {
+	RES_MAN->RemoveCallbackShaderDestroyed(onShaderDestroyed);
+
+	Update();
+
 	for (auto &m : materials)
 	{
 		m.second->SaveXML();
@@ -117,7 +144,7 @@ auto DLLEXPORT MaterialManager::DestoryMaterial(Material* mat) -> void
 		if (iter->second == mat)
 		{
 			materials.erase(iter++);
-			delete mat;
+			destroyedMaterials.push_back(mat);
 			return;
 		}
 		else
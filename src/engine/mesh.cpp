@@ -88,6 +88,20 @@ Mesh::~Mesh()
 	Log("Mesh unloaded: '%s'", path_.c_str());
 }
 
+static AABB stdMeshBounds(const char *path)
+{
+	if (!strcmp(path, "std#plane"))
+		return { vec3(-1.0f, -1.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f) };
+	else if (!strcmp(path, "std#grid"))
+		return { vec3(-100.0f, -100.0f, 0.0f), vec3(100.0f, 100.0f, 0.0f) };
+	else if (!strcmp(path, "std#line"))
+		return { vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f) };
+	else if (!strcmp(path, "std#axes_arrows"))
+		return { vec3(0.72f, -0.052f, -0.052f), vec3(1.0f, 0.052f, 0.052f) };
+
+	return { vec3(-1.0f, -1.0f, -1.0f), vec3(1.0f, 1.0f, 1.0f) };
+}
+
 ICoreMesh* createStdMesh(const char *path)
 {
 	ICoreMesh *ret = nullptr;
@@ -229,6 +243,8 @@ bool Mesh::Load()
 	if (isStd())
 	{
 		coreMeshPtr.reset(createStdMesh(path_.c_str()));
+		bounds_ = stdMeshBounds(path_.c_str());
+		center_ = bounds_.Center();
 		return true;
 	}
 
@@ -291,9 +307,9 @@ bool Mesh::Load()
 		return false;
 	}	
 
-	center_.x = header.minX * 0.5f + header.maxX * 0.5f;
-	center_.y = header.minY * 0.5f + header.maxY * 0.5f;
-	center_.z = header.minZ * 0.5f + header.maxZ * 0.5f;
+	bounds_.vmin = vec3(header.minX, header.minY, header.minZ);
+	bounds_.vmax = vec3(header.maxX, header.maxY, header.maxZ);
+	center_ = bounds_.Center();
 
 	return true;
 }
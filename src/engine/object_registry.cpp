@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "object_registry.h"
+#include "gameobject.h"
+#include "core.h"
+#include <assert.h>
+
+struct Slot
+{
+	uint32_t generation;
+	uint32_t dense; // index in objects
+	int id;
+};
+
+static vector<Slot> slots;
+static vector<uint32_t> freeSlots;
+static vector<GameObject*> objects; // dense
+static vector<uint32_t> denseToSlot;
+static std::unordered_map<int, uint32_t> idToSlot;
+static RandomInstance<GameObject> rand_;
+static thread_local bool updatingObjects;
+
+
+auto ObjectRegistry::Add(GameObject *g) -> ObjectHandle
+{
+	assert(!updatingObjects && "ObjectRegistry::Add(): objects can't be created in GameObject::Update()");
+
+	uint32_t index;
+
+	if (freeSlots.empty())
+	{
+		index = (uint32_t)slots.size();
+		slots.push_back({0, 0, 0});
+	}
+	else
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+
+	int id;
+	do
+	{
+		id = rand_.getRandomInt();
+	} while (idToSlot.find(id) != idToSlot.end());
+
+	Slot& s = slots[index];
+	s.dense = (uint32_t)objects.size();
+	s.id = id;
+	objects.push_back(g);
+	denseToSlot.push_back(index);
+	idToSlot[id] = index;
+
+	g->id_ = id;
+
+	return {index, s.generation};
+}
+
+void ObjectRegistry::Remove(ObjectHandle h)
+{
+	assert(!updatingObjects && "ObjectRegistry::Remove(): objects can't be destroyed in GameObject::Update()");
+
+	if (!IsAlive(h))
+		return;
+
+	Slot& s = slots[h.index];
+
+	// move last object to the hole
+	uint32_t last = (uint32_t)objects.size() - 1;
+	if (s.dense != last)
+	{
+		objects[s.dense] = objects[last];
+		denseToSlot[s.dense] = denseToSlot[last];
+		slots[denseToSlot[s.dense]].dense = s.dense;
+	}
+	objects.pop_back();
+	denseToSlot.pop_back();
+
+	auto it = idToSlot.find(s.id);
+	if (it != idToSlot.end() && it->second == h.index)
+		idToSlot.erase(it);
+
+	s.generation++;
+	s.dense = UINT32_MAX;
+	freeSlots.push_back(h.index);
+}
+
+auto ObjectRegistry::SetId(ObjectHandle h, int id) -> bool
+{
+	assert(!updatingObjects && "ObjectRegistry::SetId(): ids can't be changed in GameObject::Update()");
+
+	if (!IsAlive(h))
+		return false;
+
+	Slot& s = slots[h.index];
+	if (s.id == id)
+		return true;
+
+	auto it = idToSlot.find(id);
+	if (it != idToSlot.end())
+	{
+		LogWarning("ObjectRegistry::SetId(): id %i is already used, object keeps id %i", id, s.id);
+		return false;
+	}
+
+	it = idToSlot.find(s.id);
+	if (it != idToSlot.end() && it->second == h.index)
+		idToSlot.erase(it);
+
+	s.id = id;
+	idToSlot[id] = h.index;
+	return true;
+}
+
+auto ObjectRegistry::Get(ObjectHandle h) -> GameObject*
+{
+	return IsAlive(h) ? objects[slots[h.index].dense] : nullptr;
+}
+
+auto ObjectRegistry::IsAlive(ObjectHandle h) -> bool
+{
+	return h.index < slots.size() && slots[h.index].generation == h.generation && slots[h.index].dense != UINT32_MAX;
+}
+
+auto ObjectRegistry::FindById(int id) -> GameObject*
+{
+	auto it = idToSlot.find(id);
+	if (it == idToSlot.end())
+		return nullptr;
+
+	return objects[slots[it->second].dense];
+}
+
+auto ObjectRegistry::GetObjects() -> const std::vector<GameObject*>&
+{
+	return objects;
+}
+
+auto ObjectRegistry::IsUpdatingObjects() -> bool
+{
+	return updatingObjects;
+}
+
+void ObjectRegistry::SetUpdatingObjects(bool v)
+{
+	updatingObjects = v;
+}
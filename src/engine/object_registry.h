@@ -0,0 +1,24 @@
+#pragma once
+#include "common.h"
+
+//
+// Generational slot map of all live GameObjects.
+// Handle is index of slot + generation, stale handles resolve to nullptr.
+// Objects are kept in a dense array, id -> slot hash map gives O(1) lookup by id.
+// Not thread-safe: objects are added, removed and reparented only outside of GameObject::Update() jobs.
+//
+class ObjectRegistry
+{
+public:
+	static auto Add(GameObject *g) -> ObjectHandle; // generates unique id for g
+	static void Remove(ObjectHandle h);
+	static auto SetId(ObjectHandle h, int id) -> bool; // false if id is used by other object, its mapping is kept
+
+	static auto Get(ObjectHandle h) -> GameObject*;
+	static auto IsAlive(ObjectHandle h) -> bool;
+	static auto FindById(int id) -> GameObject*;
+	static auto GetObjects() -> const std::vector<GameObject*>&; // all live objects in arbitrary order
+
+	static auto IsUpdatingObjects() -> bool; // current thread runs GameObject::Update() job
+	static void SetUpdatingObjects(bool v);
+};
@@ -14,13 +14,15 @@
 #include "render_paths/render_path_pathtracing.h"
 #include "thirdparty/simplecpp/SimpleCpp.h"
 #include "crc.h"
+#include "render_proxies.h"
+#include "render_graph.h"
+#include "transform_system.h"
+#include "cpu_profiler.h"
+#include "command_list.h"
+#include "thread_pool.h"
 #include <memory>
 #include <sstream>
-
-namespace {
-	crc32 crc;
-}
-
+#include <chrono>
 
 struct ShaderInstance
 {
@@ -32,6 +34,38 @@ struct ShaderInstance
 
 static std::unordered_map<string, ShaderInstance> runtimeShaders; // defines -> Shader
 
+struct MeshShaderHandles
+{
+	int MVP;
+	int MVP_prev;
+	int M;
+	int NM;
+	int id;
+};
+
+static std::unordered_map<uint, MeshShaderHandles> meshShaderHandles; // shader id -> handles
+
+static const MeshShaderHandles& getMeshShaderHandles(Shader *shader)
+{
+	auto it = meshShaderHandles.find(shader->GetId());
+	if (it != meshShaderHandles.end())
+		return it->second;
+
+	MeshShaderHandles h;
+	h.MVP = shader->GetParameterHandle("MVP");
+	h.MVP_prev = shader->GetParameterHandle("MVP_prev");
+	h.M = shader->GetParameterHandle("M");
+	h.NM = shader->GetParameterHandle("NM");
+	h.id = shader->GetParameterHandle("id");
+
+	return meshShaderHandles.emplace(shader->GetId(), h).first->second;
+}
+
+static void onShaderDestroyed(uint shaderId)
+{
+	meshShaderHandles.erase(shaderId);
+}
+
 
 // One Profiler character
 struct charr
@@ -41,16 +75,12 @@ struct charr
 	uint32_t __align[3];
 };
 
-// One profiler line
-struct RenderProfileRecord
-{
-	size_t txtHash{};
-	size_t length{};
-	std::unique_ptr<charr[]> bufferData;
-	SharedPtr<StructuredBuffer> buffer;
-};
-
-static std::vector<RenderProfileRecord> records;
+// Profiler overlay: text of all lines goes to one arena, all glyphs to one buffer
+static TextArena profilerText;
+static vector<charr> glyphs;
+static vector<charr> glyphsUploaded;
+static SharedPtr<StructuredBuffer> glyphBuffer;
+static size_t glyphBufferCapacity;
 
 
 struct RenderTexture
@@ -65,7 +95,7 @@ struct RenderTexture
 	PREV_TEXTURES id{ PREV_TEXTURES ::UNKNOWN};
 };
 
-static vector<RenderTexture> renderTextures;
+static RenderTargetPool renderTargets;
 static vector<RenderTexture> prevRenderTextures;
 
 static const uint fontWidth[256] =
@@ -85,75 +115,313 @@ static const uint fontWidth[256] =
 ,7, 7, 8, 8, 8, 8, 8, 9, 8, 7, 7, 7, 7, 6, 8, 6
 };
 
-void Render::drawMeshes(PASS pass, std::vector<Render::RenderMesh>& meshes, mat4 VP, mat4 VP_Prev)
+// Draw list item.
+// Key bits: pass (3) | shader (16) | material (16) | mesh (16) | depth (13)
+struct DrawItem
+{
+	uint64_t key;
+	uint32_t index; // in meshes
+	Shader *shader;
+};
+
+static vector<DrawItem> drawList;
+static vector<DrawItem> drawListTmp;
+
+static vector<Render::RenderMesh> visibleMeshes; // result of getVisibleMeshes()
+
+// Instancing
+#define INSTANCING_MIN_COUNT 2
+#define INSTANCE_BUFFER_SLOT 15 // ENG_INSTANCED shaders read transforms from t15
+
+struct InstanceData
+{
+	mat4 MVP;
+	mat4 MVP_prev;
+	mat4 M;
+	mat4 NM;
+};
+
+static SharedPtr<StructuredBuffer> instanceBuffer;
+static size_t instanceBufferElements;
+
+// Multithreaded draw preparation: sorted draw list is split to batches (one draw call each),
+// slices of batches are recorded to command lists on thread pool, lists are submitted in order
+#define DRAW_OBJECTS_PER_LIST 1024 // less objects are recorded on one thread
+
+struct DrawBatch
+{
+	size_t begin; // in drawList
+	uint count;
+	Shader *shader;
+	Material *mat;
+	Mesh *mesh;
+	const MeshShaderHandles *handles; // nullptr for instanced batch
+	bool setShader;
+	bool uploadMaterial;
+};
+
+struct CommandListStat
+{
+	uint lists;
+	uint commands;
+	size_t bytes;
+};
+
+static vector<DrawBatch> drawBatches;
+static vector<size_t> drawSlices; // first batch of each command list
+static vector<CommandList> drawCommandLists;
+static size_t drawCommandListsLimit; // 0 - by number of workers
+static CommandListStat commandListStat;
+static CommandListStat lastCommandListStat;
+
+static Shader* getPassShader(Material *mat, PASS pass, Mesh *mesh, bool instanced)
 {
-	for (Render::RenderMesh& renderMesh : meshes)
+	if (pass == PASS::DEFERRED)
+		return mat->GetDeferredShader(mesh, instanced);
+	else if (pass == PASS::ID)
+		return mat->GetIdShader(mesh, instanced);
+	else if (pass == PASS::WIREFRAME)
+		return mat->GetWireframeShader(mesh, instanced);
+	return nullptr;
+}
+static std::unordered_map<void*, uint64_t> drawSlots; // material or mesh -> slot in key
+
+static uint64_t depthBits(float depth)
+{
+	// positive floats are ordered as their bit patterns,
+	// take exponent and 5 high bits of mantissa (13 low bits of key)
+	if (!(depth > 0.0f))
+		return 0;
+	uint32_t u;
+	memcpy(&u, &depth, sizeof(u));
+	return (u >> 18) & 0x1FFF;
+}
+
+static uint64_t drawSlot(void *ptr)
+{
+	auto it = drawSlots.find(ptr);
+	if (it != drawSlots.end())
+		return it->second;
+	uint64_t slot = drawSlots.size() & 0xFFFF;
+	drawSlots.emplace(ptr, slot);
+	return slot;
+}
+
+// LSD radix sort by 8 bits. Passes where all keys have same byte are skipped
+static void radixSort(vector<DrawItem>& items, vector<DrawItem>& tmp)
+{
+	tmp.resize(items.size());
+
+	for (int shift = 0; shift < 64; shift += 8)
 	{
-		Material* mat = renderMesh.mat;
-		if (!mat)
+		size_t count[256]{};
+		for (const DrawItem& item : items)
+			count[(item.key >> shift) & 0xFF]++;
+
+		if (count[(items[0].key >> shift) & 0xFF] == items.size())
 			continue;
 
-		Shader* shader = nullptr;
+		size_t offset = 0;
+		for (size_t i = 0; i < 256; i++)
+		{
+			size_t c = count[i];
+			count[i] = offset;
+			offset += c;
+		}
+
+		for (const DrawItem& item : items)
+			tmp[count[(item.key >> shift) & 0xFF]++] = item;
+
+		items.swap(tmp);
+	}
+}
 
-		if (pass == PASS::DEFERRED)
-			shader = mat->GetDeferredShader(renderMesh.mesh);
-		else if (pass == PASS::ID)
-			shader = mat->GetIdShader(renderMesh.mesh);
-		else if (pass == PASS::WIREFRAME)
-			shader = mat->GetWireframeShader(renderMesh.mesh);
+void Render::drawMeshes(PASS pass, const std::vector<Render::RenderMesh>& meshes, mat4 VP, mat4 VP_Prev)
+{
+	drawList.clear();
+	drawSlots.clear();
 
+	for (uint32_t i = 0; i < meshes.size(); i++)
+	{
+		const Render::RenderMesh& renderMesh = meshes[i];
+		Material* mat = renderMesh.mat;
+		if (!mat)
+			continue;
+
+		Shader* shader = getPassShader(mat, pass, renderMesh.mesh, false);
 		if (!shader)
 			continue;
 
-		CORE_RENDER->SetShader(shader);
+		vec4 center = VP * (renderMesh.worldTransformMat * vec4(renderMesh.mesh->GetCenter()));
+
+		uint64_t key = 0;
+		key |= uint64_t(((int)pass + 1) & 0x7) << 61;
+		key |= uint64_t(shader->GetId() & 0xFFFF) << 45;
+		key |= drawSlot(mat) << 29;
+		key |= drawSlot(renderMesh.mesh) << 13;
+		key |= depthBits(center.w);
 
-		mat->UploadShaderParameters(shader, pass);
-		mat->BindShaderTextures(shader, pass);
+		drawList.push_back({ key, i, shader });
+	}
 
-		mat4 MVP = VP * renderMesh.worldTransformMat;
-		mat4 MVP_prev = VP_Prev * renderMesh.worldTransformMatPrev;
-		mat4 M = renderMesh.worldTransformMat;
-		mat4 NM = M.Inverse().Transpose();
+	if (drawList.empty())
+		return;
 
-		shader->SetMat4Parameter("MVP", &MVP);
-		shader->SetMat4Parameter("MVP_prev", &MVP_prev);
-		shader->SetMat4Parameter("M", &M);
-		shader->SetMat4Parameter("NM", &NM);
+	radixSort(drawList, drawListTmp);
 
-		if (pass == PASS::ID)
-			shader->SetUintParameter("id", renderMesh.modelId);
+	// Batches are formed on this thread: shaders can be compiled and caches are filled here
+	drawBatches.clear();
+	size_t maxInstances = 0;
+	Shader *lastShader = nullptr;
+	Material *lastMat = nullptr;
 
-		shader->FlushParameters();
+	for (size_t i = 0; i < drawList.size();)
+	{
+		const DrawItem& item = drawList[i];
+		const Render::RenderMesh& renderMesh = meshes[item.index];
+		Material* mat = renderMesh.mat;
+		Shader* shader = item.shader;
 
-		CORE_RENDER->Draw(renderMesh.mesh, 1);
+		// same shader, material and mesh are neighbours after sorting.
+		// ID pass is not instanced: id is per object
+		size_t count = 1;
+		if (pass != PASS::ID)
+		{
+			while (i + count < drawList.size() &&
+				drawList[i + count].shader == shader &&
+				meshes[drawList[i + count].index].mat == mat &&
+				meshes[drawList[i + count].index].mesh == renderMesh.mesh)
+			{
+				count++;
+			}
+		}
+
+		Shader* instancedShader = count >= INSTANCING_MIN_COUNT ? getPassShader(mat, pass, renderMesh.mesh, true) : nullptr;
+		if (instancedShader)
+			shader = instancedShader;
+		else
+			count = 1;
+
+		DrawBatch b;
+		b.begin = i;
+		b.count = (uint)count;
+		b.shader = shader;
+		b.mat = mat;
+		b.mesh = renderMesh.mesh;
+		b.handles = instancedShader ? nullptr : &getMeshShaderHandles(shader);
+		b.setShader = shader != lastShader;
+		b.uploadMaterial = b.setShader || mat != lastMat;
+		drawBatches.push_back(b);
+
+		if (instancedShader)
+			maxInstances = max(maxInstances, count);
+
+		lastShader = shader;
+		lastMat = mat;
+		i += count;
 	}
-}
 
-template<typename T>
-void addObjectsRecursive(std::vector<T*>& ret, GameObject *root, OBJECT_TYPE type)
-{
-	size_t childs = root->GetNumChilds();
+	// recreate buffer. Lists are replayed one by one, so one buffer is enough
+	if (maxInstances && (!instanceBuffer || instanceBufferElements < maxInstances))
+	{
+		instanceBufferElements = max(maxInstances, instanceBufferElements * 2);
+		instanceBuffer = RES_MAN->CreateStructuredBuffer((uint)(instanceBufferElements * sizeof(InstanceData)), sizeof(InstanceData), BUFFER_USAGE::CPU_WRITE);
+	}
 
-	for (size_t i = 0; i < childs; i++)
+	// Slices of batches with about equal number of objects
+	ThreadPool *pool = _core->GetThreadPool();
+	size_t lists = drawCommandListsLimit ? drawCommandListsLimit : pool->GetWorkers() + 1;
+	lists = max(size_t(1), min(lists, drawList.size() / DRAW_OBJECTS_PER_LIST));
+
+	drawSlices.assign(lists + 1, drawBatches.size());
+	drawSlices[0] = 0;
+	for (size_t b = 0, list = 1; b < drawBatches.size() && list < lists; b++)
 	{
-		GameObject *g = root->GetChild(i);
-		addObjectsRecursive<T>(ret, g, type);
+		if (drawBatches[b].begin >= drawList.size() * list / lists)
+			drawSlices[list++] = b;
 	}
 
-	if (root->GetType() == type && root->IsEnabled())
-		ret.push_back(static_cast<T*>(root));
-}
+	if (drawCommandLists.size() < lists)
+		drawCommandLists.resize(lists);
 
-template<typename T>
-void getObjects(vector<T*>& vec, OBJECT_TYPE type)
-{
-	size_t objects = RES_MAN->GetNumObjects();
+	// Recording doesn't touch CORE_RENDER, state set by previous list is kept on submit
+	auto record = [&](size_t list)
+	{
+		CommandList& cmd = drawCommandLists[list];
+		cmd.Reset();
+
+		for (size_t b = drawSlices[list]; b < drawSlices[list + 1]; b++)
+		{
+			const DrawBatch& batch = drawBatches[b];
+			Shader *shader = batch.shader;
+
+			if (batch.setShader)
+				cmd.SetShader(shader);
+
+			if (batch.uploadMaterial)
+				cmd.UploadMaterial(batch.mat, shader, pass);
+
+			if (!batch.handles)
+			{
+				InstanceData *data = static_cast<InstanceData*>(cmd.SetStructuredBufferData(instanceBuffer.get(), batch.count * sizeof(InstanceData)));
+
+				for (size_t j = 0; j < batch.count; j++)
+				{
+					const Render::RenderMesh& r = meshes[drawList[batch.begin + j].index];
+					InstanceData instance;
+					instance.MVP = VP * r.worldTransformMat;
+					instance.MVP_prev = VP_Prev * r.worldTransformMatPrev;
+					instance.M = r.worldTransformMat;
+					instance.NM = r.normalMat;
+					memcpy(data + j, &instance, sizeof(InstanceData));
+				}
+
+				cmd.BindStructuredBuffer(INSTANCE_BUFFER_SLOT, instanceBuffer.get());
+				cmd.FlushParameters(shader);
+				cmd.Draw(batch.mesh, batch.count);
+			}
+			else
+			{
+				const Render::RenderMesh& renderMesh = meshes[drawList[batch.begin].index];
+				const MeshShaderHandles& h = *batch.handles;
+
+				cmd.SetMat4Parameter(shader, h.MVP, VP * renderMesh.worldTransformMat);
+				cmd.SetMat4Parameter(shader, h.MVP_prev, VP_Prev * renderMesh.worldTransformMatPrev);
+				cmd.SetMat4Parameter(shader, h.M, renderMesh.worldTransformMat);
+				cmd.SetMat4Parameter(shader, h.NM, renderMesh.normalMat);
+
+				if (pass == PASS::ID)
+					cmd.SetUintParameter(shader, h.id, renderMesh.modelId);
+
+				cmd.FlushParameters(shader);
+				cmd.Draw(batch.mesh, 1);
+			}
+		}
+	};
 
-	for (size_t i = 0; i < objects; i++)
 	{
-		T *g = static_cast<T*>(RES_MAN->GetObject_(i));
-		addObjectsRecursive<T>(vec, g, type);
+		PROFILE_SCOPE("Render::drawMeshes record");
+		pool->ParallelFor(lists, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t list = begin; list < end; list++)
+				record(list);
+		});
 	}
+
+	{
+		PROFILE_SCOPE("Render::drawMeshes submit");
+		for (size_t list = 0; list < lists; list++)
+		{
+			drawCommandLists[list].Submit();
+
+			commandListStat.lists++;
+			commandListStat.commands += drawCommandLists[list].GetCommands();
+			commandListStat.bytes += drawCommandLists[list].GetBytes();
+		}
+	}
+
+	if (maxInstances)
+		CORE_RENDER->BindStructuredBuffer(INSTANCE_BUFFER_SLOT, nullptr);
 }
 
 static void process_shader(INPUT_ATTRUBUTE attrib, const vector<string>* defines, const char*& ppTextOut, const char* ppTextIn,
@@ -200,6 +468,8 @@ static void process_shader(INPUT_ATTRUBUTE attrib, const vector<string>* defines
 
 auto Render::GetShader(const char *name, Mesh *mesh, const vector<string>* defines, LOAD_SHADER_FLAGS flags) ->Shader*
 {
+	PROFILE_FUNCTION();
+
 	SharedPtr<Shader> shader;
 
 	INPUT_ATTRUBUTE attrib = INPUT_ATTRUBUTE::UNKNOWN;
@@ -209,6 +479,15 @@ auto Render::GetShader(const char *name, Mesh *mesh, const vector<string>* defin
 
 	string shaderKey = string(name) + '-';
 
+	vector<string> instancedDefines;
+	if (bool(flags & LS_INSTANCED))
+	{
+		if (defines)
+			instancedDefines = *defines;
+		instancedDefines.push_back("ENG_INSTANCED");
+		defines = &instancedDefines;
+	}
+
 	if (defines)
 		for(const string& def : *defines)
 			shaderKey += def;
@@ -331,6 +610,8 @@ auto DLLEXPORT Render::RenderGUI() -> void
 	if (!_core->IsProfiler())
 		return;
 
+	PROFILE_FUNCTION();
+
 	INPUT_ATTRUBUTE attribs = planeMesh.get()->GetAttributes();
 
 	Shader *shader = GetShader("font.hlsl");
@@ -350,59 +631,54 @@ auto DLLEXPORT Render::RenderGUI() -> void
 	CORE_RENDER->BindTextures(1, texs);
 	CORE_RENDER->SetDepthTest(0);
 
+	profilerText.Reset();
+	for (int i = 0; i < _core->ProfilerCallbacks(); i++)
+		_core->getCallback(i)->writeLines(profilerText);
+
+	glyphs.clear();
 	float offsetVert = 0.0f;
-	int lines = 0;
 
-	for (int i = 0; i < _core->ProfilerCallbacks(); i++)
+	for (uint i = 0; i < profilerText.GetNumLines(); i++)
 	{
-		IProfilerCallback *c = _core->getCallback(i);
+		float offset = 0.0f;
 
-		for (auto j = 0u; j < c->getNumLines(); j++)
+		for (const char *c = profilerText.GetLine(i); *c; c++)
 		{
-			if (lines >= records.size())
-				records.push_back(RenderProfileRecord());
-
-			RenderProfileRecord &r = records[lines];
+			uint8 id = static_cast<uint8>(*c);
+			float w = static_cast<float>(fontWidth[id]);
 
-			string line = c->getString(j);
+			charr g{};
+			g.data[0] = w;
+			g.data[1] = offset;
+			g.data[2] = offsetVert;
+			g.id = id;
+			glyphs.push_back(g);
 
-			if (line.size() > 0)
-			{
-				// recreate buffer
-				if (!r.buffer || r.length < line.size())
-				{
-					r.length = line.size();
-					r.buffer = RES_MAN->CreateStructuredBuffer((uint)r.length * sizeof(charr), sizeof(charr), BUFFER_USAGE::CPU_WRITE);
-					r.bufferData = unique_ptr<charr[]>(new charr[r.length]);
-				}	
-
-				std::hash<string> hashFn;
-				size_t newHash = hashFn(line);
+			offset += w;
+		}
 
-				// upload data
-				if (newHash != r.txtHash)
-				{
-					float offset = 0.0f;
-					for (size_t i = 0u; i < line.size(); i++)
-					{
-						float w = static_cast<float>(fontWidth[line[i]]);
-						r.bufferData[i].data[0] = w;
-						r.bufferData[i].data[1] = offset;
-						r.bufferData[i].data[2] = offsetVert;
-						r.bufferData[i].id = static_cast<uint>(line[i]);
-						offset += w;
-					}
-					r.txtHash = newHash;
-					r.buffer->SetData(reinterpret_cast<uint8*>(&r.bufferData[0].data[0]), line.size() * sizeof(charr));
-				}
+		offsetVert -= 17.0f;
+	}
 
-				CORE_RENDER->BindStructuredBuffer(1, r.buffer.get());
-				CORE_RENDER->Draw(planeMesh.get(), (uint)line.size());
-			}
+	if (!glyphs.empty())
+	{
+		// grow buffer by doubling
+		if (glyphs.size() > glyphBufferCapacity)
+		{
+			glyphBufferCapacity = max(glyphs.size(), glyphBufferCapacity * 2);
+			glyphBuffer = RES_MAN->CreateStructuredBuffer((uint)glyphBufferCapacity * sizeof(charr), sizeof(charr), BUFFER_USAGE::CPU_WRITE);
+			glyphsUploaded.clear();
+		}
 
-			offsetVert -= 17.0f;
-			lines++;
+		// upload only changed text
+		if (glyphs.size() != glyphsUploaded.size() || memcmp(glyphs.data(), glyphsUploaded.data(), glyphs.size() * sizeof(charr)) != 0)
+		{
+			glyphBuffer->SetData(reinterpret_cast<uint8*>(glyphs.data()), glyphs.size() * sizeof(charr));
+			glyphsUploaded = glyphs;
 		}
+
+		CORE_RENDER->BindStructuredBuffer(1, glyphBuffer.get());
+		CORE_RENDER->Draw(planeMesh.get(), (uint)glyphs.size());
 	}
 
 	CORE_RENDER->BindTextures(1, nullptr);
@@ -410,26 +686,50 @@ auto DLLEXPORT Render::RenderGUI() -> void
 	CORE_RENDER->SetDepthTest(1);
 }
 
-vector<Render::RenderMesh> Render::getRenderMeshes()
+void Render::getRenderMeshes(vector<RenderMesh>& out, vector<Model*> *notLoaded)
 {
-	vector<RenderMesh> meshesVec;
+	out.clear();
 
-	vector<Model*> models;
-	getObjects(models, OBJECT_TYPE::MODEL);
+	const RenderProxies::ModelArrays& models = RenderProxies::GetModels();
 
-	for (Model *model : models)
+	for (size_t i = 0; i < models.size(); i++)
 	{
-		if (!model->IsEnabled())
+		if (!(models.flags[i] & RenderProxies::ENABLED))
+			continue;
+
+		Model *model = models.model[i];
+
+		// loading creates GPU resources, it's for main thread
+		if (notLoaded && !model->IsMeshLoaded())
+		{
+			notLoaded->push_back(model);
 			continue;
+		}
 
-		Mesh *mesh = model->GetMesh();
+		Mesh *mesh = model->GetMesh(); // keeps stream resident
 
 		if (!mesh)
 			continue;
 
-		meshesVec.emplace_back(RenderMesh{model->GetId(), mesh, model->GetMaterial(), model, model->GetWorldTransform(), model->GetWorldTransformPrev()});
+		out.emplace_back(RenderMesh{model->GetId(), mesh, models.material[i], model, models.transform[i], models.transformPrev[i], models.normal[i]});
 	}
-	return meshesVec;
+}
+
+const vector<Render::RenderMesh>& Render::getVisibleMeshes(const RenderScene& scene, const mat4& VP)
+{
+	// models can be moved by frame pipeline thread
+	if (scene.culled)
+		return scene.visibleMeshes;
+
+	Model::CullModels(VP);
+
+	visibleMeshes.clear();
+
+	for (const RenderMesh& r : scene.meshes)
+		if (r.model->IsVisible())
+			visibleMeshes.push_back(r);
+
+	return visibleMeshes;
 }
 
 void Render::addLight(Light* l, std::vector<RenderLight>& tergetVec)
@@ -444,46 +744,49 @@ void Render::addLight(Light* l, std::vector<RenderLight>& tergetVec)
 	rl.id = l->GetId();
 }
 
-std::vector<Render::RenderLight> Render::getRenderAreaLights(vector<Light*> lights)
+void Render::getRenderAreaLights(vector<RenderLight>& out)
 {
-	std::vector<Render::RenderLight> ret;
+	out.clear();
 
-	for (Light* l : lights)
+	for (Light* l : RenderProxies::GetLights())
 	{
 		if (!l->IsEnabled() || l->GetLightType() != LIGHT_TYPE::AREA)
 			continue;
 
-		addLight(l, ret);
+		addLight(l, out);
 	}
-
-	return ret;
 }
 
-std::vector<Render::RenderLight> Render::getRenderLights(vector<Light*> lights)
+void Render::getRenderLights(vector<RenderLight>& out)
 {
-	std::vector<Render::RenderLight> ret;
+	out.clear();
 
-	for (Light* l : lights)
+	for (Light* l : RenderProxies::GetLights())
 	{
 		if (!l->IsEnabled())
 			continue;
 
-		addLight(l, ret);
+		addLight(l, out);
 	}
-
-	return ret;
 }
 
-Render::RenderScene Render::getRenderScene()
+Render::RenderScene& Render::getRenderScene()
 {
-	RenderScene scene;
-	scene.meshes = getRenderMeshes();
+	if (frameSnapshot)
+		return *frameSnapshot;
 
-	vector<Light*> lights;
-	getObjects(lights, OBJECT_TYPE::LIGHT);
+	extractRenderScene(renderScene, nullptr);
+	return renderScene;
+}
 
-	scene.lights = getRenderLights(lights);
-	scene.areaLights = getRenderAreaLights(lights);
+void Render::extractRenderScene(RenderScene& scene, vector<Model*> *notLoaded)
+{
+	PROFILE_FUNCTION();
+
+	getRenderMeshes(scene.meshes, notLoaded);
+	getRenderLights(scene.lights);
+	getRenderAreaLights(scene.areaLights);
+	scene.culled = false;
 
 	//for (Light *l : lights)
 	//{
@@ -510,42 +813,119 @@ Render::RenderScene Render::getRenderScene()
 		scene.sun_direction = scene.lights[0].worldDirection;
 	else
 		scene.sun_direction = vec4(0, 0, 1, 0);
+}
 
-	return scene;
+void Render::ExtractFrame(const Engine::CameraData& camera)
+{
+	PROFILE_FUNCTION();
+
+	TransformSystem::Update();
+
+	RenderScene& scene = pipelinedScenes[extractedScene];
+	extractRenderScene(scene, &pendingMeshes);
+
+	// culling reads models, so it's done here without jitter of render path
+	Model::CullModels(camera.ProjMat * camera.ViewMat);
+
+	scene.visibleMeshes.clear();
+	for (const RenderMesh& r : scene.meshes)
+		if (r.model->IsVisible())
+			scene.visibleMeshes.push_back(r);
+
+	scene.culled = true;
+	scene.camera = camera;
+}
+
+auto Render::PublishFrame() -> const Engine::CameraData&
+{
+	// meshes are drawn since next extraction
+	for (Model *m : pendingMeshes)
+		m->GetMesh();
+	pendingMeshes.clear();
+
+	frameSnapshot = &pipelinedScenes[extractedScene];
+	extractedScene ^= 1;
+
+	return frameSnapshot->camera;
+}
+
+void Render::StopPipelining()
+{
+	frameSnapshot = nullptr;
+	pendingMeshes.clear();
 }
 
 auto DLLEXPORT Render::DrawMeshes(PASS pass, const mat4& VP) -> void
 {
-	vector<RenderMesh> meshes = getRenderMeshes();
-	drawMeshes(pass, meshes, VP, VP);
+	static vector<RenderMesh> meshes;
+	static vector<RenderLight> areaLights;
 
-	vector<Light*> lights;
-	getObjects(lights, OBJECT_TYPE::LIGHT);
+	getRenderMeshes(meshes);
+	drawMeshes(pass, meshes, VP, VP);
 
-	vector<RenderLight> areaLights = getRenderAreaLights(lights);
+	getRenderAreaLights(areaLights);
 	draw_AreaLightEmblems(areaLights, VP, pass);
 }
 
-auto DLLEXPORT Render::GetRenderTexture(uint width, uint height, TEXTURE_FORMAT format, int msaaSamples, TEXTURE_TYPE type, bool mips) -> Texture *
+void Render::BenchmarkDrawPreparation(const Engine::CameraData& camera, uint objects, uint frames)
 {
-	auto it = std::find_if(renderTextures.begin(), renderTextures.end(),
-		[width, height, format, msaaSamples](const RenderTexture& tex)
-		{
-			return tex.free && width == tex.width && height == tex.height && format == tex.format && msaaSamples == tex.msaaSamples;
-		});
+	static vector<RenderMesh> sceneMeshes;
+	getRenderMeshes(sceneMeshes);
 
-	if (it != renderTextures.end())
+	if (sceneMeshes.empty() || !objects || !frames)
 	{
-		it->free = 0;
-		it->frame = _core->frame();
-		return it->pointer.get();
+		LogWarning("Render::BenchmarkDrawPreparation(): scene has no meshes");
+		return;
 	}
 
+	vector<RenderMesh> meshes(objects);
+	for (uint i = 0; i < objects; i++)
+		meshes[i] = sceneMeshes[i % sceneMeshes.size()];
+
+	const mat4 VP = camera.ProjMat * camera.ViewMat;
+	const uint maxLists = _core->GetThreadPool()->GetWorkers() + 1;
+
+	typedef std::chrono::high_resolution_clock clock;
+
+	Log("Render::BenchmarkDrawPreparation(): %u objects, %u frames, %s", objects, frames, CORE_RENDER->GetName());
+
+	double oneListMs = 0.0;
+
+	for (uint lists = 1;; lists = min(lists * 2, maxLists))
+	{
+		drawCommandListsLimit = lists;
+
+		// first call creates shaders and buffers
+		drawMeshes(PASS::DEFERRED, meshes, VP, VP);
+
+		vector<double> ms(frames);
+		for (uint i = 0; i < frames; i++)
+		{
+			clock::time_point t = clock::now();
+			drawMeshes(PASS::DEFERRED, meshes, VP, VP);
+			ms[i] = std::chrono::duration<double, std::milli>(clock::now() - t).count();
+		}
+
+		std::sort(ms.begin(), ms.end());
+		if (lists == 1)
+			oneListMs = ms[frames / 2];
+
+		Log("  %u lists: median %.3f ms, min %.3f ms, speedup %.2fx", lists, ms[frames / 2], ms[0], oneListMs / ms[frames / 2]);
+
+		if (lists == maxLists)
+			break;
+	}
+
+	drawCommandListsLimit = 0;
+}
+
+static SharedPtr<Texture> createRenderTarget(const RenderTargetDesc& desc)
+{
 	TEXTURE_CREATE_FLAGS flags = TEXTURE_CREATE_FLAGS::USAGE_RENDER_TARGET | TEXTURE_CREATE_FLAGS::COORDS_WRAP | TEXTURE_CREATE_FLAGS::FILTER_TRILINEAR;
-	if (mips)
+	if (desc.mips)
 		flags = flags | TEXTURE_CREATE_FLAGS::GENERATE_MIPMAPS;
 
-	switch (msaaSamples)
+	switch (desc.msaaSamples)
 	{
 		case 0:
 		case 1: break;
@@ -555,17 +935,23 @@ auto DLLEXPORT Render::GetRenderTexture(uint width, uint height, TEXTURE_FORMAT
 		default: LogWarning("Render::GetRenderTexture(): Unknown number of MSAA samples"); break;
 	}
 
-	SharedPtr<Texture> tex = RES_MAN->CreateTexture(width, height, type, format, flags);
-
-	renderTextures.push_back({_core->frame(), 0, width, height, format, msaaSamples, tex });
+	return RES_MAN->CreateTexture(desc.width, desc.height, desc.type, desc.format, flags);
+}
 
-	return tex.get();
+auto DLLEXPORT Render::GetRenderTexture(uint width, uint height, TEXTURE_FORMAT format, int msaaSamples, TEXTURE_TYPE type, bool mips) -> Texture *
+{
+	return renderTargets.Acquire({width, height, format, msaaSamples, type, mips});
 }
 
 auto DLLEXPORT Render::ReleaseRenderTexture(Texture* tex) -> void
 {
 	if (!tex) return;
-	std::for_each(renderTextures.begin(), renderTextures.end(), [tex](RenderTexture& t) { if (tex == t.pointer.get()) t.free = 1; });
+	renderTargets.Release(tex);
+}
+
+auto Render::GetRenderTargetPool() -> RenderTargetPool*
+{
+	return &renderTargets;
 }
 
 auto DLLEXPORT Render::SetEnvironmentTexturePath(const char* path) -> void
@@ -600,6 +986,11 @@ auto DLLEXPORT Render::SetRenderPath(RENDER_PATH type) -> void
 
 void Render::RenderFrame(size_t viewID, const Engine::CameraData& camera, Model** wireframeModels, int modelsNum)
 {
+	PROFILE_FUNCTION();
+
+	if (!frameSnapshot)
+		TransformSystem::Update(); // objects could be moved after ResourceManager::Update()
+
 	renderpath->FrameBegin(viewID, camera, wireframeModels, modelsNum);
 	renderpath->RenderFrame();
 	renderpath->FrameEnd();
@@ -632,24 +1023,13 @@ Texture* Render::GetPrevRenderTexture(PREV_TEXTURES id, uint width, uint height,
 
 void Render::ExchangePrevRenderTexture(Texture* prev, Texture* some)
 {
-	int renderTex = -1;
 	int prevTex = -1;
 
-	for (auto i = 0; i < renderTextures.size(); i++)
-		if (renderTextures[i].pointer.get() == some)
-			renderTex = i;
-
 	for (auto i = 0; i < prevRenderTextures.size(); i++)
 		if (prevRenderTextures[i].pointer.get() == prev)
 			prevTex = i;
 
-	if (renderTex != -1 && prevTex != -1)
-	{
-		SharedPtr<Texture> ptr = renderTextures[renderTex].pointer;
-		renderTextures[renderTex].pointer = prevRenderTextures[prevTex].pointer;
-		prevRenderTextures[prevTex].pointer = ptr;
-	}
-	else
+	if (prevTex == -1 || !renderTargets.Exchange(some, prevRenderTextures[prevTex].pointer))
 		LogWarning("ExchangePrevRenderTexture(): unable find textures");
 }
 
@@ -774,14 +1154,11 @@ uint32 Render::readbackFrameID()
 	return uint32_t((_core->frame() > (int64_t)maxFrames ? _core->frame() - 3 : 0) % maxFrames);;
 }
 
-uint Render::getNumLines()
+void Render::writeLines(TextArena& out)
 {
-	return renderpath->getNumLines();
-}
-
-std::string Render::getString(uint i)
-{
-	return renderpath->getString(i);
+	renderpath->writeLines(out);
+	out.AddLine("Render targets: %.1f MB, %u textures", renderTargets.GetAllocatedBytes() / (1024.0f * 1024.0f), (uint)renderTargets.GetNumTextures());
+	out.AddLine("Command lists: %u, %u commands, %.1f KB", lastCommandListStat.lists, lastCommandListStat.commands, lastCommandListStat.bytes / 1024.0f);
 }
 
 void Render::Init()
@@ -794,6 +1171,8 @@ void Render::Init()
 	gridMesh = RES_MAN->CreateStreamMesh("std#grid");
 	lineMesh = RES_MAN->CreateStreamMesh("std#line");
 
+	RenderProxies::Init();
+
 	uint8 data[4] = {255u, 255u, 255u, 255u};
 	whiteTexture = new Texture(unique_ptr<ICoreTexture>(CORE_RENDER->CreateTexture(&data[0], 1, 1, TEXTURE_TYPE::TYPE_2D, TEXTURE_FORMAT::RGBA8, TEXTURE_CREATE_FLAGS::NONE, false)));
 	assert(whiteTexture);
@@ -805,6 +1184,12 @@ void Render::Init()
 
 	_core->AddProfilerCallback(this);
 
+	renderTargets.Init(createRenderTarget);
+
+	RES_MAN->AddCallbackShaderDestroyed(onShaderDestroyed);
+
+	// Held until Free() rather than released per frame: its contents are cached by atmosphereHash,
+	// and an acquired target is never handed out to anyone else by the pool
 	environmentAtmosphere = GetRenderTexture(environmentCubemapSize, environmentCubemapSize, TEXTURE_FORMAT::RGBA16F, 1, TEXTURE_TYPE::TYPE_CUBE, true);
 	blackCubemapTexture = new Texture(unique_ptr<ICoreTexture>(CORE_RENDER->CreateTexture(nullptr, 1, 1, TEXTURE_TYPE::TYPE_CUBE, TEXTURE_FORMAT::RGBA8, TEXTURE_CREATE_FLAGS::NONE, false)));
 
@@ -817,12 +1202,11 @@ void Render::Init()
 
 void Render::Update()
 {
-	renderTextures.erase(std::remove_if(renderTextures.begin(), renderTextures.end(),
-	[&](const RenderTexture& r) -> bool
-	{
-		return r.free == 1 && (_core->frame() - r.frame) > 3;
-	}),
-	renderTextures.end());
+	PROFILE_FUNCTION();
+
+	RenderProxies::BeginFrame();
+
+	renderTargets.BeginFrame(_core->frame());
 
 	prevRenderTextures.erase(std::remove_if(prevRenderTextures.begin(), prevRenderTextures.end(),
 	[&](const RenderTexture& r) -> bool
@@ -832,10 +1216,22 @@ void Render::Update()
 	prevRenderTextures.end());
 
 	renderVectors.clear();
+
+	lastCommandListStat = commandListStat;
+	commandListStat = CommandListStat();
 }
 
 void Render::Free()
 {
+	RES_MAN->RemoveCallbackShaderDestroyed(onShaderDestroyed);
+	meshShaderHandles.clear();
+	RenderProxies::Free();
+	renderScene = RenderScene();
+	pipelinedScenes[0] = RenderScene();
+	pipelinedScenes[1] = RenderScene();
+	StopPipelining();
+	visibleMeshes.clear();
+
 	delete realtimeObj;
 	realtimeObj = nullptr;
 
@@ -846,13 +1242,20 @@ void Render::Free()
 	delete whiteTexture;
 	delete blackCubemapTexture;
 	environmentHDRI.release();
-	records.clear();
+	glyphBuffer = nullptr;
+	glyphBufferCapacity = 0;
+	glyphs.clear();
+	glyphsUploaded.clear();
+	instanceBuffer = nullptr;
+	instanceBufferElements = 0;
+	drawBatches.clear();
+	drawCommandLists.clear();
 	lineMesh.release();
 	fontTexture.release();
 	planeMesh.release();
 	gridMesh.release();
 	runtimeShaders.clear();
-	renderTextures.clear();
+	renderTargets.Free();
 	prevRenderTextures.clear();
 }
 
@@ -862,7 +1265,9 @@ uint32_t Render::RenderScene::getHash()
 	constexpr size_t approxLightSize = sizeof(mat4);
 	size_t approxSize = approxMeshSize * meshes.size() + approxLightSize * lights.size();
 	
-	vector<uint8_t> data(approxSize);
+	static vector<uint8_t> data;
+	data.reserve(approxSize);
+	data.resize(1);
 	size_t len = 1;
 
 	auto addData = [&len, &data](const void* src, size_t srcLen)
@@ -892,5 +1297,5 @@ uint32_t Render::RenderScene::getHash()
 		addData(&l.intensity, sizeof(float));
 	}
 
-	return crc.update(data.data(), data.size());
+	return crc32::update(data.data(), data.size());
 }
@@ -0,0 +1,336 @@
+#include "pch.h"
+#include "render_graph.h"
+#include "core.h"
+#include "cpu_profiler.h"
+#include "texture.h"
+#include "icorerender.h"
+#include <climits>
+
+#define RENDER_TARGET_KEEP_FRAMES 3
+
+size_t RenderTargetDesc::Hasher::operator()(const RenderTargetDesc& d) const
+{
+	uint64_t h = (uint64_t)d.width | (uint64_t)d.height << 16 | (uint64_t)d.format << 32 | (uint64_t)d.msaaSamples << 40 | (uint64_t)d.type << 48 | (uint64_t)d.mips << 56;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return (size_t)h;
+}
+
+auto RenderTargetDesc::Bytes() const -> size_t
+{
+	size_t b = (size_t)width * height * bytesPerPixel(format) * max(msaaSamples, 1);
+	if (type == TEXTURE_TYPE::TYPE_CUBE)
+		b *= 6;
+	if (mips)
+		b = b * 4 / 3;
+	return b;
+}
+
+void RenderTargetPool::Init(CreateCallback c)
+{
+	create = c;
+}
+
+void RenderTargetPool::Free()
+{
+	entries.clear();
+	freeLists.clear();
+	resolutions.clear();
+	resolutionsPrev.clear();
+	bytes = 0;
+}
+
+void RenderTargetPool::destroy(Texture *tex)
+{
+	auto it = entries.find(tex);
+	bytes -= it->second.desc.Bytes();
+	entries.erase(it);
+}
+
+void RenderTargetPool::BeginFrame(int64_t frame_)
+{
+	frame = frame_;
+	resolutionsPrev.swap(resolutions);
+	resolutions.clear();
+
+	for (auto list = freeLists.begin(); list != freeLists.end();)
+	{
+		const RenderTargetDesc& desc = list->first;
+		bool resolutionUsed = std::find(resolutionsPrev.begin(), resolutionsPrev.end(), std::make_pair(desc.width, desc.height)) != resolutionsPrev.end();
+
+		vector<Texture*>& free = list->second;
+
+		for (size_t i = 0; i < free.size();)
+		{
+			Texture *tex = free[i];
+
+			if (resolutionUsed && frame - entries[tex].frame <= RENDER_TARGET_KEEP_FRAMES)
+			{
+				i++;
+				continue;
+			}
+
+			destroy(tex);
+			free[i] = free.back();
+			free.pop_back();
+		}
+
+		if (free.empty())
+			list = freeLists.erase(list);
+		else
+			++list;
+	}
+}
+
+auto RenderTargetPool::Acquire(const RenderTargetDesc& desc) -> Texture*
+{
+	auto res = std::make_pair(desc.width, desc.height);
+	if (std::find(resolutions.begin(), resolutions.end(), res) == resolutions.end())
+		resolutions.push_back(res);
+
+	vector<Texture*>& free = freeLists[desc];
+
+	if (!free.empty())
+	{
+		Texture *tex = free.back();
+		free.pop_back();
+
+		Entry& e = entries[tex];
+		e.free = false;
+		e.frame = frame;
+		return tex;
+	}
+
+	SharedPtr<Texture> tex = create(desc);
+	entries[tex.get()] = {desc, tex, frame, false};
+	bytes += desc.Bytes();
+	created++;
+
+	return tex.get();
+}
+
+void RenderTargetPool::Release(Texture *tex)
+{
+	auto it = entries.find(tex);
+	if (it == entries.end() || it->second.free)
+		return;
+
+	it->second.free = true;
+	freeLists[it->second.desc].push_back(tex);
+}
+
+auto RenderTargetPool::Exchange(Texture *pooled, SharedPtr<Texture>& other) -> bool
+{
+	auto it = entries.find(pooled);
+	if (it == entries.end())
+		return false;
+
+	Entry e = it->second;
+	entries.erase(it);
+
+	std::swap(e.texture, other);
+	Texture *tex = e.texture.get();
+
+	if (e.free)
+	{
+		vector<Texture*>& free = freeLists[e.desc];
+		*std::find(free.begin(), free.end(), pooled) = tex;
+	}
+
+	entries[tex] = std::move(e);
+	return true;
+}
+
+void RenderGraph::Reset(RenderTargetPool *pool_)
+{
+	assert(acquired.empty());
+
+	pool = pool_;
+	resources.clear();
+	passes.clear();
+	uses.clear();
+	compiled = false;
+}
+
+auto RenderGraph::Create(const char *name, const RenderTargetDesc& desc) -> Resource
+{
+	resources.push_back({name, desc, nullptr, false, INT_MAX, -1});
+	return (Resource)resources.size() - 1;
+}
+
+auto RenderGraph::Import(const char *name, Texture *tex) -> Resource
+{
+	resources.push_back({name, RenderTargetDesc(), tex, true, INT_MAX, -1});
+	return (Resource)resources.size() - 1;
+}
+
+void RenderGraph::AddPass(const char *name, std::initializer_list<Resource> reads, std::initializer_list<Resource> writes, std::function<void()> execute)
+{
+	uint begin = (uint)uses.size();
+
+	for (Resource r : reads)
+		if (r != NONE)
+			uses.push_back(r);
+
+	for (Resource r : writes)
+		if (r != NONE)
+			uses.push_back(r);
+
+	passes.push_back({name, begin, (uint)uses.size(), std::move(execute)});
+}
+
+void RenderGraph::Compile()
+{
+	for (int p = 0; p < (int)passes.size(); p++)
+	{
+		for (uint u = passes[p].usesBegin; u < passes[p].usesEnd; u++)
+		{
+			ResourceInfo& r = resources[uses[u]];
+			r.firstPass = min(r.firstPass, p);
+			r.lastPass = max(r.lastPass, p);
+		}
+	}
+
+	// Resources are created in order of passes, so walk passes and
+	// return textures of finished resources to a local free list before assigning new ones.
+	// Textures are returned to pool only after Execute(), pool can be used by passes.
+	vector<Texture*> freeTextures;
+	vector<RenderTargetDesc> freeDescs;
+
+	active.clear();
+	size_t liveBytes = 0;
+	peakBytes = 0;
+	transientBytes = 0;
+	physicalTextures = 0;
+
+	for (int p = 0; p < (int)passes.size(); p++)
+	{
+		for (size_t i = 0; i < active.size();)
+		{
+			ResourceInfo& r = resources[active[i]];
+			if (r.lastPass >= p)
+			{
+				i++;
+				continue;
+			}
+
+			freeTextures.push_back(r.texture);
+			freeDescs.push_back(r.desc);
+			liveBytes -= r.desc.Bytes();
+
+			active[i] = active.back();
+			active.pop_back();
+		}
+
+		for (Resource id = 0; id < (Resource)resources.size(); id++)
+		{
+			ResourceInfo& r = resources[id];
+			if (r.imported || r.firstPass != p)
+				continue;
+
+			auto it = std::find(freeDescs.begin(), freeDescs.end(), r.desc);
+			if (it != freeDescs.end())
+			{
+				size_t i = it - freeDescs.begin();
+				r.texture = freeTextures[i];
+				freeTextures.erase(freeTextures.begin() + i);
+				freeDescs.erase(it);
+			}
+			else
+			{
+				r.texture = pool->Acquire(r.desc);
+				acquired.push_back(r.texture);
+				physicalTextures++;
+			}
+
+			active.push_back(id);
+			liveBytes += r.desc.Bytes();
+			transientBytes += r.desc.Bytes();
+			peakBytes = max(peakBytes, liveBytes);
+		}
+	}
+
+	compiled = true;
+}
+
+void RenderGraph::Execute()
+{
+	assert(compiled);
+
+	for (Pass& p : passes)
+	{
+		CpuProfiler::Zone zone(p.name);
+		p.execute();
+	}
+
+	for (Texture *tex : acquired)
+		pool->Release(tex);
+
+	acquired.clear();
+}
+
+auto RenderGraph::GetTexture(Resource r) const -> Texture*
+{
+	return r == NONE ? nullptr : resources[r].texture;
+}
+
+bool CheckRenderGraph()
+{
+	bool ok = true;
+	auto check = [&ok](bool passed, const char *what)
+	{
+		if (!passed)
+		{
+			LogCritical("CheckRenderGraph(): %s", what);
+			ok = false;
+		}
+	};
+
+	// textures without core texture, only their addresses are used
+	RenderTargetPool pool;
+	pool.Init([](const RenderTargetDesc&) { return SharedPtr<Texture>(new Texture(std::unique_ptr<ICoreTexture>())); });
+
+	const RenderTargetDesc ldr{64, 64, TEXTURE_FORMAT::RGBA8};
+	const RenderTargetDesc hdr{64, 64, TEXTURE_FORMAT::RGBA16F};
+
+	// chain a -> b -> c -> d: c can take texture of a, b and d are live with their neighbours
+	RenderGraph graph;
+	for (int64_t frame = 0; frame < 2; frame++)
+	{
+		pool.BeginFrame(frame);
+		graph.Reset(&pool);
+
+		RenderGraph::Resource a = graph.Create("a", ldr);
+		RenderGraph::Resource b = graph.Create("b", hdr);
+		RenderGraph::Resource c = graph.Create("c", ldr);
+		RenderGraph::Resource d = graph.Create("d", ldr);
+		RenderGraph::Resource unused = graph.Create("unused", ldr);
+
+		std::string order;
+		graph.AddPass("0", {}, {a}, [&order]() { order += '0'; });
+		graph.AddPass("1", {a}, {b}, [&order]() { order += '1'; });
+		graph.AddPass("2", {b}, {c}, [&order]() { order += '2'; });
+		graph.AddPass("3", {c}, {d}, [&order]() { order += '3'; });
+		graph.Compile();
+
+		check(graph.GetTexture(a) && graph.GetTexture(a) == graph.GetTexture(c), "targets with disjoint lifetimes are not aliased");
+		check(graph.GetTexture(a) != graph.GetTexture(d) && graph.GetTexture(c) != graph.GetTexture(d), "targets with overlapping lifetimes are aliased");
+		check(!graph.GetTexture(unused), "unused target is allocated");
+		check(graph.GetNumPhysicalTextures() == 3, "wrong number of physical textures");
+		check(graph.GetTransientBytes() == 3 * ldr.Bytes() + hdr.Bytes(), "wrong transient bytes");
+		check(graph.GetPeakBytes() == ldr.Bytes() + hdr.Bytes(), "wrong peak bytes");
+
+		graph.Execute();
+		check(order == "0123", "passes are not executed in order");
+	}
+
+	// second frame gets textures released by the first one
+	check(pool.GetNumCreated() == 3, "pool creates textures instead of reusing free ones");
+	check(pool.GetAllocatedBytes() == 2 * ldr.Bytes() + hdr.Bytes(), "wrong pool bytes");
+
+	pool.Free();
+
+	Log("CheckRenderGraph(): %s", ok ? "passed" : "failed");
+	return ok;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "common.h"
+
+struct RenderTargetDesc
+{
+	uint width{0};
+	uint height{0};
+	TEXTURE_FORMAT format{TEXTURE_FORMAT::RGBA8};
+	int msaaSamples{0};
+	TEXTURE_TYPE type{TEXTURE_TYPE::TYPE_2D};
+	bool mips{false};
+
+	bool operator==(const RenderTargetDesc& r) const
+	{
+		return width == r.width && height == r.height && format == r.format && msaaSamples == r.msaaSamples && type == r.type && mips == r.mips;
+	}
+
+	struct Hasher
+	{
+		size_t operator()(const RenderTargetDesc& d) const;
+	};
+
+	auto Bytes() const -> size_t;
+};
+
+//
+// Physical render targets with free lists hashed by descriptor.
+// Textures are created by callback, so allocation logic works without GPU.
+// Free textures of resolutions requested in previous frame are kept for a few frames,
+// free textures of other resolutions (e.g. old viewport size) are destroyed at once.
+//
+class RenderTargetPool
+{
+public:
+	typedef std::function<SharedPtr<Texture>(const RenderTargetDesc&)> CreateCallback;
+
+private:
+	struct Entry
+	{
+		RenderTargetDesc desc;
+		SharedPtr<Texture> texture;
+		int64_t frame; // last acquired
+		bool free;
+	};
+
+	CreateCallback create;
+	std::unordered_map<Texture*, Entry> entries;
+	std::unordered_map<RenderTargetDesc, vector<Texture*>, RenderTargetDesc::Hasher> freeLists;
+	vector<std::pair<uint, uint>> resolutions; // requested since BeginFrame()
+	vector<std::pair<uint, uint>> resolutionsPrev;
+	int64_t frame{0};
+	size_t bytes{0};
+	size_t created{0};
+
+	void destroy(Texture *tex);
+
+public:
+	void Init(CreateCallback c);
+	void Free();
+	void BeginFrame(int64_t frame_); // evicts unused free textures
+
+	auto Acquire(const RenderTargetDesc& desc) -> Texture*;
+	void Release(Texture *tex);
+	auto Exchange(Texture *pooled, SharedPtr<Texture>& other) -> bool; // swaps texture of entry with external one
+
+	auto GetAllocatedBytes() const -> size_t { return bytes; }
+	auto GetNumTextures() const -> size_t { return entries.size(); }
+	auto GetNumCreated() const -> size_t { return created; } // over all time
+};
+
+//
+// Transient render targets of one frame.
+// Passes declare targets they read and write. Compile() computes lifetime of each target
+// (first and last pass using it) and assigns physical textures: targets with equal descriptors
+// and non-overlapping lifetimes share one texture. Targets not used by any pass are not allocated.
+// Execute() runs passes in order and returns all textures to pool.
+//
+class RenderGraph
+{
+public:
+	typedef int Resource;
+	static constexpr Resource NONE = -1;
+
+private:
+	struct ResourceInfo
+	{
+		const char *name;
+		RenderTargetDesc desc;
+		Texture *texture;
+		bool imported;
+		int firstPass;
+		int lastPass;
+	};
+
+	struct Pass
+	{
+		const char *name;
+		uint usesBegin;
+		uint usesEnd;
+		std::function<void()> execute;
+	};
+
+	RenderTargetPool *pool{nullptr};
+	vector<ResourceInfo> resources;
+	vector<Pass> passes;
+	vector<Resource> uses; // reads and writes of all passes
+	vector<Resource> active; // temporary for Compile()
+	vector<Texture*> acquired;
+	size_t peakBytes{0};
+	size_t transientBytes{0};
+	uint physicalTextures{0};
+	bool compiled{false};
+
+public:
+	void Reset(RenderTargetPool *pool_);
+
+	auto Create(const char *name, const RenderTargetDesc& desc) -> Resource;
+	auto Import(const char *name, Texture *tex) -> Resource; // not managed by graph: surface, previous frame
+	void AddPass(const char *name, std::initializer_list<Resource> reads, std::initializer_list<Resource> writes, std::function<void()> execute);
+
+	void Compile();
+	void Execute();
+
+	auto GetTexture(Resource r) const -> Texture*; // valid after Compile()
+	auto GetFirstPass(Resource r) const -> int { return resources[r].firstPass; }
+	auto GetLastPass(Resource r) const -> int { return resources[r].lastPass; }
+
+	// Stats of last Compile()
+	auto GetPeakBytes() const -> size_t { return peakBytes; } // max memory of live targets over passes
+	auto GetTransientBytes() const -> size_t { return transientBytes; } // memory without aliasing
+	auto GetNumPhysicalTextures() const -> uint { return physicalTextures; }
+};
+
+bool CheckRenderGraph(); // GPU-free check of aliasing and memory stats on fake textures, false on failure
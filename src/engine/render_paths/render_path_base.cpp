@@ -87,9 +87,9 @@ void RenderPathBase::FrameBegin(size_t viewID, const Engine::CameraData& camera,
 
 	mats.ViewProjMat_ = mats.ProjMat_ * camera.ViewMat;
 	mats.ViewMat_ = camera.ViewMat;
-	mats.WorldPos_ = camera.ViewMat.Inverse().Column3(3);
+	mats.WorldPos_ = camera.ViewMat.InverseAffine().Column3(3);
 	mats.ViewProjInvMat_ = mats.ViewProjMat_.Inverse();
-	mats.ViewInvMat_ = mats.ViewMat_.Inverse();
+	mats.ViewInvMat_ = mats.ViewMat_.InverseAffine();
 	//
 
 	// Restore prev matricies
@@ -34,8 +34,7 @@ protected:
 public:
 	RenderPathBase();
 
-	virtual uint getNumLines() = 0;
-	virtual std::string getString(uint i) = 0;
+	virtual void writeLines(TextArena& out) = 0;
 	virtual void RenderFrame() = 0;
 
 	void FrameBegin(size_t viewID, const Engine::CameraData& camera, Model** wireframeModels, int modelsNum);
@@ -15,6 +15,16 @@ vector<string> defines{ "GROUP_DIM_X=16", "GROUP_DIM_Y=16" };
 
 RenderPathPathTracing* RenderPathPathTracing::instance;
 
+struct PreviewShaderHandles
+{
+	int MVP;
+	int M;
+	int NM;
+	int sun_dir;
+};
+
+static unordered_map<uint, PreviewShaderHandles> previewShaderHandles; // shader id -> handles
+
 void RenderPathPathTracing::onMaterialChanged(Material* mat)
 {
 	instance->needUploadMaterials = true;
@@ -27,6 +37,7 @@ RenderPathPathTracing::RenderPathPathTracing()
 
 	MaterialManager* mm = _core->GetMaterialManager();
 	mm->AddCallbackMaterialChanged(onMaterialChanged);
+	RES_MAN->AddCallbackShaderDestroyed(onShaderDestroyed);
 
 	pathtracingDrawMaterial = mm->CreateInternalMaterial("pathtracing_draw");
 	assert(pathtracingDrawMaterial);
@@ -35,18 +46,26 @@ RenderPathPathTracing::RenderPathPathTracing()
 	assert(pathtracingPreviewMaterial);
 }
 
-std::string RenderPathPathTracing::getString(uint i)
+void RenderPathPathTracing::onShaderDestroyed(uint shaderId)
 {
-	switch (i)
-	{
-		case 0: return "Draw GPU: " + std::to_string(drawMS); break;
-	}
-	return "";
+	previewShaderHandles.erase(shaderId);
+}
+
+RenderPathPathTracing::~RenderPathPathTracing()
+{
+	RES_MAN->RemoveCallbackShaderDestroyed(onShaderDestroyed);
+	previewShaderHandles.clear();
+	_core->GetMaterialManager()->RemoveCallbackMaterialChanged(onMaterialChanged);
+}
+
+void RenderPathPathTracing::writeLines(TextArena& out)
+{
+	out.AddLine("Draw GPU: %f", drawMS);
 }
 
-void drawMeshes(Material * pathtracingPreviewMaterial, std::vector<Render::RenderMesh>& meshes, mat4 VP, vec4 sun_dir)
+void drawMeshes(Material * pathtracingPreviewMaterial, const std::vector<Render::RenderMesh>& meshes, mat4 VP, vec4 sun_dir)
 {
-	for (Render::RenderMesh& renderMesh : meshes)
+	for (const Render::RenderMesh& renderMesh : meshes)
 	{
 		Shader* shader = pathtracingPreviewMaterial->GetForwardShader(renderMesh.mesh);
 		if (!shader)
@@ -54,14 +73,26 @@ void drawMeshes(Material * pathtracingPreviewMaterial, std::vector<Render::Rende
 
 		CORE_RENDER->SetShader(shader);
 
+		auto it = previewShaderHandles.find(shader->GetId());
+		if (it == previewShaderHandles.end())
+		{
+			PreviewShaderHandles h;
+			h.MVP = shader->GetParameterHandle("MVP");
+			h.M = shader->GetParameterHandle("M");
+			h.NM = shader->GetParameterHandle("NM");
+			h.sun_dir = shader->GetParameterHandle("sun_dir");
+			it = previewShaderHandles.emplace(shader->GetId(), h).first;
+		}
+		const PreviewShaderHandles& h = it->second;
+
 		mat4 MVP = VP * renderMesh.worldTransformMat;
 		mat4 M = renderMesh.worldTransformMat;
-		mat4 NM = M.Inverse().Transpose();
+		mat4 NM = renderMesh.normalMat;
 
-		shader->SetMat4Parameter("MVP", &MVP);
-		shader->SetMat4Parameter("M", &M);
-		shader->SetMat4Parameter("NM", &NM);
-		shader->SetVec4Parameter("sun_dir", &sun_dir);
+		shader->SetMat4Parameter(h.MVP, &MVP);
+		shader->SetMat4Parameter(h.M, &M);
+		shader->SetMat4Parameter(h.NM, &NM);
+		shader->SetVec4Parameter(h.sun_dir, &sun_dir);
 
 		shader->FlushParameters();
 
@@ -209,7 +240,7 @@ void RenderPathPathTracing::RenderFrame()
 {
 	Texture* color = render->GetPrevRenderTexture(PREV_TEXTURES::PATH_TRACING_HDR, width, height, TEXTURE_FORMAT::RGBA16F);
 
-	Render::RenderScene scene = render->getRenderScene();
+	Render::RenderScene& scene = render->getRenderScene();
 	uint32_t nextcrc = scene.getHash();
 
 	if (!out || out->GetHeight() != height || out->GetWidth() != width)
@@ -249,7 +280,8 @@ void RenderPathPathTracing::RenderFrame()
 		CORE_RENDER->Clear();
 		CORE_RENDER->SetDepthTest(1);
 
-		drawMeshes(pathtracingPreviewMaterial, scene.meshes, mats.ViewProjUnjitteredMat_, scene.sun_direction);
+		const vector<Render::RenderMesh>& visibleMeshes = render->getVisibleMeshes(scene, mats.ViewProjUnjitteredMat_);
+		drawMeshes(pathtracingPreviewMaterial, visibleMeshes, mats.ViewProjUnjitteredMat_, scene.sun_direction);
 	};
 
 	Texture* rts[1] = { CORE_RENDER->GetSurfaceColorTexture() };
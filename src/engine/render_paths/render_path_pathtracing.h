@@ -27,15 +27,16 @@ class RenderPathPathTracing : public RenderPathBase
 	uint32_t crc_{};
 
 	static void onMaterialChanged(Material* mat);
+	static void onShaderDestroyed(uint shaderId);
 
 	std::shared_ptr<RaytracingData> getScene(Render::RenderScene& scene, size_t triangles);
 	void fillGPUMaterial(GPUMaterial& out, Material* in);
 
 public:
 	RenderPathPathTracing();
+	~RenderPathPathTracing();
 
-	uint getNumLines() override {return 1;}
-	std::string getString(uint i) override;
+	void writeLines(TextArena& out) override;
 	void uploadScene(Render::RenderScene& scene);
 	void uploadMaterials(size_t mats);
 	void RenderFrame() override;
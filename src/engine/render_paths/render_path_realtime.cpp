@@ -20,71 +20,81 @@ RenderPathRealtime::RenderPathRealtime()
 
 }
 
-std::string RenderPathRealtime::getString(uint i)
+void RenderPathRealtime::writeLines(TextArena& out)
 {
-	switch (i)
-	{
-		case 0: return "Frame GPU: " + std::to_string(frameMs); break;
-		case 1: return "GBuffer GPU: " + std::to_string(gbufferMs); break;
-		case 2: return "Lights GPU: " + std::to_string(lightsMs); break;
-		case 3: return "Composite GPU: " + std::to_string(compositeMs); break;
-	}
-	return "";
+	out.AddLine("Frame GPU: %f", frameMs);
+	out.AddLine("GBuffer GPU: %f", gbufferMs);
+	out.AddLine("Lights GPU: %f", lightsMs);
+	out.AddLine("Composite GPU: %f", compositeMs);
+	out.AddLine("Targets peak: %.1f MB (%.1f MB without aliasing), %u textures",
+		graph.GetPeakBytes() / (1024.0f * 1024.0f), graph.GetTransientBytes() / (1024.0f * 1024.0f), graph.GetNumPhysicalTextures());
 }
 
 void RenderPathRealtime::RenderFrame()
 {
 	bool colorReprojection = render->GetViewMode() == VIEW_MODE::COLOR_REPROJECTION || render->IsTAA();
+	Shader* taaShader = render->IsTAA() ? render->GetShader("taa.hlsl", render->fullScreen()) : nullptr;
 
-	RenderBuffers buffers;
-	buffers.color = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RGBA8);
-	buffers.velocity = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RG16F);
-	buffers.depth = CORE_RENDER->GetSurfaceDepthTexture();
-	buffers.albedo = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RGBA8);
-	buffers.diffuseLight = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RGBA16F);
-	buffers.specularLight = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RGBA16F);
-	buffers.normal = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RGBA32F);
-	buffers.shading = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RGBA8);
-	if (colorReprojection)
-		buffers.colorReprojected = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RGBA8);
+	Render::RenderScene& scene = render->getRenderScene();
 
-	Texture* colorPrev = render->GetPrevRenderTexture(PREV_TEXTURES::COLOR, width, height, TEXTURE_FORMAT::RGBA8);
+	render->updateEnvirenment(scene);
 
-	Render::RenderScene scene = render->getRenderScene();
+	uint32 frameID_ = render->frameID();
+	uint32 readbackFrameID_ = render->readbackFrameID();
 
-	render->updateEnvirenment(scene);
+	// Targets
+	graph.Reset(render->GetRenderTargetPool());
 
-	// Sky velocity
-	if (Shader *shader = render->GetShader("sky_velocity.hlsl", render->fullScreen()))
-	{
-		CORE_RENDER->SetShader(shader);
+	auto target = [this](TEXTURE_FORMAT format) { return RenderTargetDesc{width, height, format}; };
 
-		CORE_RENDER->SetRenderTextures(1, &buffers.velocity, nullptr);
-		CORE_RENDER->Clear();
+	RenderGraph::Resource color = graph.Create("color", target(TEXTURE_FORMAT::RGBA8));
+	RenderGraph::Resource velocity = graph.Create("velocity", target(TEXTURE_FORMAT::RG16F));
+	RenderGraph::Resource albedo = graph.Create("albedo", target(TEXTURE_FORMAT::RGBA8));
+	RenderGraph::Resource diffuseLight = graph.Create("diffuse light", target(TEXTURE_FORMAT::RGBA16F));
+	RenderGraph::Resource specularLight = graph.Create("specular light", target(TEXTURE_FORMAT::RGBA16F));
+	RenderGraph::Resource normal = graph.Create("normal", target(TEXTURE_FORMAT::RGBA32F));
+	RenderGraph::Resource shading = graph.Create("shading", target(TEXTURE_FORMAT::RGBA8));
+	RenderGraph::Resource colorReprojected = colorReprojection ? graph.Create("color reprojected", target(TEXTURE_FORMAT::RGBA8)) : RenderGraph::NONE;
+	RenderGraph::Resource taaOut = taaShader ? graph.Create("taa", target(TEXTURE_FORMAT::RGBA8)) : RenderGraph::NONE;
+	RenderGraph::Resource depth = graph.Import("depth", CORE_RENDER->GetSurfaceDepthTexture());
+	RenderGraph::Resource colorPrev = graph.Import("color prev", render->GetPrevRenderTexture(PREV_TEXTURES::COLOR, width, height, TEXTURE_FORMAT::RGBA8));
 
-		mat4 m = prevMats.ViewMat_;
-		m.SetColumn3(3, vec3(0, 0, 0)); // remove translation
-		m = prevMats.ProjUnjitteredMat_ * prevMats.ViewMat_;
-		shader->SetMat4Parameter("VP_prev", &m);
+	RenderGraph::Resource finalColor = taaShader ? taaOut : color;
 
-		m = mats.ViewUnjitteredMat_;
-		m.SetColumn3(3, vec3(0, 0, 0));
-		m = mats.ProjUnjitteredMat_ * m;
-		m = m.Inverse();
-		shader->SetMat4Parameter("VP_inv", &m);
+	RenderGraph::Resource viewModeSource = RenderGraph::NONE;
+	switch (render->GetViewMode())
+	{
+		case VIEW_MODE::NORMAL: viewModeSource = normal; break;
+		case VIEW_MODE::ALBEDO: viewModeSource = albedo; break;
+		case VIEW_MODE::DIFFUSE_LIGHT: viewModeSource = diffuseLight; break;
+		case VIEW_MODE::SPECULAR_LIGHT: viewModeSource = specularLight; break;
+		case VIEW_MODE::VELOCITY: viewModeSource = velocity; break;
+		case VIEW_MODE::COLOR_REPROJECTION: viewModeSource = colorReprojected; break;
+		default: break;
+	}
 
-		shader->FlushParameters();
+	RenderBuffers buffers;
 
-		CORE_RENDER->Draw(render->fullScreen(), 1);
+	// Sky velocity
+	graph.AddPass("Sky velocity", {}, {velocity}, [&]()
+	{
+		if (Shader *shader = render->GetShader("sky_velocity.hlsl", render->fullScreen()))
+		{
+			CORE_RENDER->SetShader(shader);
 
-		CORE_RENDER->SetRenderTextures(1, nullptr, nullptr);
-	}
+			CORE_RENDER->SetRenderTextures(1, &buffers.velocity, nullptr);
+			CORE_RENDER->Clear();
 
-	uint32 frameID_ = render->frameID();
-	uint32 readbackFrameID_ = render->readbackFrameID();
+			shader->FlushParameters();
 
+			CORE_RENDER->Draw(render->fullScreen(), 1);
+
+			CORE_RENDER->SetRenderTextures(1, nullptr, nullptr);
+		}
+	});
 
 	// G-buffer
+	graph.AddPass("G-buffer", {}, {albedo, shading, normal, velocity, depth}, [&]()
 	{
 		CORE_RENDER->TimersBeginPoint(frameID_, Render::T_GBUFFER);
 
@@ -96,7 +106,8 @@ void RenderPathRealtime::RenderFrame()
 
 		CORE_RENDER->SetDepthTest(1);
 		{
-			render->drawMeshes(PASS::DEFERRED, scene.meshes, mats.ViewProjMat_, cameraPrevViewProjMatRejittered_);
+			const vector<Render::RenderMesh>& visibleMeshes = render->getVisibleMeshes(scene, mats.ViewProjMat_);
+			render->drawMeshes(PASS::DEFERRED, visibleMeshes, mats.ViewProjMat_, cameraPrevViewProjMatRejittered_);
 		}
 		CORE_RENDER->SetRenderTextures(4, nullptr, nullptr);
 
@@ -104,33 +115,35 @@ void RenderPathRealtime::RenderFrame()
 
 		CORE_RENDER->TimersEndPoint(frameID_, Render::T_GBUFFER);
 		gbufferMs = CORE_RENDER->GetTimeInMsForPoint(readbackFrameID_, Render::T_GBUFFER);
-	}
+	});
 
 	// Color reprojection
 	if (colorReprojection)
-	{
-		Shader* shader = render->GetShader("reprojection.hlsl", render->fullScreen());
-		if (shader)
+		graph.AddPass("Color reprojection", {colorPrev, velocity}, {colorReprojected}, [&]()
 		{
-			Texture* texs_rt[1] = { buffers.colorReprojected };
-			CORE_RENDER->SetRenderTextures(1, texs_rt, nullptr);
+			Shader* shader = render->GetShader("reprojection.hlsl", render->fullScreen());
+			if (shader)
+			{
+				Texture* texs_rt[1] = { buffers.colorReprojected };
+				CORE_RENDER->SetRenderTextures(1, texs_rt, nullptr);
 
-			Texture* texs[2] = { colorPrev, buffers.velocity };
-			CORE_RENDER->BindTextures(2, texs);
-			CORE_RENDER->SetShader(shader);
+				Texture* texs[2] = { graph.GetTexture(colorPrev), buffers.velocity };
+				CORE_RENDER->BindTextures(2, texs);
+				CORE_RENDER->SetShader(shader);
 
-			vec4 s((float)width, (float)height, 0, 0);
-			shader->SetVec4Parameter("bufer_size", &s);
-			shader->FlushParameters();
+				vec4 s((float)width, (float)height, 0, 0);
+				shader->SetVec4Parameter("bufer_size", &s);
+				shader->FlushParameters();
 
-			CORE_RENDER->Draw(render->fullScreen(), 1);
-			CORE_RENDER->BindTextures(2, nullptr);
+				CORE_RENDER->Draw(render->fullScreen(), 1);
+				CORE_RENDER->BindTextures(2, nullptr);
 
-			CORE_RENDER->SetRenderTextures(1, nullptr, nullptr);
-		}
-	}
+				CORE_RENDER->SetRenderTextures(1, nullptr, nullptr);
+			}
+		});
 
 	// Lights
+	graph.AddPass("Lights", {normal, shading, albedo, depth}, {diffuseLight, specularLight}, [&]()
 	{
 		CORE_RENDER->TimersBeginPoint(frameID_, Render::T_LIGHTS);
 
@@ -153,7 +166,7 @@ void RenderPathRealtime::RenderFrame()
 
 			for (Render::RenderLight& renderLight : scene.lights)
 			{
-				vec4 lightColor(renderLight.light->GetIntensity());
+				vec4 lightColor(renderLight.intensity);
 				vec4 dir = vec4(renderLight.worldDirection);
 
 				shader->SetVec4Parameter("light_color", &lightColor);
@@ -170,10 +183,10 @@ void RenderPathRealtime::RenderFrame()
 
 		CORE_RENDER->TimersEndPoint(frameID_, Render::T_LIGHTS);
 		lightsMs = CORE_RENDER->GetTimeInMsForPoint(readbackFrameID_, Render::T_LIGHTS);
-
-	}
+	});
 
 	// Composite
+	graph.AddPass("Composite", {albedo, normal, shading, diffuseLight, specularLight, depth}, {color}, [&]()
 	{
 		CORE_RENDER->TimersBeginPoint(frameID_, Render::T_COMPOSITE);
 
@@ -230,60 +243,64 @@ void RenderPathRealtime::RenderFrame()
 
 		CORE_RENDER->TimersEndPoint(frameID_, Render::T_COMPOSITE);
 		compositeMs = CORE_RENDER->GetTimeInMsForPoint(readbackFrameID_, Render::T_COMPOSITE);
-	}
+	});
 
 	// TAA
-	if (render->IsTAA())
-		if (Shader * shader = render->GetShader("taa.hlsl", render->fullScreen()))
+	if (taaShader)
+		graph.AddPass("TAA", {color, colorReprojected}, {taaOut}, [&]()
 		{
-			Texture* taaOut = render->GetRenderTexture(width, height, TEXTURE_FORMAT::RGBA8);
-
-			Texture* texs_rt[1] = { taaOut };
+			Texture* texs_rt[1] = { graph.GetTexture(taaOut) };
 			CORE_RENDER->SetRenderTextures(1, texs_rt, nullptr);
 
 			Texture* texs[2] = { buffers.color, buffers.colorReprojected };
 			CORE_RENDER->BindTextures(2, texs);
-			CORE_RENDER->SetShader(shader);
+			CORE_RENDER->SetShader(taaShader);
 
 			CORE_RENDER->Draw(render->fullScreen(), 1);
 			CORE_RENDER->BindTextures(2, nullptr);
 
 			CORE_RENDER->SetRenderTextures(1, nullptr, nullptr);
+		});
 
-			std::swap(taaOut, buffers.color);
-			render->ReleaseRenderTexture(taaOut);
-		}
-
-	// Restore default render target
-	Texture* rts[1] = { CORE_RENDER->GetSurfaceColorTexture() };
-	CORE_RENDER->SetRenderTextures(1, rts, CORE_RENDER->GetSurfaceDepthTexture());
-
-	// Final copy
+	// Final copy reads only color and buffer of current view mode,
+	// so G-buffer targets can be reused by passes after composite
+	graph.AddPass("Final", {finalColor, viewModeSource}, {}, [&]()
 	{
+		// Restore default render target
+		Texture* rts[1] = { CORE_RENDER->GetSurfaceColorTexture() };
+		CORE_RENDER->SetRenderTextures(1, rts, CORE_RENDER->GetSurfaceDepthTexture());
+
 		finalPostMaterial->SetDef("view_mode", (int)render->GetViewMode());
 
 		if (auto shader = finalPostMaterial->GetShader(render->fullScreen()))
 		{
 			constexpr int tex_count = 8;
-			Texture* texs[tex_count] = {
-				buffers.albedo,
-				buffers.normal,
-				buffers.shading,
-				buffers.diffuseLight,
-				buffers.specularLight,
-				buffers.velocity,
-				buffers.color,
-				colorReprojection ? buffers.colorReprojected : nullptr
-			};
-			int tex_bind = tex_count;
-			if (!colorReprojection) tex_bind--;
+			RenderGraph::Resource inputs[tex_count] = { albedo, normal, shading, diffuseLight, specularLight, velocity, finalColor, colorReprojected };
+
+			Texture* texs[tex_count];
+			for (int i = 0; i < tex_count; i++)
+				texs[i] = inputs[i] == finalColor || inputs[i] == viewModeSource ? graph.GetTexture(inputs[i]) : nullptr;
 
-			CORE_RENDER->BindTextures(tex_bind, texs);
+			CORE_RENDER->BindTextures(tex_count, texs);
 			CORE_RENDER->SetShader(shader);
 			CORE_RENDER->Draw(render->fullScreen(), 1);
-			CORE_RENDER->BindTextures(tex_bind, nullptr);
+			CORE_RENDER->BindTextures(tex_count, nullptr);
 		}
-	}
+	});
+
+	graph.Compile();
+
+	buffers.color = graph.GetTexture(color);
+	buffers.colorReprojected = graph.GetTexture(colorReprojected);
+	buffers.albedo = graph.GetTexture(albedo);
+	buffers.normal = graph.GetTexture(normal);
+	buffers.shading = graph.GetTexture(shading);
+	buffers.depth = graph.GetTexture(depth);
+	buffers.diffuseLight = graph.GetTexture(diffuseLight);
+	buffers.specularLight = graph.GetTexture(specularLight);
+	buffers.velocity = graph.GetTexture(velocity);
+
+	graph.Execute();
 
 	//renderGrid();
 
@@ -335,7 +352,7 @@ void RenderPathRealtime::RenderFrame()
 			if (!mesh)
 				continue;
 
-			meshes.emplace_back(RenderMesh{ m->GetId(), mesh, m->GetMaterial(), m->GetWorldTransform(), m->GetWorldTransformPrev() });
+			meshes.emplace_back(RenderMesh{ m->GetId(), mesh, m->GetMaterial(), m, m->GetWorldTransform(), m->GetWorldTransformPrev(), m->GetNormalMatrix() });
 		}
 
 		// render to MSAA RT + resolve
@@ -427,17 +444,7 @@ void RenderPathRealtime::RenderFrame()
 
 	render->RenderGUI();
 
-	buffers.depth = nullptr;
-	render->ReleaseRenderTexture(buffers.color);
-	render->ReleaseRenderTexture(buffers.albedo);
-	render->ReleaseRenderTexture(buffers.diffuseLight);
-	render->ReleaseRenderTexture(buffers.specularLight);
-	render->ReleaseRenderTexture(buffers.normal);
-	render->ReleaseRenderTexture(buffers.shading);
-	render->ReleaseRenderTexture(buffers.velocity);
-	if (colorReprojection)
-		render->ReleaseRenderTexture(buffers.colorReprojected);
-
-	render->ExchangePrevRenderTexture(colorPrev, buffers.color);
+	// targets are back in pool, final color becomes previous frame color
+	render->ExchangePrevRenderTexture(graph.GetTexture(colorPrev), graph.GetTexture(finalColor));
 }
 
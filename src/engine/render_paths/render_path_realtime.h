@@ -1,6 +1,7 @@
 #pragma once
 #include "common.h"
 #include "render_path_base.h"
+#include "render_graph.h"
 
 class RenderPathRealtime : public RenderPathBase
 {
@@ -11,6 +12,8 @@ class RenderPathRealtime : public RenderPathBase
 	Material* compositeMaterial{};
 	Material* finalPostMaterial{};
 
+	RenderGraph graph; // rebuilt every frame, keeps capacity
+
 	struct RenderBuffers
 	{
 		Texture* color;
@@ -27,7 +30,6 @@ class RenderPathRealtime : public RenderPathBase
 public:
 	RenderPathRealtime();
 
-	uint getNumLines() override {return 4;}
-	std::string getString(uint i) override;
+	void writeLines(TextArena& out) override;
 	void RenderFrame() override;
 };
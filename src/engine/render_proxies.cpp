@@ -0,0 +1,171 @@
+#include "pch.h"
+#include "render_proxies.h"
+#include "core.h"
+#include "resource_manager.h"
+#include "model.h"
+#include "light.h"
+
+static RenderProxies::ModelArrays models;
+static vector<Light*> lights;
+
+
+void RenderProxies::Add(GameObject *g)
+{
+	if (g->GetType() == OBJECT_TYPE::LIGHT)
+	{
+		Light *l = static_cast<Light*>(g);
+		if (std::find(lights.begin(), lights.end(), l) == lights.end())
+			lights.push_back(l);
+		return;
+	}
+
+	if (g->GetType() != OBJECT_TYPE::MODEL)
+		return;
+
+	Model *m = static_cast<Model*>(g);
+	if (m->renderProxy_ >= 0)
+		return;
+
+	m->renderProxy_ = (int)models.size();
+	models.model.push_back(m);
+	models.material.push_back(m->GetMaterial());
+	models.transform.push_back(m->GetWorldTransform());
+	models.transformPrev.push_back(m->GetWorldTransformPrev());
+	models.normal.push_back(m->GetNormalMatrix());
+	models.flags.push_back(m->IsEnabled() ? ENABLED : 0);
+}
+
+void RenderProxies::AddObjects(GameObject *const *objects, size_t num)
+{
+	models.model.reserve(models.size() + num);
+	models.material.reserve(models.size() + num);
+	models.transform.reserve(models.size() + num);
+	models.transformPrev.reserve(models.size() + num);
+	models.normal.reserve(models.size() + num);
+	models.flags.reserve(models.size() + num);
+
+	for (size_t i = 0; i < num; i++)
+		Add(objects[i]);
+}
+
+void RenderProxies::Remove(GameObject *g)
+{
+	if (g->GetType() == OBJECT_TYPE::LIGHT)
+	{
+		lights.erase(std::remove(lights.begin(), lights.end(), static_cast<Light*>(g)), lights.end());
+		return;
+	}
+
+	if (g->GetType() != OBJECT_TYPE::MODEL)
+		return;
+
+	Model *m = static_cast<Model*>(g);
+	int i = m->renderProxy_;
+	if (i < 0)
+		return;
+
+	// move last proxy to the hole
+	size_t last = models.size() - 1;
+	if ((size_t)i != last)
+	{
+		models.model[i] = models.model[last];
+		models.material[i] = models.material[last];
+		models.transform[i] = models.transform[last];
+		models.transformPrev[i] = models.transformPrev[last];
+		models.normal[i] = models.normal[last];
+		models.flags[i] = models.flags[last];
+		models.model[i]->renderProxy_ = i;
+	}
+
+	models.model.pop_back();
+	models.material.pop_back();
+	models.transform.pop_back();
+	models.transformPrev.pop_back();
+	models.normal.pop_back();
+	models.flags.pop_back();
+
+	m->renderProxy_ = -1;
+}
+
+void RenderProxies::addRecursive(GameObject *g)
+{
+	Add(g);
+
+	for (size_t i = 0; i < g->GetNumChilds(); i++)
+		addRecursive(g->GetChild(i));
+}
+
+void RenderProxies::Init()
+{
+	RES_MAN->AddCallbackOnObjAdded(Add);
+	RES_MAN->AddCallbackOnObjectsAdded(AddObjects);
+	RES_MAN->AddCallbackOnDestroy(Remove);
+
+	for (size_t i = 0; i < RES_MAN->GetNumObjects(); i++)
+		addRecursive(RES_MAN->GetObject_(i));
+}
+
+void RenderProxies::Free()
+{
+	RES_MAN->RemoveCallbackOnObjAdded(Add);
+	RES_MAN->RemoveCallbackOnObjectsAdded(AddObjects);
+	RES_MAN->RemoveCallbackOnObjDestroyed(Remove);
+
+	for (Model *m : models.model)
+		m->renderProxy_ = -1;
+
+	models = ModelArrays();
+	lights.clear();
+}
+
+void RenderProxies::BeginFrame()
+{
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		if (models.flags[i] & MOVED)
+		{
+			models.transformPrev[i] = models.transform[i];
+			models.flags[i] &= ~MOVED;
+		}
+	}
+}
+
+void RenderProxies::UpdateTransform(Model *m)
+{
+	if (m->renderProxy_ < 0)
+		return;
+
+	models.transform[m->renderProxy_] = m->GetWorldTransform();
+	models.normal[m->renderProxy_] = m->GetNormalMatrix();
+	models.flags[m->renderProxy_] |= MOVED;
+}
+
+void RenderProxies::UpdateMaterial(Model *m)
+{
+	if (m->renderProxy_ < 0)
+		return;
+
+	models.material[m->renderProxy_] = m->GetMaterial();
+}
+
+void RenderProxies::UpdateFlags(Model *m)
+{
+	if (m->renderProxy_ < 0)
+		return;
+
+	uint8_t& flags = models.flags[m->renderProxy_];
+	if (m->IsEnabled())
+		flags |= ENABLED;
+	else
+		flags &= ~ENABLED;
+}
+
+auto RenderProxies::GetModels() -> const ModelArrays&
+{
+	return models;
+}
+
+auto RenderProxies::GetLights() -> const std::vector<Light*>&
+{
+	return lights;
+}
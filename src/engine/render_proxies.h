@@ -0,0 +1,46 @@
+#pragma once
+#include "common.h"
+
+//
+// Flat registry of renderable objects.
+// Kept in sync by ResourceManager signals and object change hooks,
+// so per-frame scene extraction is a linear scan over dense arrays.
+//
+class RenderProxies
+{
+	static void addRecursive(GameObject *g);
+
+public:
+	enum FLAGS : uint8_t
+	{
+		ENABLED = 1 << 0,
+		MOVED = 1 << 1, // transform changed since last BeginFrame()
+	};
+
+	struct ModelArrays
+	{
+		std::vector<Model*> model;
+		std::vector<Material*> material;
+		std::vector<mat4> transform;
+		std::vector<mat4> transformPrev;
+		std::vector<mat4> normal; // transposed inverse of transform
+		std::vector<uint8_t> flags;
+
+		size_t size() const { return model.size(); }
+	};
+
+	static void Init(); // subscribes to ResourceManager and registers existing objects
+	static void Free();
+	static void BeginFrame();
+
+	static void Add(GameObject *g);
+	static void AddObjects(GameObject *const *objects, size_t num); // batch of loaded world
+	static void Remove(GameObject *g);
+
+	static void UpdateTransform(Model *m);
+	static void UpdateMaterial(Model *m);
+	static void UpdateFlags(Model *m);
+
+	static auto GetModels() -> const ModelArrays&;
+	static auto GetLights() -> const std::vector<Light*>&;
+};
@@ -9,11 +9,23 @@
 #include "core.h"
 #include "console.h"
 #include "yaml-cpp/yaml.h"
+#include "yaml.inl"
 #include "fbx.h"
 #include "images.h"
+#include "transform_system.h"
+#include "thread_pool.h"
+#include "object_registry.h"
+#include "scene_file.h"
+#include "scene_yaml_loader.h"
+#include "material_manager.h"
+#include "cpu_profiler.h"
+#include <filesystem>
 
 #define IMPORT_DIR ".import"
 #define UNLOAD_RESOURCE_FRAMES 10
+#define UNREFERENCED_RESOURCE_FRAMES 1 // extracted frame can be rendered after the next frame is started
+#define SCENE_BIN "scene.bin"
+#define SCENE_YAML "scene.yaml"
 
 using namespace YAML;
 
@@ -53,6 +65,8 @@ auto DLLEXPORT ResourceManager::CreateShader(const char *vert, const char *geom,
 {
 	auto removeShader = [](Shader* s)
 	{
+		if (s)
+			RES_MAN->onShaderDestroyed.Invoke(s->GetId());
 		shadersSet.erase(s);
 		delete s;
 	};
@@ -90,6 +104,8 @@ auto DLLEXPORT ResourceManager::CreateComputeShader(const char* compText) -> Sha
 {
 	auto removeShader = [](Shader* s)
 	{
+		if (s)
+			RES_MAN->onShaderDestroyed.Invoke(s->GetId());
 		shadersSet.erase(s);
 		delete s;
 	};
@@ -252,40 +268,14 @@ auto DLLEXPORT ResourceManager::AddCallbackOnObjAdded(ObjectCallback c) -> void
 	onObjectAdded.Add(c);
 }
 
-bool findRecursive(GameObject *root, int id, GameObject *&found)
+auto DLLEXPORT ResourceManager::FindObjectById(int id) -> GameObject*
 {
-	GameObject* ret;
-
-	if (root->GetId() == id)
-	{
-		found = root;
-		return true;
-	}
-
-	for (int i = 0; i<root->GetNumChilds(); i++)
-	{
-		if (findRecursive(root->GetChild(i), id, ret))
-		{
-			found = ret;
-			return true;
-		}
-	}
-
-	found = nullptr;
-	return false;
+	return ObjectRegistry::FindById(id);
 }
 
-auto DLLEXPORT ResourceManager::FindObjectById(int id) -> GameObject*
+auto DLLEXPORT ResourceManager::FindObjectByHandle(ObjectHandle h) -> GameObject*
 {
-	GameObject *ret;
-
-	for (int i = 0; i < rootObjectsVec.size(); i++)
-	{
-		if (findRecursive(rootObjectsVec[i], id, ret))
-			return ret;
-	}
-
-	return nullptr;
+	return ObjectRegistry::Get(h);
 }
 
 auto DLLEXPORT ResourceManager::RemoveCallbackOnObjAdded(ObjectCallback c) -> void
@@ -293,6 +283,16 @@ auto DLLEXPORT ResourceManager::RemoveCallbackOnObjAdded(ObjectCallback c) -> vo
 	onObjectAdded.Erase(c);
 }
 
+auto DLLEXPORT ResourceManager::AddCallbackOnObjectsAdded(ObjectsCallback c) -> void
+{
+	onObjectsAdded.Add(c);
+}
+
+auto DLLEXPORT ResourceManager::RemoveCallbackOnObjectsAdded(ObjectsCallback c) -> void
+{
+	onObjectsAdded.Erase(c);
+}
+
 auto DLLEXPORT ResourceManager::AddCallbackOnDestroy(ObjectCallback c) -> void
 {
 	onObjectDestroy.Add(c);
@@ -367,6 +367,8 @@ auto DLLEXPORT ResourceManager::GetImportedMeshes() -> std::vector<std::string>
 
 auto DLLEXPORT ResourceManager::Import(const char *path, ProgressCallback callback) -> void
 {
+	PROFILE_FUNCTION();
+
 	Log("Importing '%s'...", path);
 
 	if (!FS->FileExist(path))
@@ -395,8 +397,7 @@ auto DLLEXPORT ResourceManager::Import(const char *path, ProgressCallback callba
 class ResManProfiler : public IProfilerCallback
 {
 public:
-	uint getNumLines() override { return 5; }
-	std::string getString(uint i) override
+	void writeLines(TextArena& out) override
 	{
 		size_t texBytes = 0;
 		size_t textures = texturesSet.size();
@@ -425,14 +426,11 @@ public:
 		for(StructuredBuffer *b : structuredBuffersSet)
 			buffersBytes += b->GetVideoMemoryUsage();
 
-		switch (i)
-		{
-			case 0: return "==== Resource Manager ====";
-			case 1: return "Textures: " + std::to_string(textures) + " (" + bytesToMBytes(texBytes) + " Mb)";
-			case 2: return "Meshes: " + std::to_string(meshes) + " (" + bytesToMBytes(meshBytes) + " Mb)";
-			case 3: return "Structured Buffers: " + std::to_string(structuredBuffersSet.size()) + " (" + bytesToMBytes(buffersBytes) + " Mb)";
-		}
-		return "";
+		out.AddLine("==== Resource Manager ====");
+		out.AddLine("Textures: %u (%s Mb)", (uint)textures, bytesToMBytes(texBytes).c_str());
+		out.AddLine("Meshes: %u (%s Mb)", (uint)meshes, bytesToMBytes(meshBytes).c_str());
+		out.AddLine("Structured Buffers: %u (%s Mb)", (uint)structuredBuffersSet.size(), bytesToMBytes(buffersBytes).c_str());
+		out.AddLine("");
 	}
 } profiler;
 
@@ -447,27 +445,94 @@ void ResourceManager::Free()
 
 	CloseWorld();
 
+	// released stream resources wait for residency scan
+	for (auto [p, m] : streamMeshesMap)
+		m->free();
+	for (auto [p, t] : streamTexturesMap)
+		t->free();
+
 	assert(shadersSet.size() == 0);
 	assert(texturesSet.size() == 0);
 	assert(structuredBuffersSet.size() == 0);
 
 	Log("ResourceManager Free");
 }
+static float msSince(std::chrono::steady_clock::time_point t)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// Stream resource is unloaded when it wasn't used for UNLOAD_RESOURCE_FRAMES frames,
+// or soon after last StreamPtr is released, but not while frame in flight can draw it
+template<typename R>
+static bool isUnused(R *r)
+{
+	const int64_t unused = _core->frame() - (int64_t)r->frame();
+	return r->isLoaded() && (unused > UNLOAD_RESOURCE_FRAMES || (r->getRefs() == 0 && unused > UNREFERENCED_RESOURCE_FRAMES));
+}
+
 void ResourceManager::Update(float dt)
 {
+	UpdateObjects(dt);
+	FreeUnusedResources();
+}
+
+void ResourceManager::UpdateObjects(float dt)
+{
+	PROFILE_FUNCTION();
+
+	ThreadPool *pool = _core->GetThreadPool();
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	TransformSystem::BeginFrame();
+
+	updateTimings.transforms = msSince(t0);
+
+	// Root subtrees are independent, so each one is a job
+	auto t1 = std::chrono::steady_clock::now();
+
+	JobCounter counter;
+
 	for (GameObject *g : rootObjectsVec)
-		g->Update(dt);
+		pool->Submit(counter, [g, dt]()
+		{
+			PROFILE_SCOPE("Update subtree");
+			ObjectRegistry::SetUpdatingObjects(true);
+			g->Update(dt);
+			ObjectRegistry::SetUpdatingObjects(false);
+		});
+
+	pool->Wait(counter);
+
+	updateTimings.objects = msSince(t1);
+}
+
+void ResourceManager::FreeUnusedResources()
+{
+	PROFILE_FUNCTION();
+
+	// Frame stamps and reference counters are plain fields changed by StreamPtr on main thread,
+	// so the scan runs here and not in update jobs. Frame pipeline stage is finished at this point.
+	auto t = std::chrono::steady_clock::now();
 
 	for (auto [p, m] : streamMeshesMap)
 	{
-		if ((_core->frame() - m->frame() > UNLOAD_RESOURCE_FRAMES) && m->isLoaded())
+		if (isUnused(m))
 			m->free();
 	}
 	for (auto [p, m] : streamTexturesMap)
 	{
-		if ((_core->frame() - m->frame() > UNLOAD_RESOURCE_FRAMES) && m->isLoaded())
+		if (isUnused(m))
 			m->free();
 	}
+
+	updateTimings.residency = msSince(t);
+}
+
+auto ResourceManager::GetUpdateTimings() -> const UpdateTimings&
+{
+	return updateTimings;
 }
 
 void ResourceManager::Reload()
@@ -476,42 +541,27 @@ void ResourceManager::Reload()
 	Log("ResourceManager: Reloading all resources...");
 }
 
-void saveObj(Emitter& out, GameObject *o)
+void saveObj(SceneWriter& writer, GameObject *o, bool root)
 {
-	if (!o)
-		return;
-
-	out << YAML::BeginMap;
-	out << Key << "childs" << Value << o->GetNumChilds();
-	o->SaveYAML(static_cast<void*>(&out));
-	out << YAML::EndMap;
+	SceneFileObject obj{};
+	o->SaveBinary(obj, writer);
+	writer.AddObject(obj, o->GetLocalTransform(), root);
 
 	for (int i = 0; i < o->GetNumChilds(); i++)
-		saveObj(out, o->GetChild(i));
+		saveObj(writer, o->GetChild(i), false);
 }
 
 auto DLLEXPORT ResourceManager::SaveWorld() -> void
 {
-	Log("Saving %s ...", "scene.yaml");
-
-	YAML::Emitter out;
-
-	out << YAML::BeginMap;
-
-	out << Key << "roots" << Value << rootObjectsVec.size();
-
-	out << Key << "objects" << Value;
-	out << YAML::BeginSeq;
+	Log("Saving %s ...", SCENE_BIN);
 
-	for (int i = 0; i< rootObjectsVec.size(); i++)
-		saveObj(out, rootObjectsVec[i]);
+	SceneWriter writer;
 
-	out << YAML::EndSeq;
-	out << YAML::EndMap;
+	for (GameObject *g : rootObjectsVec)
+		saveObj(writer, g, true);
 
-	File f = FS->OpenFile("scene.yaml", FILE_OPEN_MODE::WRITE | FILE_OPEN_MODE::BINARY);
-	
-	f.WriteStr(out.c_str());
+	if (!writer.Write(SCENE_BIN))
+		LogCritical("ResourceManager::SaveWorld(): world isn't saved");
 }
 
 void loadObj(YAML::Node& objects_yaml, int *i, GameObject *parent, Signal<GameObject*> &sig)
@@ -557,15 +607,11 @@ void loadObj(YAML::Node& objects_yaml, int *i, GameObject *parent, Signal<GameOb
 		loadObj(objects_yaml, i, g, sig);
 }
 
-auto DLLEXPORT ResourceManager::LoadWorld() -> void
+// Builds whole document tree before creating objects. Used for comparison in benchmark
+// and for scenes with object keys that records don't have
+static void loadWorldDOM(const char *path, Signal<GameObject*> &sig)
 {
-	if (rootObjectsVec.size())
-	{
-		LogWarning("ResourceManager::LoadWorld(): scene loaded");
-		return;
-	}
-
-	File f = FS->OpenFile("scene.yaml", FILE_OPEN_MODE::READ | FILE_OPEN_MODE::BINARY);
+	File f = FS->OpenFile(path, FILE_OPEN_MODE::READ | FILE_OPEN_MODE::BINARY);
 	
 	uint fileSize =	(uint)f.FileSize();
 	
@@ -607,7 +653,288 @@ auto DLLEXPORT ResourceManager::LoadWorld() -> void
 
 	int i = 0;
 	for (int j = 0; j < roots; j++)
-		loadObj(objects_yaml, &i, nullptr, onObjectAdded);
+		loadObj(objects_yaml, &i, nullptr, sig);
+}
+
+// Second phase of world loading: links hierarchy and creates objects from decoded records.
+// Each mesh and material path is resolved once.
+static void createObjects(const SceneFileObject *objects, const mat4 *transforms, uint32_t num, bool worldTransforms,
+	const vector<const char*>& strings, vector<GameObject*>& created)
+{
+	PROFILE_FUNCTION();
+
+	vector<StreamPtr<Mesh>> meshes(strings.size());
+	vector<Material*> materials(strings.size());
+	vector<bool> materialResolved(strings.size());
+
+	struct Parent
+	{
+		GameObject *g;
+		uint32_t childsLeft;
+	};
+	vector<Parent> stack;
+
+	created.reserve(created.size() + num);
+
+	for (uint32_t i = 0; i < num; i++)
+	{
+		const SceneFileObject& obj = objects[i];
+
+		while (!stack.empty() && stack.back().childsLeft == 0)
+			stack.pop_back();
+
+		GameObject *g = nullptr;
+
+		switch ((OBJECT_TYPE)obj.type)
+		{
+			case OBJECT_TYPE::GAMEOBJECT: g = new GameObject; break;
+			case OBJECT_TYPE::MODEL:
+			{
+				if (obj.mesh >= 0 && meshes[obj.mesh].path().empty())
+					meshes[obj.mesh] = RES_MAN->CreateStreamMesh(strings[obj.mesh]);
+
+				Model *m = obj.mesh >= 0 ? new Model(meshes[obj.mesh]) : new Model;
+
+				if (obj.material >= 0)
+				{
+					if (!materialResolved[obj.material])
+					{
+						materials[obj.material] = MAT_MAN->GetMaterial(strings[obj.material]);
+						materialResolved[obj.material] = true;
+					}
+					if (materials[obj.material])
+						m->SetMaterial(materials[obj.material]);
+				}
+
+				g = m;
+			}
+			break;
+			case OBJECT_TYPE::LIGHT: g = new Light; break;
+			case OBJECT_TYPE::CAMERA: g = new Camera; break;
+			default:
+				LogCritical("LoadWorld(): unknown object type %i", (int)obj.type);
+				return;
+		}
+
+		if (stack.empty())
+			rootObjectsVec.push_back(g);
+		else
+		{
+			stack.back().g->InsertChild(g);
+			stack.back().childsLeft--;
+		}
+
+		g->LoadBinary(obj);
+
+		if (worldTransforms)
+			g->SetWorldTransform(transforms[i]);
+		else
+			g->SetLocalTransform(transforms[i]);
+
+		created.push_back(g);
+		stack.push_back({g, obj.childs});
+	}
+}
+
+static bool loadWorldBinary(const char *path, vector<GameObject*>& created)
+{
+	SceneReader reader;
+	if (!reader.Open(path))
+		return false;
+
+	if (!reader.GetNumObjects())
+		return true;
+
+	vector<const char*> strings(reader.GetNumStrings());
+	for (uint32_t i = 0; i < reader.GetNumStrings(); i++)
+		strings[i] = reader.GetString(i);
+
+	rootObjectsVec.reserve(reader.GetNumRoots());
+
+	createObjects(&reader.GetObject_(0), &reader.GetTransform(0), reader.GetNumObjects(), false, strings, created);
+	return true;
+}
+
+static void collectObjects(GameObject *g, vector<GameObject*>& out)
+{
+	out.push_back(g);
+	for (int i = 0; i < g->GetNumChilds(); i++)
+		collectObjects(g->GetChild(i), out);
+}
+
+static bool loadWorldYAML(const char *path, vector<GameObject*>& created)
+{
+	// first phase, parallel parsing to records
+	SceneRecords records;
+	if (!ParseSceneYAML(path, records))
+		return false;
+
+	// records can't keep other keys, objects' LoadYAML() gets them from document tree.
+	// Text split inside objects (sequence items at key's indentation) gives wrong records, so it goes there too
+	if (!records.unknownKeys.empty() || !records.wholeObjects)
+	{
+		LogWarning("loadWorldYAML(): loading '%s' through document tree", path);
+
+		Signal<GameObject*> noSignal;
+		loadWorldDOM(path, noSignal);
+
+		for (GameObject *g : rootObjectsVec)
+			collectObjects(g, created);
+		return true;
+	}
+
+	vector<const char*> strings(records.strings.size());
+	for (size_t i = 0; i < records.strings.size(); i++)
+		strings[i] = records.strings[i].c_str();
+
+	rootObjectsVec.reserve(records.roots);
+
+	createObjects(records.objects.data(), records.transforms.data(), (uint32_t)records.objects.size(), true, strings, created);
+	return true;
+}
+
+auto DLLEXPORT ResourceManager::LoadWorld() -> void
+{
+	PROFILE_FUNCTION();
+
+	if (rootObjectsVec.size())
+	{
+		LogWarning("ResourceManager::LoadWorld(): scene loaded");
+		return;
+	}
+
+	vector<GameObject*> created;
+
+	// SaveWorld() writes only binary scene. YAML is for scenes saved before binary format
+	// and for hand edits or ConvertSceneBinaryToYAML() output, so newer YAML wins
+	string binPath = SCENE_BIN;
+	string yamlPath = SCENE_YAML;
+	const bool hasBin = FS->FileExist(SCENE_BIN);
+	const bool hasYAML = FS->FileExist(SCENE_YAML);
+	const bool useBin = hasBin && (!hasYAML || FS->GetTime(binPath) >= FS->GetTime(yamlPath));
+
+	if (useBin && !loadWorldBinary(SCENE_BIN, created) && hasYAML)
+	{
+		LogWarning("ResourceManager::LoadWorld(): loading %s instead", SCENE_YAML);
+		loadWorldYAML(SCENE_YAML, created);
+	}
+	else if (!useBin && hasYAML)
+		loadWorldYAML(SCENE_YAML, created);
+
+	if (created.empty())
+	{
+		Log("LoadWorld(): world is empty");
+		return;
+	}
+
+	onObjectsAdded.Invoke(created.data(), created.size());
+}
+
+void ResourceManager::BenchmarkSceneLoading(uint objects)
+{
+	if (rootObjectsVec.size())
+	{
+		LogWarning("ResourceManager::BenchmarkSceneLoading(): close world first");
+		return;
+	}
+
+	using clock = std::chrono::steady_clock;
+	auto ms = [](clock::time_point from) -> float
+	{
+		return std::chrono::duration<float, std::milli>(clock::now() - from).count();
+	};
+
+	const char *path = "scene_benchmark.yaml";
+	const char *meshes[] = {"std#cube", "std#plane", "std#axes_arrows"};
+	const uint childs = 9; // each root is a GameObject with models
+
+	// generate scene
+	{
+		uint roots = max(objects / (childs + 1), 1u);
+
+		YAML::Emitter out;
+		out << YAML::BeginMap;
+		out << Key << "roots" << Value << roots;
+		out << Key << "objects" << Value;
+		out << YAML::BeginSeq;
+
+		for (uint r = 0; r < roots; r++)
+		{
+			mat4 m;
+			m.el_2D[0][3] = float(r % 100) * 10.0f;
+			m.el_2D[1][3] = float(r / 100) * 10.0f;
+
+			out << YAML::BeginMap;
+			out << Key << "childs" << Value << childs;
+			out << Key << "id" << Value << int(r * (childs + 1) + 1);
+			out << Key << "enabled" << Value << true;
+			out << Key << "type" << Value << getNameByType(OBJECT_TYPE::GAMEOBJECT);
+			out << Key << "worldTransform" << Value << m;
+			out << YAML::EndMap;
+
+			for (uint c = 0; c < childs; c++)
+			{
+				out << YAML::BeginMap;
+				out << Key << "childs" << Value << 0;
+				out << Key << "id" << Value << int(r * (childs + 1) + c + 2);
+				out << Key << "enabled" << Value << true;
+				out << Key << "type" << Value << getNameByType(OBJECT_TYPE::MODEL);
+				out << Key << "worldTransform" << Value << m;
+				out << Key << "mesh" << Value << meshes[c % _countof(meshes)];
+				out << YAML::EndMap;
+			}
+		}
+
+		out << YAML::EndSeq;
+		out << YAML::EndMap;
+
+		File f = FS->OpenFile(path, FILE_OPEN_MODE::WRITE | FILE_OPEN_MODE::BINARY);
+		f.WriteStr(out.c_str());
+	}
+
+	// objects are not announced, so destroy them without signals
+	auto destroyAll = []()
+	{
+		for (GameObject *g : rootObjectsVec)
+			delete g;
+		rootObjectsVec.clear();
+	};
+
+	Signal<GameObject*> noSignal;
+
+	clock::time_point t = clock::now();
+	loadWorldDOM(path, noSignal);
+	float domMs = ms(t);
+	size_t domRoots = rootObjectsVec.size();
+	destroyAll();
+
+	vector<GameObject*> created;
+	t = clock::now();
+	loadWorldYAML(path, created);
+	float eventsMs = ms(t);
+	size_t eventsRoots = rootObjectsVec.size();
+	destroyAll();
+
+	std::filesystem::remove(std::filesystem::u8path(_core->GetDataPath()) / path);
+
+	Log("Scene loading benchmark (%u objects):", (uint)created.size());
+	Log("  DOM loader: %.2f ms (%u roots)", domMs, (uint)domRoots);
+	Log("  two-phase parallel loader: %.2f ms (%u roots)", eventsMs, (uint)eventsRoots);
+}
+
+auto DLLEXPORT ResourceManager::ConvertWorld(const char *src, const char *dst) -> bool
+{
+	string srcExt = fileExtension(src);
+	string dstExt = fileExtension(dst);
+
+	if (srcExt == "yaml" && dstExt == "bin")
+		return ConvertSceneYAMLToBinary(src, dst);
+
+	if (srcExt == "bin" && dstExt == "yaml")
+		return ConvertSceneBinaryToYAML(src, dst);
+
+	LogCritical("ResourceManager::ConvertWorld(): can not convert '%s' to '%s'", src, dst);
+	return false;
 }
 
 auto DLLEXPORT ResourceManager::CloseWorld() -> void
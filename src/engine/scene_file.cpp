@@ -0,0 +1,307 @@
+#include "pch.h"
+#include "scene_file.h"
+#include "core.h"
+#include "gameobject.h"
+#include "yaml.inl"
+#include "scene_yaml_loader.h"
+
+static uint64_t align16(uint64_t offset)
+{
+	return (offset + 15) & ~uint64_t(15);
+}
+
+static bool fits(uint64_t offset, uint64_t bytes, uint64_t size)
+{
+	return offset <= size && bytes <= size - offset;
+}
+
+auto SceneWriter::AddString(const char *str) -> int32_t
+{
+	auto it = stringsMap.find(str);
+	if (it != stringsMap.end())
+		return it->second;
+
+	int32_t i = (int32_t)strings.size();
+	strings.emplace_back(str);
+	stringsMap[strings.back()] = i;
+	return i;
+}
+
+auto SceneWriter::AddObject(const SceneFileObject& obj, const mat4& localTransform, bool root) -> void
+{
+	objects.push_back(obj);
+	transforms.push_back(localTransform);
+	if (root)
+		roots++;
+}
+
+auto SceneWriter::Write(const char *path) -> bool
+{
+	SceneFileHeader h{};
+	h.magic = SCENE_FILE_MAGIC;
+	h.version = SCENE_FILE_VERSION;
+	h.objects = (uint32_t)objects.size();
+	h.roots = roots;
+	h.strings = (uint32_t)strings.size();
+
+	vector<uint32_t> stringOffsets(strings.size());
+	vector<char> stringData;
+	for (size_t i = 0; i < strings.size(); i++)
+	{
+		stringOffsets[i] = (uint32_t)stringData.size();
+		stringData.insert(stringData.end(), strings[i].c_str(), strings[i].c_str() + strings[i].size() + 1);
+	}
+
+	uint64_t offset = sizeof(SceneFileHeader);
+	h.objectsOffset = offset;
+	offset += objects.size() * sizeof(SceneFileObject);
+	uint64_t padding = align16(offset) - offset;
+	offset += padding;
+	h.transformsOffset = offset;
+	offset += transforms.size() * sizeof(mat4);
+	h.stringOffsetsOffset = offset;
+	offset += stringOffsets.size() * sizeof(uint32_t);
+	h.stringDataOffset = offset;
+	offset += stringData.size();
+	h.fileSize = offset;
+
+	const uint8 zeros[16] = {};
+
+	File f = FS->OpenFile(path, FILE_OPEN_MODE::WRITE | FILE_OPEN_MODE::BINARY);
+	if (!f.IsOpen())
+	{
+		LogCritical("SceneWriter::Write(): can't open '%s'", path);
+		return false;
+	}
+
+	f.Write(reinterpret_cast<const uint8*>(&h), sizeof(h));
+	f.Write(reinterpret_cast<const uint8*>(objects.data()), objects.size() * sizeof(SceneFileObject));
+	f.Write(zeros, padding);
+	f.Write(reinterpret_cast<const uint8*>(transforms.data()), transforms.size() * sizeof(mat4));
+	f.Write(reinterpret_cast<const uint8*>(stringOffsets.data()), stringOffsets.size() * sizeof(uint32_t));
+	f.Write(reinterpret_cast<const uint8*>(stringData.data()), stringData.size());
+
+	if (!f.Flush())
+	{
+		LogCritical("SceneWriter::Write(): can't write '%s'", path);
+		return false;
+	}
+
+	return true;
+}
+
+auto SceneReader::Open(const char *path) -> bool
+{
+	if (!FS->FileExist(path))
+	{
+		LogCritical("SceneReader::Open(): file '%s' not found", path);
+		return false;
+	}
+
+	mapping = FS->CreateMemoryMapedFile(path);
+
+	const SceneFileHeader *h = reinterpret_cast<const SceneFileHeader*>(mapping.ptr);
+
+	if (mapping.fsize < sizeof(SceneFileHeader) || h->magic != SCENE_FILE_MAGIC || h->fileSize != mapping.fsize)
+	{
+		LogCritical("SceneReader::Open(): invalid file '%s'", path);
+		return false;
+	}
+
+	if (h->version != SCENE_FILE_VERSION)
+	{
+		LogCritical("SceneReader::Open(): unsupported version %u of '%s'", h->version, path);
+		return false;
+	}
+
+	if (!fits(h->objectsOffset, uint64_t(h->objects) * sizeof(SceneFileObject), h->fileSize) ||
+		!fits(h->transformsOffset, uint64_t(h->objects) * sizeof(mat4), h->fileSize) || h->transformsOffset % 16 ||
+		!fits(h->stringOffsetsOffset, uint64_t(h->strings) * sizeof(uint32_t), h->fileSize) ||
+		!fits(h->stringDataOffset, 0, h->fileSize))
+	{
+		LogCritical("SceneReader::Open(): invalid sections of '%s'", path);
+		return false;
+	}
+
+	const SceneFileObject *objs = reinterpret_cast<const SceneFileObject*>(mapping.ptr + h->objectsOffset);
+	const uint32_t *offsets = reinterpret_cast<const uint32_t*>(mapping.ptr + h->stringOffsetsOffset);
+	const char *data = reinterpret_cast<const char*>(mapping.ptr + h->stringDataOffset);
+	const uint64_t dataSize = h->fileSize - h->stringDataOffset;
+
+	// each string starts inside string data and ends there
+	for (uint32_t i = 0; i < h->strings; i++)
+	{
+		if (offsets[i] >= dataSize || !memchr(data + offsets[i], 0, dataSize - offsets[i]))
+		{
+			LogCritical("SceneReader::Open(): invalid string %u of '%s'", i, path);
+			return false;
+		}
+	}
+
+	// string indices and hierarchy: childs of each object must follow it
+	vector<uint32_t> childsLeft;
+	uint32_t roots = 0;
+
+	for (uint32_t i = 0; i < h->objects; i++)
+	{
+		const SceneFileObject& obj = objs[i];
+
+		if (obj.mesh < -1 || obj.mesh >= (int64_t)h->strings || obj.material < -1 || obj.material >= (int64_t)h->strings)
+		{
+			LogCritical("SceneReader::Open(): invalid string index of object %u of '%s'", i, path);
+			return false;
+		}
+
+		while (!childsLeft.empty() && childsLeft.back() == 0)
+			childsLeft.pop_back();
+
+		if (childsLeft.empty())
+			roots++;
+		else
+			childsLeft.back()--;
+
+		childsLeft.push_back(obj.childs);
+	}
+
+	for (uint32_t left : childsLeft)
+	{
+		if (left)
+		{
+			LogCritical("SceneReader::Open(): childs of objects exceed objects number in '%s'", path);
+			return false;
+		}
+	}
+
+	if (roots != h->roots)
+	{
+		LogCritical("SceneReader::Open(): invalid roots number of '%s'", path);
+		return false;
+	}
+
+	header = h;
+	objects = objs;
+	transforms = reinterpret_cast<const mat4*>(mapping.ptr + h->transformsOffset);
+	stringOffsets = offsets;
+	stringData = data;
+
+	return true;
+}
+
+bool ConvertSceneYAMLToBinary(const char *yamlPath, const char *binPath)
+{
+	SceneRecords records;
+	if (!ParseSceneYAML(yamlPath, records))
+		return false;
+
+	SceneWriter writer;
+
+	// records strings are unique, so indices stay the same
+	for (const std::string& s : records.strings)
+		writer.AddString(s.c_str());
+
+	struct Parent
+	{
+		mat4 invWorld;
+		uint32_t childsLeft;
+	};
+	vector<Parent> stack;
+
+	for (size_t i = 0; i < records.objects.size(); i++)
+	{
+		const SceneFileObject& obj = records.objects[i];
+		const mat4& world = records.transforms[i];
+
+		while (!stack.empty() && stack.back().childsLeft == 0)
+			stack.pop_back();
+
+		bool root = stack.empty();
+
+		mat4 local = root ? world : stack.back().invWorld * world;
+
+		if (!root)
+			stack.back().childsLeft--;
+
+		writer.AddObject(obj, local, root);
+
+		stack.push_back({world.InverseAffine(), obj.childs});
+	}
+
+	return writer.Write(binPath);
+}
+
+bool ConvertSceneBinaryToYAML(const char *binPath, const char *yamlPath)
+{
+	SceneReader reader;
+	if (!reader.Open(binPath))
+		return false;
+
+	struct Parent
+	{
+		mat4 world;
+		uint32_t childsLeft;
+	};
+	vector<Parent> stack;
+
+	YAML::Emitter out;
+
+	out << YAML::BeginMap;
+	out << YAML::Key << "roots" << YAML::Value << reader.GetNumRoots();
+	out << YAML::Key << "objects" << YAML::Value;
+	out << YAML::BeginSeq;
+
+	for (uint32_t i = 0; i < reader.GetNumObjects(); i++)
+	{
+		const SceneFileObject& obj = reader.GetObject_(i);
+
+		while (!stack.empty() && stack.back().childsLeft == 0)
+			stack.pop_back();
+
+		mat4 world = stack.empty() ? reader.GetTransform(i) : stack.back().world * reader.GetTransform(i);
+
+		if (!stack.empty())
+			stack.back().childsLeft--;
+
+		stack.push_back({world, obj.childs});
+
+		// same keys as GameObject::SaveYAML() and overrides
+		out << YAML::BeginMap;
+		out << YAML::Key << "childs" << YAML::Value << obj.childs;
+		out << YAML::Key << "id" << YAML::Value << obj.id;
+		out << YAML::Key << "enabled" << YAML::Value << (obj.enabled != 0);
+		out << YAML::Key << "type" << YAML::Value << getNameByType((OBJECT_TYPE)obj.type);
+		out << YAML::Key << "worldTransform" << YAML::Value << world;
+
+		if (obj.mesh >= 0)
+			out << YAML::Key << "mesh" << YAML::Value << reader.GetString(obj.mesh);
+		if (obj.material >= 0)
+			out << YAML::Key << "material" << YAML::Value << reader.GetString(obj.material);
+
+		if ((OBJECT_TYPE)obj.type == OBJECT_TYPE::LIGHT)
+		{
+			out << YAML::Key << "intensity" << YAML::Value << obj.params[0];
+			out << YAML::Key << "light_type" << YAML::Value << (int)obj.params[1];
+		}
+		else if ((OBJECT_TYPE)obj.type == OBJECT_TYPE::CAMERA)
+		{
+			out << YAML::Key << "zNear" << YAML::Value << obj.params[0];
+			out << YAML::Key << "zFar" << YAML::Value << obj.params[1];
+			out << YAML::Key << "fovAngle" << YAML::Value << obj.params[2];
+		}
+
+		out << YAML::EndMap;
+	}
+
+	out << YAML::EndSeq;
+	out << YAML::EndMap;
+
+	File f = FS->OpenFile(yamlPath, FILE_OPEN_MODE::WRITE | FILE_OPEN_MODE::BINARY);
+	f.WriteStr(out.c_str());
+
+	if (!f.Flush())
+	{
+		LogCritical("ConvertSceneBinaryToYAML(): can't write '%s'", yamlPath);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "common.h"
+#include "filesystem.h"
+
+//
+// Binary scene format.
+// Objects are stored depth-first (parent before its childs) in a flat table,
+// local transforms are a raw mat4 array in the same order,
+// mesh and material paths are indices in a deduplicated string table.
+// File is read through memory mapping without parsing.
+//
+
+#define SCENE_FILE_MAGIC 0x4E435345u // "ESCN"
+#define SCENE_FILE_VERSION 1
+
+#pragma pack(push, 1)
+struct SceneFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t objects;
+	uint32_t roots;
+	uint32_t strings;
+	uint32_t reserved;
+	uint64_t objectsOffset; // SceneFileObject[objects]
+	uint64_t transformsOffset; // mat4[objects], 16 bytes aligned
+	uint64_t stringOffsetsOffset; // uint32_t[strings], offsets from stringDataOffset
+	uint64_t stringDataOffset; // null terminated utf-8 strings
+	uint64_t fileSize;
+};
+
+struct SceneFileObject
+{
+	int32_t id;
+	uint8_t type; // OBJECT_TYPE
+	uint8_t enabled;
+	uint16_t reserved;
+	uint32_t childs;
+	int32_t mesh; // string index or -1
+	int32_t material; // string index or -1
+	float params[4]; // LIGHT: intensity, light type. CAMERA: zNear, zFar, fovAngle
+};
+#pragma pack(pop)
+
+class SceneWriter
+{
+	std::vector<SceneFileObject> objects;
+	std::vector<mat4> transforms;
+	std::vector<std::string> strings;
+	std::unordered_map<std::string, int32_t> stringsMap;
+	uint32_t roots{0};
+
+public:
+	auto AddString(const char *str) -> int32_t;
+	auto AddObject(const SceneFileObject& obj, const mat4& localTransform, bool root) -> void;
+	auto Write(const char *path) -> bool; // false if file can't be opened or written
+};
+
+class SceneReader
+{
+	FileMapping mapping;
+	const SceneFileHeader *header{nullptr};
+	const SceneFileObject *objects{nullptr};
+	const mat4 *transforms{nullptr};
+	const uint32_t *stringOffsets{nullptr};
+	const char *stringData{nullptr};
+
+public:
+	auto Open(const char *path) -> bool; // validates whole file, getters don't check indices
+	auto GetNumObjects() const -> uint32_t { return header->objects; }
+	auto GetNumRoots() const -> uint32_t { return header->roots; }
+	auto GetNumStrings() const -> uint32_t { return header->strings; }
+	auto GetObject_(uint32_t i) const -> const SceneFileObject& { return objects[i]; }
+	auto GetTransform(uint32_t i) const -> const mat4& { return transforms[i]; }
+	auto GetString(int32_t i) const -> const char* { return i >= 0 ? stringData + stringOffsets[i] : nullptr; }
+};
+
+// Converters between interchange YAML scene and binary scene
+bool ConvertSceneYAMLToBinary(const char *yamlPath, const char *binPath);
+bool ConvertSceneBinaryToYAML(const char *binPath, const char *yamlPath);
@@ -0,0 +1,369 @@
+#include "pch.h"
+#include "scene_yaml_loader.h"
+#include "core.h"
+#include "filesystem.h"
+#include "gameobject.h"
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+#include "yaml-cpp/yaml.h"
+#include "yaml-cpp/eventhandler.h"
+#include <sstream>
+#include <cmath>
+
+#define MIN_CHUNK_BYTES (64 * 1024)
+
+// Builds records from parser events of one chunk.
+// Depth of events: 1 - objects sequence, 2 - object map, 3 - sequence value (worldTransform)
+class ChunkHandler final : public YAML::EventHandler
+{
+	SceneRecords& out;
+	std::unordered_map<std::string, int32_t> stringsMap;
+
+	int depth{0};
+	bool keyNext{true};
+	std::string key;
+	SceneFileObject obj;
+	mat4 transform;
+	int transformElements{0};
+
+	auto addString(const std::string& str) -> int32_t
+	{
+		auto it = stringsMap.find(str);
+		if (it != stringsMap.end())
+			return it->second;
+
+		int32_t i = (int32_t)out.strings.size();
+		out.strings.push_back(str);
+		stringsMap.emplace(str, i);
+		return i;
+	}
+
+	static auto typeByName(const std::string& name) -> OBJECT_TYPE
+	{
+		// getTypeByName() can insert into its map, so it is not used from workers
+		for (OBJECT_TYPE t : {OBJECT_TYPE::MODEL, OBJECT_TYPE::LIGHT, OBJECT_TYPE::CAMERA})
+			if (name == getNameByType(t))
+				return t;
+		return OBJECT_TYPE::GAMEOBJECT;
+	}
+
+	void onValue(const std::string& value)
+	{
+		const char *v = value.c_str();
+
+		if (key == "id") obj.id = atoi(v);
+		else if (key == "type") obj.type = (uint8_t)typeByName(value);
+		else if (key == "enabled") obj.enabled = value == "true" || value == "True" || value == "yes" || value == "on";
+		else if (key == "childs") obj.childs = (uint32_t)strtoul(v, nullptr, 10);
+		else if (key == "mesh") obj.mesh = addString(value);
+		else if (key == "material") obj.material = addString(value);
+		else if (key == "intensity" || key == "zNear") obj.params[0] = strtof(v, nullptr);
+		else if (key == "light_type" || key == "zFar") obj.params[1] = strtof(v, nullptr);
+		else if (key == "fovAngle") obj.params[2] = strtof(v, nullptr);
+		else out.unknownKeys.insert(key);
+	}
+
+	void beginObject()
+	{
+		obj = {};
+		obj.mesh = -1;
+		obj.material = -1;
+		for (float& p : obj.params)
+			p = NAN;
+		transform = mat4();
+		transformElements = 0;
+		keyNext = true;
+	}
+
+	void endObject()
+	{
+		// chunk boundary inside worldTransform sequence cuts it
+		if (transformElements != 16)
+			out.wholeObjects = false;
+
+		// missing keys get defaults of Light and Camera
+		float defaults[4] = {};
+		if ((OBJECT_TYPE)obj.type == OBJECT_TYPE::LIGHT)
+		{
+			defaults[0] = 1.0f;
+			defaults[1] = (float)LIGHT_TYPE::DIRECT;
+		}
+		else if ((OBJECT_TYPE)obj.type == OBJECT_TYPE::CAMERA)
+		{
+			defaults[0] = 0.1f;
+			defaults[1] = 1000.0f;
+			defaults[2] = 60.0f;
+		}
+
+		for (int i = 0; i < 4; i++)
+			if (std::isnan(obj.params[i]))
+				obj.params[i] = defaults[i];
+
+		out.objects.push_back(obj);
+		out.transforms.push_back(transform);
+	}
+
+public:
+	ChunkHandler(SceneRecords& out) : out(out) {}
+
+	void OnDocumentStart(const YAML::Mark& mark) override {}
+	void OnDocumentEnd() override {}
+	void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override {}
+
+	void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override
+	{
+		OnScalar(mark, "", anchor, "");
+	}
+
+	void OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) override
+	{
+		if (depth == 2)
+		{
+			if (keyNext)
+				key = value;
+			else
+				onValue(value);
+			keyNext = !keyNext;
+		}
+		else if (depth == 3 && key == "worldTransform")
+		{
+			if (transformElements < 16)
+				transform.el_1D[transformElements] = strtof(value.c_str(), nullptr);
+			transformElements++;
+		}
+		else if (depth <= 1)
+			out.wholeObjects = false; // objects sequence has items that are not objects
+	}
+
+	void OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override
+	{
+		if (depth == 2 && key != "worldTransform")
+			out.unknownKeys.insert(key);
+		else if (depth == 1)
+			out.wholeObjects = false;
+		depth++;
+	}
+
+	void OnSequenceEnd() override
+	{
+		depth--;
+		if (depth == 2)
+			keyNext = true;
+	}
+
+	void OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override
+	{
+		if (depth == 1)
+			beginObject();
+		else if (depth == 2)
+			out.unknownKeys.insert(key);
+		depth++;
+	}
+
+	void OnMapEnd() override
+	{
+		depth--;
+		if (depth == 1)
+			endObject();
+		else if (depth == 2)
+			keyNext = true;
+	}
+};
+
+// Objects are depth-first, so childs counts must build exactly header's number of trees
+static bool checkHierarchy(const SceneRecords& records)
+{
+	vector<uint32_t> childsLeft;
+	uint32_t roots = 0;
+
+	for (const SceneFileObject& obj : records.objects)
+	{
+		while (!childsLeft.empty() && !childsLeft.back())
+			childsLeft.pop_back();
+
+		if (childsLeft.empty())
+			roots++;
+		else
+			childsLeft.back()--;
+
+		childsLeft.push_back(obj.childs);
+	}
+
+	while (!childsLeft.empty() && !childsLeft.back())
+		childsLeft.pop_back();
+
+	return childsLeft.empty() && roots == records.roots;
+}
+
+static size_t findLine(const std::string& text, const char *line, size_t from = 0)
+{
+	for (size_t pos = text.find(line, from); pos != std::string::npos; pos = text.find(line, pos + 1))
+		if (pos == 0 || text[pos - 1] == '\n')
+			return pos;
+	return std::string::npos;
+}
+
+bool ParseSceneYAML(const char *path, SceneRecords& out)
+{
+	PROFILE_FUNCTION();
+
+	if (!FS->FileExist(path))
+	{
+		LogCritical("ParseSceneYAML(): file '%s' not found", path);
+		return false;
+	}
+
+	File f = FS->OpenFile(path, FILE_OPEN_MODE::READ | FILE_OPEN_MODE::BINARY);
+
+	std::string text(f.FileSize(), '\0');
+	f.Read((uint8*)&text[0], text.size());
+
+	// header is everything before objects sequence
+	size_t objectsPos = findLine(text, "objects:");
+	size_t bodyStart = objectsPos == std::string::npos ? text.size() : text.find('\n', objectsPos);
+	bodyStart = bodyStart == std::string::npos ? text.size() : bodyStart + 1;
+
+	try
+	{
+		YAML::Node header = YAML::Load(text.substr(0, objectsPos == std::string::npos ? text.size() : objectsPos));
+		if (!header["roots"])
+		{
+			LogCritical("ParseSceneYAML(): invalid file '%s'", path);
+			return false;
+		}
+		out.roots = header["roots"].as<uint32_t>();
+	}
+	catch (const YAML::Exception& e)
+	{
+		LogCritical("ParseSceneYAML(): %s", e.what());
+		return false;
+	}
+
+	// "objects: []" on one line
+	if (objectsPos != std::string::npos && text.find('[', objectsPos) < bodyStart)
+		bodyStart = objectsPos + strlen("objects:");
+
+	// items of block sequence start with the same indentation and '-'
+	size_t first = text.find_first_not_of(" \r\n", bodyStart);
+	vector<size_t> bounds{bodyStart};
+
+	if (first != std::string::npos && text[first] == '-')
+	{
+		size_t lineStart = text.rfind('\n', first);
+		lineStart = lineStart == std::string::npos ? 0 : lineStart + 1;
+		std::string prefix = "\n" + text.substr(lineStart, first - lineStart) + "-";
+
+		ThreadPool *pool = _core->GetThreadPool();
+		size_t chunkSize = max<size_t>((text.size() - bodyStart) / ((pool->GetWorkers() + 1) * 4), MIN_CHUNK_BYTES);
+
+		for (size_t pos = bodyStart + chunkSize; pos < text.size();)
+		{
+			size_t item = text.find(prefix, pos);
+			while (item != std::string::npos && item + prefix.size() < text.size() && !isspace((unsigned char)text[item + prefix.size()]))
+				item = text.find(prefix, item + 1);
+
+			if (item == std::string::npos)
+				break;
+
+			bounds.push_back(item + 1);
+			pos = item + 1 + chunkSize;
+		}
+	}
+
+	bounds.push_back(text.size());
+
+	vector<SceneRecords> chunks(bounds.size() - 1);
+	vector<std::string> errors(chunks.size());
+
+	_core->GetThreadPool()->ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+		{
+			PROFILE_SCOPE("Parse scene chunk");
+			std::istringstream in(text.substr(bounds[c], bounds[c + 1] - bounds[c]));
+			ChunkHandler handler(chunks[c]);
+
+			try
+			{
+				YAML::Parser parser(in);
+				parser.HandleNextDocument(handler);
+			}
+			catch (const YAML::Exception& e)
+			{
+				errors[c] = e.what();
+			}
+		}
+	});
+
+	for (size_t c = 0; c < errors.size(); c++)
+	{
+		if (errors[c].empty())
+			continue;
+
+		// valid file split inside an object can have chunks that are not valid YAML
+		if (chunks.size() > 1)
+		{
+			LogWarning("ParseSceneYAML(): chunk %u of '%s' is not parsed: %s", (uint)c, path, errors[c].c_str());
+			out.wholeObjects = false;
+			return true;
+		}
+
+		LogCritical("ParseSceneYAML(): %s", errors[c].c_str());
+		return false;
+	}
+
+	// merge chunks, strings are deduplicated across chunks
+	size_t numObjects = 0;
+	for (const SceneRecords& c : chunks)
+		numObjects += c.objects.size();
+
+	out.objects.reserve(numObjects);
+	out.transforms.reserve(numObjects);
+
+	std::unordered_map<std::string, int32_t> stringsMap;
+	vector<int32_t> remap;
+
+	for (SceneRecords& c : chunks)
+	{
+		remap.resize(c.strings.size());
+		for (size_t i = 0; i < c.strings.size(); i++)
+		{
+			auto it = stringsMap.find(c.strings[i]);
+			if (it == stringsMap.end())
+			{
+				it = stringsMap.emplace(c.strings[i], (int32_t)out.strings.size()).first;
+				out.strings.push_back(std::move(c.strings[i]));
+			}
+			remap[i] = it->second;
+		}
+
+		for (SceneFileObject obj : c.objects)
+		{
+			if (obj.mesh >= 0)
+				obj.mesh = remap[obj.mesh];
+			if (obj.material >= 0)
+				obj.material = remap[obj.material];
+			out.objects.push_back(obj);
+		}
+
+		out.transforms.insert(out.transforms.end(), c.transforms.begin(), c.transforms.end());
+		out.unknownKeys.insert(c.unknownKeys.begin(), c.unknownKeys.end());
+		out.wholeObjects = out.wholeObjects && c.wholeObjects;
+	}
+
+	if (out.wholeObjects && !checkHierarchy(out))
+		out.wholeObjects = false;
+
+	if (!out.wholeObjects)
+		LogWarning("ParseSceneYAML(): objects of '%s' are split by chunks", path);
+
+	if (!out.unknownKeys.empty())
+	{
+		std::string keys;
+		for (const std::string& k : out.unknownKeys)
+			keys += (keys.empty() ? "" : ", ") + k;
+		LogWarning("ParseSceneYAML(): keys without fields in scene records in '%s': %s", path, keys.c_str());
+	}
+
+	return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "common.h"
+#include "scene_file.h"
+
+//
+// Parses YAML scene into records of binary scene format without building document tree.
+// Text of objects sequence is split on object boundaries
+// and chunks are parsed from parser events in parallel on the thread pool.
+//
+struct SceneRecords
+{
+	std::vector<SceneFileObject> objects; // depth-first as in file
+	std::vector<mat4> transforms; // world space, as YAML stores them
+	std::vector<std::string> strings; // unique, indexed by SceneFileObject::mesh and material
+	uint32_t roots{0};
+	std::set<std::string> unknownKeys; // object keys that have no field in records, their values are skipped
+	bool wholeObjects{true}; // false if text was split inside an object: records don't match the file
+};
+
+bool ParseSceneYAML(const char *path, SceneRecords& out); // logs unknown keys and split objects
@@ -1,9 +1,13 @@
 #pragma once
 #include "pch.h"
 #include "shader.h"
+#include <atomic>
+
+static std::atomic<uint> lastId; // shaders can be created from any thread
 
 Shader::Shader(unique_ptr<ICoreShader> s, unique_ptr<const char[]> vertIn, unique_ptr<const char[]> geomIn, unique_ptr<const char[]> fragIn)
 {
+	id_ = ++lastId;
 	coreShader_ = std::move(s);
 	vertFullText_ = std::move(vertIn);
 	geomFullText_ = std::move(geomIn);
@@ -12,6 +16,7 @@ Shader::Shader(unique_ptr<ICoreShader> s, unique_ptr<const char[]> vertIn, uniqu
 
 Shader::Shader(std::unique_ptr<ICoreShader> s, std::unique_ptr<const char[]> compIn)
 {
+	id_ = ++lastId;
 	coreShader_ = std::move(s);
 	compFullText_ = std::move(compIn);
 }
@@ -61,6 +66,51 @@ auto DLLEXPORT Shader::SetUintParameter(const char *name, uint value) -> void
 	return coreShader_->SetUintParameter(name, value);
 }
 
+auto DLLEXPORT Shader::GetParameterHandle(const char *name) -> int
+{
+	return coreShader_->GetParameterHandle(name);
+}
+
+auto DLLEXPORT Shader::SetFloatParameter(int handle, float value) -> void
+{
+	return coreShader_->SetFloatParameter(handle, value);
+}
+
+auto DLLEXPORT Shader::SetVec4Parameter(int handle, const vec4 *value) -> void
+{
+	return coreShader_->SetVec4Parameter(handle, value);
+}
+
+auto DLLEXPORT Shader::SetMat4Parameter(int handle, const mat4 *value) -> void
+{
+	return coreShader_->SetMat4Parameter(handle, value);
+}
+
+auto DLLEXPORT Shader::SetUintParameter(int handle, uint value) -> void
+{
+	return coreShader_->SetUintParameter(handle, value);
+}
+
+auto DLLEXPORT Shader::GetConstantBufferHandle(const char *name) -> int
+{
+	return coreShader_->GetConstantBufferHandle(name);
+}
+
+auto DLLEXPORT Shader::GetConstantBufferSize(int bufferHandle) -> uint
+{
+	return coreShader_->GetConstantBufferSize(bufferHandle);
+}
+
+auto DLLEXPORT Shader::GetParameterOffset(int bufferHandle, const char *name, uint *bytes) -> int
+{
+	return coreShader_->GetParameterOffset(bufferHandle, name, bytes);
+}
+
+auto DLLEXPORT Shader::SetConstantBuffer(int bufferHandle, ICoreConstantBuffer *buffer) -> void
+{
+	return coreShader_->SetConstantBuffer(bufferHandle, buffer);
+}
+
 auto DLLEXPORT Shader::FlushParameters() -> void
 {
 	return coreShader_->FlushParameters();
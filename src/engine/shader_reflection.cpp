@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "shader_reflection.h"
+#include "crc.h"
+
+struct CachedReflection
+{
+	unique_ptr<uint8[]> bytecode;
+	size_t size;
+	ShaderReflection reflection;
+};
+
+static std::unordered_multimap<uint64_t, CachedReflection> reflectionCache; // bytecode hash -> reflection
+
+uint32_t LayoutHash(const ConstantBufferLayout& layout)
+{
+	string key = std::to_string(layout.bytes);
+
+	for (const ConstantBufferLayout::Parameter& p : layout.parameters)
+	{
+		key += '|';
+		key += p.name;
+		key += ':' + std::to_string(p.offset) + ':' + std::to_string(p.bytes);
+	}
+
+	return crc32::update(key.data(), key.size());
+}
+
+auto FindShaderReflection(const uint8 *bytecode, size_t size) -> const ShaderReflection*
+{
+	auto range = reflectionCache.equal_range(hash64(bytecode, size));
+
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		CachedReflection& c = it->second;
+		if (c.size == size && memcmp(c.bytecode.get(), bytecode, size) == 0)
+			return &c.reflection;
+	}
+
+	return nullptr;
+}
+
+auto AddShaderReflection(const uint8 *bytecode, size_t size, ShaderReflection&& reflection) -> const ShaderReflection*
+{
+	CachedReflection c;
+	c.bytecode = unique_ptr<uint8[]>(new uint8[size]);
+	memcpy(c.bytecode.get(), bytecode, size);
+	c.size = size;
+	c.reflection = std::move(reflection);
+
+	auto it = reflectionCache.emplace(hash64(bytecode, size), std::move(c));
+	return &it->second.reflection;
+}
+
+void ClearShaderReflections()
+{
+	reflectionCache.clear();
+}
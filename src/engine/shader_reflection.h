@@ -0,0 +1,33 @@
+#pragma once
+#include "common.h"
+
+//
+// Backend independent description of shader constant buffers.
+// Reflected once for each unique bytecode and cached.
+//
+
+struct ConstantBufferLayout
+{
+	struct Parameter
+	{
+		std::string name;
+		size_t offset;
+		size_t bytes;
+	};
+
+	std::string name;
+	size_t bytes;
+	std::vector<Parameter> parameters;
+	uint32_t hash; // of bytes and parameters, name is not included
+};
+
+struct ShaderReflection
+{
+	std::vector<ConstantBufferLayout> buffers;
+};
+
+uint32_t LayoutHash(const ConstantBufferLayout& layout);
+
+auto FindShaderReflection(const uint8 *bytecode, size_t size) -> const ShaderReflection*; // nullptr if not cached
+auto AddShaderReflection(const uint8 *bytecode, size_t size, ShaderReflection&& reflection) -> const ShaderReflection*;
+void ClearShaderReflections();
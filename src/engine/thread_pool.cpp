@@ -0,0 +1,380 @@
+#include "pch.h"
+#include "thread_pool.h"
+#include "core.h"
+#include "cpu_profiler.h"
+#include "model.h"
+#include <chrono>
+
+#define DEQUE_INITIAL_CAPACITY 256 // power of two
+
+static thread_local ThreadPool *workerPool;
+static thread_local int workerIndex = -1;
+static thread_local JobCounter *currentCounter; // of running job
+
+
+ThreadPool::Deque::Deque()
+{
+	arrays.emplace_back(new Array(DEQUE_INITIAL_CAPACITY));
+	array.store(arrays.back().get(), std::memory_order_relaxed);
+}
+
+void ThreadPool::Deque::Push(Job *job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	Array *a = array.load(std::memory_order_relaxed);
+
+	if (b - t > a->capacity - 1)
+	{
+		Array *grown = new Array(a->capacity * 2);
+		for (int64_t i = t; i < b; i++)
+			grown->put(i, a->get(i));
+
+		arrays.emplace_back(grown);
+		array.store(grown, std::memory_order_release);
+		a = grown;
+	}
+
+	a->put(b, job);
+	bottom.store(b + 1, std::memory_order_release); // publishes job to thieves
+}
+
+auto ThreadPool::Deque::Pop() -> Job*
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	Array *a = array.load(std::memory_order_relaxed);
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job *job = a->get(b);
+
+	// last job, race with thieves
+	if (t == b)
+	{
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+auto ThreadPool::Deque::Steal() -> Job*
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return nullptr;
+
+	Array *a = array.load(std::memory_order_acquire);
+	Job *job = a->get(t);
+
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+
+	return job;
+}
+
+void ThreadPool::Init(uint workers)
+{
+	quit = false;
+
+	for (uint i = 0; i < workers; i++)
+		deques.emplace_back(new Deque);
+
+	for (uint i = 0; i < workers; i++)
+		threads.emplace_back(&ThreadPool::workerLoop, this, (int)i);
+}
+
+void ThreadPool::Free()
+{
+	quit = true;
+	{
+		std::lock_guard<std::mutex> lock(sleepMtx);
+	}
+	sleepCv.notify_all();
+
+	for (std::thread& t : threads)
+		t.join();
+
+	threads.clear();
+
+	// not waited jobs are dropped
+	for (auto& d : deques)
+		while (Job *job = d->Pop())
+			delete job;
+	for (Job *job : injected)
+		delete job;
+
+	deques.clear();
+	injected.clear();
+	queued = 0;
+}
+
+void ThreadPool::push(Job *job)
+{
+	if (workerPool == this)
+		deques[workerIndex]->Push(job);
+	else
+	{
+		std::lock_guard<std::mutex> lock(injectedMtx);
+		injected.push_back(job);
+	}
+
+	queued++;
+
+	if (sleeping > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMtx);
+		sleepCv.notify_one();
+	}
+}
+
+// Own deque, then other workers, then injection queue
+auto ThreadPool::take(int worker) -> Job*
+{
+	Job *job = nullptr;
+	const int n = (int)deques.size();
+
+	if (worker >= 0)
+		job = deques[worker]->Pop();
+
+	for (int i = 1; !job && i <= n; i++)
+		job = deques[(worker + i + n) % n]->Steal();
+
+	if (!job)
+	{
+		std::lock_guard<std::mutex> lock(injectedMtx);
+		if (!injected.empty())
+		{
+			job = injected.front();
+			injected.pop_front();
+		}
+	}
+
+	if (job)
+		queued--;
+
+	return job;
+}
+
+void ThreadPool::run(Job *job)
+{
+	JobCounter *parent = currentCounter;
+	currentCounter = job->counter;
+
+	job->fn();
+
+	currentCounter = parent;
+
+	// waiting thread can destroy the counter after this
+	job->counter->value.fetch_sub(1, std::memory_order_release);
+	delete job;
+}
+
+void ThreadPool::workerLoop(int index)
+{
+	workerPool = this;
+	workerIndex = index;
+
+	char name[32];
+	sprintf(name, "Worker %i", index);
+	CpuProfiler::SetThreadName(name);
+
+	while (!quit)
+	{
+		if (Job *job = take(index))
+		{
+			run(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMtx);
+		sleeping++;
+		sleepCv.wait(lock, [this]() { return quit || queued > 0; });
+		sleeping--;
+	}
+}
+
+void ThreadPool::Submit(JobCounter& counter, std::function<void()>&& fn)
+{
+	counter.value.fetch_add(1, std::memory_order_relaxed);
+	push(new Job{std::move(fn), &counter});
+}
+
+void ThreadPool::SubmitChild(std::function<void()>&& fn)
+{
+	assert(currentCounter);
+	Submit(*currentCounter, std::move(fn));
+}
+
+void ThreadPool::Wait(JobCounter& counter)
+{
+	const int worker = workerPool == this ? workerIndex : -1;
+
+	while (counter.value.load(std::memory_order_acquire) > 0)
+	{
+		if (Job *job = take(worker))
+			run(job);
+		else
+			std::this_thread::yield(); // remaining jobs are running on other threads
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn)
+{
+	if (count == 0)
+		return;
+
+	grain = max<size_t>(grain, 1);
+
+	if (threads.empty() || count <= grain)
+	{
+		fn(0, count);
+		return;
+	}
+
+	// Range is halved at multiple of grain, upper half becomes a job.
+	// Thieves take big halves first and split them further on their threads
+	JobCounter counter;
+	std::function<void(size_t, size_t)> split = [&](size_t begin, size_t end)
+	{
+		while (end - begin > grain)
+		{
+			size_t chunks = (end - begin + grain - 1) / grain;
+			size_t mid = begin + chunks / 2 * grain;
+			Submit(counter, [&split, mid, end]() { split(mid, end); });
+			end = mid;
+		}
+
+		fn(begin, end);
+	};
+
+	split(0, count);
+	Wait(counter);
+}
+
+static float benchmarkWork(float x)
+{
+	for (int k = 0; k < 64; k++)
+		x = sqrtf(x * x + 1.0f) * 0.5f;
+	return x;
+}
+
+void BenchmarkThreadPool(uint threads)
+{
+	if (!threads)
+		threads = max(std::thread::hardware_concurrency(), 1u);
+
+	const size_t items = size_t(1) << 20;
+	const size_t jobs = 1 << 16;
+	const size_t parents = 256;
+	const size_t triangles = size_t(1) << 20;
+
+	vector<float> data(items);
+	vector<float> results(jobs);
+
+	vector<GPURaytracingTriangle> trianglesIn(triangles);
+	vector<GPURaytracingTriangle> trianglesOut(triangles);
+
+	for (size_t i = 0; i < triangles; i++)
+	{
+		float f = (float)i;
+		trianglesIn[i].p0 = vec4(f, 0.0f, 0.0f, 1.0f);
+		trianglesIn[i].p1 = vec4(0.0f, f, 0.0f, 1.0f);
+		trianglesIn[i].p2 = vec4(0.0f, 0.0f, f, 1.0f);
+		trianglesIn[i].n = vec4(0.0f, 0.0f, 1.0f, 0.0f);
+	}
+
+	mat4 M;
+	M.el_2D[0][3] = 1.0f;
+	M.el_2D[1][3] = 2.0f;
+	M.el_2D[2][3] = 3.0f;
+	M.el_2D[0][0] = 2.0f;
+	mat4 NM = M.InverseAffine();
+	NM.Transpose();
+
+	typedef std::chrono::high_resolution_clock clock;
+
+	// best of runs, first run warms up
+	auto measure = [](const std::function<void()>& fn) -> double
+	{
+		double best = 1e9;
+		for (int i = 0; i < 6; i++)
+		{
+			clock::time_point t = clock::now();
+			fn();
+			double ms = std::chrono::duration<double, std::milli>(clock::now() - t).count();
+			if (i > 0)
+				best = min(best, ms);
+		}
+		return best;
+	};
+
+	Log("BenchmarkThreadPool(): 1..%u threads, %u items, %u jobs, %u x %u nested jobs, %u triangles",
+		threads, (uint)items, (uint)jobs, (uint)parents, (uint)(jobs / parents), (uint)triangles);
+
+	double base[4]{};
+
+	for (uint t = 1; t <= threads; t++)
+	{
+		ThreadPool pool;
+		pool.Init(t - 1);
+
+		double ms[4];
+
+		ms[0] = measure([&]()
+		{
+			pool.ParallelFor(items, 4096, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+					data[i] = benchmarkWork(data[i] + (float)i);
+			});
+		});
+
+		ms[1] = measure([&]()
+		{
+			JobCounter counter;
+			for (size_t i = 0; i < jobs; i++)
+				pool.Submit(counter, [&results, i]() { results[i] = benchmarkWork((float)i); });
+			pool.Wait(counter);
+		});
+
+		ms[2] = measure([&]()
+		{
+			JobCounter counter;
+			for (size_t p = 0; p < parents; p++)
+				pool.Submit(counter, [&pool, &results, p, jobs, parents]()
+				{
+					for (size_t c = 0; c < jobs / parents; c++)
+					{
+						size_t i = p * (jobs / parents) + c;
+						pool.SubmitChild([&results, i]() { results[i] = benchmarkWork((float)i); });
+					}
+				});
+			pool.Wait(counter);
+		});
+
+		ms[3] = measure([&]()
+		{
+			Model::TransformRaytracingTriangles(&pool, M, NM, trianglesIn.data(), trianglesOut.data(), triangles, 1);
+		});
+
+		pool.Free();
+
+		if (t == 1)
+			memcpy(base, ms, sizeof(base));
+
+		Log("  %u threads: parallel for %.2f ms (%.2fx), jobs %.2f ms (%.2fx), nested %.2f ms (%.2fx), raytracing transform %.2f ms (%.2fx)",
+			t, ms[0], base[0] / ms[0], ms[1], base[1] / ms[1], ms[2], base[2] / ms[2], ms[3], base[3] / ms[3]);
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "common.h"
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+
+//
+// Counter of unfinished jobs. Submit() increments it, finished job decrements it.
+// Job can add children to counter of its parent with SubmitChild(), so waiting for
+// the parent counter waits for the whole tree.
+//
+struct JobCounter
+{
+	std::atomic<int> value{0};
+};
+
+//
+// Job system: fixed set of workers with a lock-free work-stealing deque per worker (Chase-Lev).
+// Workers pop own jobs LIFO and steal from others FIFO. Jobs of other threads (main thread,
+// frame pipeline) go to the shared injection queue.
+// Thread that waits for a counter executes jobs too, so jobs can wait for their children.
+//
+class ThreadPool
+{
+	struct Job
+	{
+		std::function<void()> fn;
+		JobCounter *counter;
+	};
+
+	// Owner pushes and pops at bottom, thieves take from top.
+	// Grown arrays are kept until Free(): thief may still read the old one
+	class Deque
+	{
+		struct Array
+		{
+			int64_t capacity;
+			std::unique_ptr<std::atomic<Job*>[]> jobs;
+
+			Array(int64_t capacity_) : capacity(capacity_), jobs(new std::atomic<Job*>[capacity_]) {}
+			Job* get(int64_t i) const { return jobs[i & (capacity - 1)].load(std::memory_order_relaxed); }
+			void put(int64_t i, Job *job) { jobs[i & (capacity - 1)].store(job, std::memory_order_relaxed); }
+		};
+
+		alignas(64) std::atomic<int64_t> top{0};
+		alignas(64) std::atomic<int64_t> bottom{0};
+		std::atomic<Array*> array;
+		std::vector<std::unique_ptr<Array>> arrays; // current and retired
+
+	public:
+		Deque();
+		void Push(Job *job); // owner
+		auto Pop() -> Job*; // owner
+		auto Steal() -> Job*;
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<Deque>> deques; // one per worker
+	std::deque<Job*> injected; // jobs of non-worker threads
+	std::mutex injectedMtx;
+	std::atomic<int> queued{0}; // in deques and injection queue
+	std::atomic<int> sleeping{0};
+	std::atomic<bool> quit{false};
+	std::mutex sleepMtx;
+	std::condition_variable sleepCv;
+
+	void push(Job *job);
+	auto take(int worker) -> Job*;
+	void run(Job *job);
+	void workerLoop(int index);
+
+public:
+	void Init(uint workers);
+	void Free(); // all counters must be waited
+
+	void Submit(JobCounter& counter, std::function<void()>&& fn);
+	void SubmitChild(std::function<void()>&& fn); // inside job only, to counter of running job
+	void Wait(JobCounter& counter); // runs jobs until counter is zero
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn); // ranges of grain items
+	auto GetWorkers() const -> uint { return (uint)threads.size(); }
+};
+
+// Synthetic workloads and transform of raytracing triangles (Model::GetRaytracingData()) for 1..threads threads
+void BenchmarkThreadPool(uint threads = 0); // 0 - hardware threads
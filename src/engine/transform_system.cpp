@@ -0,0 +1,306 @@
+#include "pch.h"
+#include "transform_system.h"
+#include "gameobject.h"
+#include "core.h"
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+#include "object_registry.h"
+#include <atomic>
+#include <assert.h>
+
+#define PROPAGATE_GRAIN 512
+
+static vector<vec3> localPos;
+static vector<quat> localRot;
+static vector<vec3> localScale;
+static vector<mat4> local;
+static vector<mat4> world;
+static vector<mat4> worldInv;
+static vector<mat4> normal; // transposed worldInv
+static vector<mat4> worldPrev;
+static vector<int> parent;
+static vector<uint8_t> flags;
+static vector<GameObject*> owner; // nullptr for free slots
+
+static vector<int> freeSlots;
+static vector<int> order; // live slots, parents before children
+static vector<int> levels; // order[levels[d]..levels[d + 1]) are slots of depth d
+static vector<int> depth; // temporary for rebuildOrder()
+static vector<int> changed; // slots updated in current pass
+static thread_local vector<int> chain; // temporary for GetWorldMatrix()
+static bool orderDirty;
+static std::atomic<bool> anyDirty; // setters are called from update jobs
+
+
+void TransformSystem::markDirty(int slot)
+{
+	flags[slot] |= DIRTY;
+	anyDirty = true;
+}
+
+void TransformSystem::rebuildOrder()
+{
+	depth.assign(owner.size(), -1);
+
+	int maxDepth = 0;
+
+	for (int s = 0; s < (int)owner.size(); s++)
+	{
+		if (!owner[s])
+			continue;
+
+		// walk up until a slot with known depth
+		int d = 0;
+		int p = s;
+		while (p >= 0 && depth[p] < 0)
+		{
+			p = parent[p];
+			d++;
+		}
+		int base = p >= 0 ? depth[p] + 1 : 0;
+
+		for (int q = s; q >= 0 && depth[q] < 0; q = parent[q])
+			depth[q] = base + --d;
+
+		maxDepth = max(maxDepth, depth[s]);
+	}
+
+	// counting sort by depth
+	levels.assign(maxDepth + 2, 0);
+
+	for (int s = 0; s < (int)owner.size(); s++)
+		if (owner[s])
+			levels[depth[s] + 1]++;
+
+	for (int i = 1; i < (int)levels.size(); i++)
+		levels[i] += levels[i - 1];
+
+	order.resize(levels.back());
+
+	vector<int> offsets(levels.begin(), levels.end() - 1);
+
+	for (int s = 0; s < (int)owner.size(); s++)
+		if (owner[s])
+			order[offsets[depth[s]]++] = s;
+
+	orderDirty = false;
+}
+
+auto TransformSystem::Allocate(GameObject *o) -> int
+{
+	assert(!ObjectRegistry::IsUpdatingObjects() && "TransformSystem::Allocate(): objects can't be created in GameObject::Update()");
+
+	int slot;
+
+	if (freeSlots.empty())
+	{
+		slot = (int)owner.size();
+		localPos.emplace_back();
+		localRot.emplace_back();
+		localScale.emplace_back(1.0f, 1.0f, 1.0f);
+		local.emplace_back();
+		world.emplace_back();
+		worldInv.emplace_back();
+		normal.emplace_back();
+		worldPrev.emplace_back();
+		parent.push_back(-1);
+		flags.push_back(0);
+		owner.push_back(o);
+	}
+	else
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		localPos[slot] = vec3();
+		localRot[slot] = quat();
+		localScale[slot] = vec3(1.0f, 1.0f, 1.0f);
+		local[slot] = mat4();
+		world[slot] = mat4();
+		worldInv[slot] = mat4();
+		normal[slot] = mat4();
+		worldPrev[slot] = mat4();
+		parent[slot] = -1;
+		flags[slot] = 0;
+		owner[slot] = o;
+	}
+
+	orderDirty = true;
+	return slot;
+}
+
+void TransformSystem::Release(int slot)
+{
+	assert(!ObjectRegistry::IsUpdatingObjects() && "TransformSystem::Release(): objects can't be destroyed in GameObject::Update()");
+
+	owner[slot] = nullptr;
+	parent[slot] = -1;
+	flags[slot] = 0;
+	freeSlots.push_back(slot);
+	orderDirty = true;
+}
+
+void TransformSystem::SetParent(int slot, int p)
+{
+	assert(!ObjectRegistry::IsUpdatingObjects() && "TransformSystem::SetParent(): objects can't be reparented in GameObject::Update()");
+
+	if (parent[slot] == p)
+		return;
+
+	parent[slot] = p;
+	orderDirty = true;
+	markDirty(slot);
+}
+
+void TransformSystem::SetLocal(int slot, const vec3& t, const quat& r, const vec3& s)
+{
+	localPos[slot] = t;
+	localRot[slot] = r;
+	localScale[slot] = s;
+	compositeTransform(local[slot], t, r, s);
+	markDirty(slot);
+}
+
+void TransformSystem::SetLocalMatrix(int slot, const mat4& m)
+{
+	local[slot] = m;
+	decompositeTransform(m, localPos[slot], localRot[slot], localScale[slot]);
+	markDirty(slot);
+}
+
+void TransformSystem::SetWorldMatrix(int slot, const mat4& m)
+{
+	int p = parent[slot];
+	SetLocalMatrix(slot, p >= 0 ? GetWorldMatrixInverse(p) * m : m);
+}
+
+auto TransformSystem::GetLocalPosition(int slot) -> const vec3&
+{
+	return localPos[slot];
+}
+
+auto TransformSystem::GetLocalRotation(int slot) -> const quat&
+{
+	return localRot[slot];
+}
+
+auto TransformSystem::GetLocalScale(int slot) -> const vec3&
+{
+	return localScale[slot];
+}
+
+auto TransformSystem::GetLocalMatrix(int slot) -> const mat4&
+{
+	return local[slot];
+}
+
+auto TransformSystem::GetWorldMatrix(int slot) -> mat4
+{
+	// topmost dirty slot on the parent chain, everything above it is up to date
+	int top = -1;
+	for (int s = slot; s >= 0; s = parent[s])
+		if (flags[s] & DIRTY)
+			top = s;
+
+	if (top < 0)
+		return world[slot];
+
+	chain.clear();
+	for (int s = slot; s != top; s = parent[s])
+		chain.push_back(s);
+	chain.push_back(top);
+
+	mat4 m = parent[top] >= 0 ? world[parent[top]] : mat4();
+	for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+		m = m * local[*it];
+
+	return m;
+}
+
+static bool dirtyChain(int slot)
+{
+	for (int s = slot; s >= 0; s = parent[s])
+		if (flags[s] & TransformSystem::DIRTY)
+			return true;
+	return false;
+}
+
+auto TransformSystem::GetWorldMatrixInverse(int slot) -> mat4
+{
+	if (dirtyChain(slot))
+		return GetWorldMatrix(slot).InverseAffine();
+
+	return worldInv[slot];
+}
+
+auto TransformSystem::GetNormalMatrix(int slot) -> mat4
+{
+	if (dirtyChain(slot))
+		return GetWorldMatrix(slot).InverseAffine().Transpose();
+
+	return normal[slot];
+}
+
+auto TransformSystem::GetWorldMatrixPrev(int slot) -> const mat4&
+{
+	return worldPrev[slot];
+}
+
+void TransformSystem::Update()
+{
+	PROFILE_FUNCTION();
+
+	if (orderDirty)
+		rebuildOrder();
+
+	if (!anyDirty)
+		return;
+
+	// Slots of one depth only read their parents from the previous level,
+	// so each level is split between workers
+	ThreadPool *pool = _core->GetThreadPool();
+
+	for (size_t d = 0; d + 1 < levels.size(); d++)
+	{
+		const int *levelSlots = order.data() + levels[d];
+
+		pool->ParallelFor(levels[d + 1] - levels[d], PROPAGATE_GRAIN, [levelSlots](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				int s = levelSlots[i];
+				int p = parent[s];
+				bool parentChanged = p >= 0 && (flags[p] & CHANGED);
+
+				if (!(flags[s] & DIRTY) && !parentChanged)
+					continue;
+
+				world[s] = p >= 0 ? world[p] * local[s] : local[s];
+				worldInv[s] = world[s].InverseAffine();
+				normal[s] = worldInv[s];
+				normal[s].Transpose();
+				flags[s] = (flags[s] & ~DIRTY) | CHANGED;
+			}
+		});
+	}
+
+	anyDirty = false;
+
+	changed.clear();
+	for (int s : order)
+		if (flags[s] & CHANGED)
+			changed.push_back(s);
+
+	for (int s : changed)
+		flags[s] &= ~CHANGED;
+
+	for (int s : changed)
+		owner[s]->onTransformChanged();
+}
+
+void TransformSystem::BeginFrame()
+{
+	Update();
+
+	for (int s : order)
+		worldPrev[s] = world[s];
+}
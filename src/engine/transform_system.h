@@ -0,0 +1,42 @@
+#pragma once
+#include "common.h"
+
+//
+// Transforms of all GameObjects in flat arrays indexed by slot.
+// Setters only mark a slot dirty. World matrices are propagated
+// over slots sorted by hierarchy depth, one depth level at a time on the thread pool.
+// Reading a world matrix before the pass resolves it along the parent chain.
+// Inverse and normal matrix (transposed inverse) of world are cached and recomputed only when world changes.
+//
+class TransformSystem
+{
+	static void rebuildOrder();
+	static void markDirty(int slot);
+
+public:
+	enum FLAGS : uint8_t
+	{
+		DIRTY = 1 << 0, // local changed
+		CHANGED = 1 << 1, // world recomputed in current pass
+	};
+
+	static auto Allocate(GameObject *owner) -> int;
+	static void Release(int slot);
+	static void SetParent(int slot, int parent);
+
+	static void SetLocal(int slot, const vec3& t, const quat& r, const vec3& s);
+	static void SetLocalMatrix(int slot, const mat4& m);
+	static void SetWorldMatrix(int slot, const mat4& m);
+
+	static auto GetLocalPosition(int slot) -> const vec3&;
+	static auto GetLocalRotation(int slot) -> const quat&;
+	static auto GetLocalScale(int slot) -> const vec3&;
+	static auto GetLocalMatrix(int slot) -> const mat4&;
+	static auto GetWorldMatrix(int slot) -> mat4;
+	static auto GetWorldMatrixInverse(int slot) -> mat4;
+	static auto GetNormalMatrix(int slot) -> mat4;
+	static auto GetWorldMatrixPrev(int slot) -> const mat4&;
+
+	static void Update(); // propagates dirty transforms and calls GameObject::onTransformChanged()
+	static void BeginFrame(); // Update() and remember world matrices as previous
+};
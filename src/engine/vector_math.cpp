@@ -0,0 +1,158 @@
+#include "pch.h"
+#include "vector_math.h"
+#include "core.h"
+#include <chrono>
+#include <random>
+
+#if defined(VECTOR_MATH_AVX)
+	#define VECTOR_MATH_BACKEND "AVX"
+#elif defined(VECTOR_MATH_SSE)
+	#define VECTOR_MATH_BACKEND "SSE"
+#elif defined(VECTOR_MATH_NEON)
+	#define VECTOR_MATH_BACKEND "NEON"
+#else
+	#define VECTOR_MATH_BACKEND "scalar"
+#endif
+
+// products and transposes must be bit-exact, inverses differ from scalar by rounding only
+#define INVERSE_TOLERANCE 1e-4f
+
+static bool equal(const mat4& a, const mat4& b)
+{
+	return memcmp(a.el_1D, b.el_1D, sizeof(a.el_1D)) == 0;
+}
+
+static bool equal(const vec4& a, const vec4& b)
+{
+	return memcmp(a.xyzw, b.xyzw, sizeof(a.xyzw)) == 0;
+}
+
+// max relative error of a * b^-1 to identity
+static float inverseError(const mat4& m, const mat4& inv)
+{
+	mat4 id = m.MultiplyScalar(inv);
+	float err = 0.0f;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			err = max(err, std::abs(id.el_2D[i][j] - (i == j ? 1.0f : 0.0f)));
+	return err;
+}
+
+bool BenchmarkVectorMath(size_t points)
+{
+	typedef std::chrono::high_resolution_clock clock;
+	auto ms = [](clock::time_point t) { return std::chrono::duration<double, std::milli>(clock::now() - t).count(); };
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+	const size_t numMatrices = 4096;
+	vector<mat4> matrices(numMatrices);
+	for (mat4& m : matrices)
+	{
+		for (int i = 0; i < 12; i++)
+			m.el_1D[i] = dist(rng);
+		m.el_2D[0][0] += 30.0f; // well-conditioned
+		m.el_2D[1][1] += 30.0f;
+		m.el_2D[2][2] += 30.0f;
+	}
+
+	vector<vec4> in(points);
+	for (vec4& v : in)
+		v = vec4(dist(rng), dist(rng), dist(rng), 1.0f);
+
+	// exactness
+	size_t mulMismatches = 0, vecMismatches = 0, transposeMismatches = 0, batchMismatches = 0;
+	float maxInverseErr = 0.0f, maxInverseScalarErr = 0.0f, maxInverseAffineErr = 0.0f;
+
+	for (size_t i = 0; i < numMatrices; i++)
+	{
+		const mat4& a = matrices[i];
+		const mat4& b = matrices[(i + 1) % numMatrices];
+
+		mulMismatches += !equal(a * b, a.MultiplyScalar(b));
+		vecMismatches += !equal(a * in[i % points], a.MultiplyScalar(in[i % points]));
+
+		mat4 t1 = a, t2 = a;
+		transposeMismatches += !equal(t1.Transpose(), t2.TransposeScalar());
+
+		maxInverseErr = max(maxInverseErr, inverseError(a, a.Inverse()));
+		maxInverseScalarErr = max(maxInverseScalarErr, inverseError(a, a.InverseScalar()));
+		maxInverseAffineErr = max(maxInverseAffineErr, inverseError(a, a.InverseAffine()));
+	}
+
+	vector<vec4> out(points);
+	transformPoints(matrices[0], in.data(), out.data(), points);
+	for (size_t i = 0; i < points; i++)
+		batchMismatches += !equal(out[i], matrices[0].MultiplyScalar(in[i]));
+
+	// speed
+	const size_t iterations = 1 << 20;
+	volatile float sink = 0.0f;
+
+	clock::time_point t = clock::now();
+	for (size_t i = 0; i < iterations; i++)
+		sink = sink + matrices[i % numMatrices].MultiplyScalar(matrices[(i + 1) % numMatrices]).el_1D[i & 15];
+	double mulScalarMs = ms(t);
+
+	t = clock::now();
+	for (size_t i = 0; i < iterations; i++)
+		sink = sink + (matrices[i % numMatrices] * matrices[(i + 1) % numMatrices]).el_1D[i & 15];
+	double mulMs = ms(t);
+
+	t = clock::now();
+	for (size_t i = 0; i < iterations; i++)
+		sink = sink + matrices[i % numMatrices].InverseScalar().el_1D[i & 15];
+	double invScalarMs = ms(t);
+
+	t = clock::now();
+	for (size_t i = 0; i < iterations; i++)
+		sink = sink + matrices[i % numMatrices].Inverse().el_1D[i & 15];
+	double invMs = ms(t);
+
+	t = clock::now();
+	for (size_t i = 0; i < iterations; i++)
+		sink = sink + matrices[i % numMatrices].InverseAffine().el_1D[i & 15];
+	double invAffineMs = ms(t);
+
+	t = clock::now();
+	for (size_t i = 0; i < points; i++)
+		out[i] = matrices[0].MultiplyScalar(in[i]);
+	double pointsScalarMs = ms(t);
+
+	t = clock::now();
+	for (size_t i = 0; i < points; i++)
+		out[i] = matrices[0] * in[i];
+	double pointsMs = ms(t);
+
+	t = clock::now();
+	transformPoints(matrices[0], in.data(), out.data(), points);
+	double batchMs = ms(t);
+
+	Log("BenchmarkVectorMath(): backend " VECTOR_MATH_BACKEND ", %u matrices, %u points", (uint)numMatrices, (uint)points);
+	Log("  mat4 * mat4:     scalar %.2f ms, simd %.2f ms (x%.2f), %u mismatches", mulScalarMs, mulMs, mulScalarMs / mulMs, (uint)mulMismatches);
+	Log("  mat4 Inverse():  scalar %.2f ms, simd %.2f ms (x%.2f), max error %g (scalar %g)", invScalarMs, invMs, invScalarMs / invMs, maxInverseErr, maxInverseScalarErr);
+	Log("  InverseAffine(): %.2f ms (x%.2f of scalar), max error %g", invAffineMs, invScalarMs / invAffineMs, maxInverseAffineErr);
+	Log("  mat4 * vec4:     scalar %.2f ms, simd %.2f ms (x%.2f), %u mismatches", pointsScalarMs, pointsMs, pointsScalarMs / pointsMs, (uint)vecMismatches);
+	Log("  transformPoints: %.2f ms (x%.2f of scalar), %u mismatches", batchMs, pointsScalarMs / batchMs, (uint)batchMismatches);
+	Log("  Transpose():     %u mismatches", (uint)transposeMismatches);
+
+	bool ok = true;
+	auto check = [&ok](bool passed, const char *what)
+	{
+		if (!passed)
+		{
+			LogCritical("BenchmarkVectorMath(): %s differs from scalar code", what);
+			ok = false;
+		}
+	};
+
+	check(!mulMismatches, "mat4 * mat4");
+	check(!vecMismatches, "mat4 * vec4");
+	check(!batchMismatches, "transformPoints()");
+	check(!transposeMismatches, "Transpose()");
+	check(maxInverseErr <= INVERSE_TOLERANCE, "Inverse()");
+	check(maxInverseAffineErr <= INVERSE_TOLERANCE, "InverseAffine()");
+
+	return ok;
+}
@@ -16,13 +16,32 @@ int APIENTRY wWinMain(_In_ HINSTANCE _hInstance, _In_opt_ HINSTANCE hPrevInstanc
 	if (!core)
 		return 0;
 
-	core->Init("", nullptr, INIT_FLAGS::VSYNC_ON);
+	// -benchmark <name>: runs benchmark on loaded world instead of main loop, results are in log
+	char benchmark[64]{};
+	if (const wchar_t *arg = wcsstr(lpCmdLine, L"-benchmark "))
+		swscanf(arg, L"-benchmark %63S", benchmark);
+
+	INIT_FLAGS flags = INIT_FLAGS::VSYNC_ON;
+	if (!strcmp(benchmark, "render_submission"))
+		flags = INIT_FLAGS::NULL_RENDER;
+	else if (!strcmp(benchmark, "software_raster"))
+		flags = INIT_FLAGS::SOFTWARE_RENDER;
+
+	core->Init("", nullptr, flags);
 
 	ResourceManager *resMan = core->GetResourceManager();
 	resMan->LoadWorld();
 
 	Camera *c = resMan->CreateCamera();
 
+	if (benchmark[0])
+	{
+		int ret = core->RunBenchmark(benchmark, c) ? 0 : 1;
+		core->Free();
+		ReleaseCore(core);
+		return ret;
+	}
+
 	MaterialManager *mm = core->GetMaterialManager();
 
 	Material *mat = mm->CreateMaterial("mesh");